@@ -208,6 +208,10 @@ bgfx_shaders = {
 			vec3 a_position  : POSITION;
 			vec3 a_normal    : NORMAL;
 			vec2 a_texcoord0 : TEXCOORD0;
+			vec4 i_data0     : TEXCOORD7;
+			vec4 i_data1     : TEXCOORD6;
+			vec4 i_data2     : TEXCOORD5;
+			vec4 i_data3     : TEXCOORD4;
 		"""
 
 		vs_input_output = """
@@ -215,12 +219,41 @@ bgfx_shaders = {
 			$output v_normal, v_view, v_texcoord0
 		"""
 
+		vs_input_output_instanced = """
+			$input a_position, a_normal, a_texcoord0, i_data0, i_data1, i_data2, i_data3
+			$output v_normal, v_view, v_texcoord0
+		"""
+
 		vs_code = """
+			// [0] = position scale, vertex compression (0 = none, 1 = quantized)
+			// [1] = position offset
+			uniform vec4 u_mesh_decode[2];
+
+			vec3 octahedral_decode(vec2 e)
+			{
+				vec3 n = vec3(e.xy, 1.0 - abs(e.x) - abs(e.y));
+				float t = max(-n.z, 0.0);
+				n.x += n.x >= 0.0 ? -t : t;
+				n.y += n.y >= 0.0 ? -t : t;
+				return normalize(n);
+			}
+
 			void main()
 			{
-				gl_Position = mul(u_modelViewProj, vec4(a_position, 1.0));
-				v_view = mul(u_modelView, vec4(a_position, 1.0));
-				v_normal = normalize(mul(u_modelView, vec4(a_normal, 0.0)).xyz);
+				vec3 position = a_position * u_mesh_decode[0].xyz + u_mesh_decode[1].xyz;
+				vec3 normal = u_mesh_decode[0].w > 0.5 ? octahedral_decode(a_normal.xy) : a_normal;
+
+		#ifdef INSTANCED
+				mat4 model = mtxFromCols(i_data0, i_data1, i_data2, i_data3);
+				vec4 world = mul(model, vec4(position, 1.0));
+				gl_Position = mul(u_viewProj, world);
+				v_view = mul(u_view, world);
+				v_normal = normalize(mul(u_view, mul(model, vec4(normal, 0.0))).xyz);
+		#else
+				gl_Position = mul(u_modelViewProj, vec4(position, 1.0));
+				v_view = mul(u_modelView, vec4(position, 1.0));
+				v_normal = normalize(mul(u_modelView, vec4(normal, 0.0)).xyz);
+		#endif // INSTANCED
 
 				v_texcoord0 = a_texcoord0;
 			}
@@ -232,11 +265,15 @@ bgfx_shaders = {
 
 		fs_code = """
 		#if !defined(NO_LIGHT)
-			uniform vec4 u_light_position;  // In world-space
-			uniform vec4 u_light_direction; // In view-space
-			uniform vec4 u_light_color;
-			uniform vec4 u_light_range;
-			uniform vec4 u_light_intensity;
+			// Must match CROWN_MAX_LIGHTS.
+			#define MAX_NUM_LIGHTS 16
+
+			// Three vec4 per light, in view-space:
+			// [0] = position, range (0 for directional lights)
+			// [1] = direction, cosine of the spot angle (-1 for non-spot lights)
+			// [2] = color, intensity
+			uniform vec4 u_lights[3*MAX_NUM_LIGHTS];
+			uniform vec4 u_lights_num;
 
 			uniform vec4 u_ambient;
 			uniform vec4 u_diffuse;
@@ -250,13 +287,33 @@ bgfx_shaders = {
 			void main()
 			{
 		#if !defined(NO_LIGHT)
-				// normalize both input vectors
 				vec3 n = normalize(v_normal);
-				vec3 e = normalize(v_view.xyz);
-				vec3 l = u_light_direction.xyz;
+				vec4 light_diffuse = vec4(0.0, 0.0, 0.0, 0.0);
+
+				for (int i = 0; i < MAX_NUM_LIGHTS; ++i)
+				{
+					if (i >= int(u_lights_num.x))
+						break;
+
+					vec4 position_range  = u_lights[3*i + 0];
+					vec4 direction_spot  = u_lights[3*i + 1];
+					vec4 color_intensity = u_lights[3*i + 2];
 
-				float nl = max(0.0, dot(n, l));
-				vec4 light_diffuse = nl * toLinearAccurate(u_light_color) * u_light_intensity.x;
+					vec3 l = direction_spot.xyz;
+					float attenuation = 1.0;
+
+					if (position_range.w > 0.0)
+					{
+						vec3 d = position_range.xyz - v_view.xyz;
+						float dist = length(d);
+						l = d / dist;
+						attenuation = clamp(1.0 - dist / position_range.w, 0.0, 1.0);
+						attenuation *= step(direction_spot.w, dot(l, direction_spot.xyz));
+					}
+
+					float nl = max(0.0, dot(n, l));
+					light_diffuse += nl * attenuation * toLinearAccurate(vec4(color_intensity.xyz, 1.0)) * color_intensity.w;
+				}
 
 				vec4 color = max(u_diffuse * light_diffuse, u_ambient);
 		#else
@@ -412,9 +469,13 @@ bgfx_shaders = {
 		"""
 
 		vs_code = """
+			// Must match u_mesh_decode in the mesh shader.
+			uniform vec4 u_mesh_decode[2];
+
 			void main()
 			{
-				gl_Position = mul(u_modelViewProj, vec4(a_position, 1.0));
+				vec3 position = a_position * u_mesh_decode[0].xyz + u_mesh_decode[1].xyz;
+				gl_Position = mul(u_modelViewProj, vec4(position, 1.0));
 			}
 		"""
 
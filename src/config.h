@@ -79,6 +79,18 @@
 	#define CROWN_DEFAULT_PIXELS_PER_METER 32
 #endif // CROWN_DEFAULT_PIXELS_PER_METER
 
+#ifndef CROWN_MAX_LIGHTS
+	#define CROWN_MAX_LIGHTS 16
+#endif // CROWN_MAX_LIGHTS
+
+#ifndef CROWN_MAX_SOUND_VOICES
+	#define CROWN_MAX_SOUND_VOICES 32
+#endif // CROWN_MAX_SOUND_VOICES
+
+#ifndef CROWN_CULLING_GRID_CELL_SIZE
+	#define CROWN_CULLING_GRID_CELL_SIZE 32.0f
+#endif // CROWN_CULLING_GRID_CELL_SIZE
+
 #ifndef CROWN_DEFAULT_WINDOW_WIDTH
 	#define CROWN_DEFAULT_WINDOW_WIDTH 1280
 #endif // CROWN_DEFAULT_WINDOW_WIDTH
@@ -87,6 +99,10 @@
 	#define CROWN_DEFAULT_WINDOW_HEIGHT 720
 #endif // CROWN_DEFAULT_WINDOW_HEIGHT
 
+#ifndef CROWN_DEFAULT_LOADER_THREADS
+	#define CROWN_DEFAULT_LOADER_THREADS 2
+#endif // CROWN_DEFAULT_LOADER_THREADS
+
 #ifndef CROWN_DEFAULT_CONSOLE_PORT
 	#define CROWN_DEFAULT_CONSOLE_PORT 10001
 #endif // CROWN_DEFAULT_CONSOLE_PORT
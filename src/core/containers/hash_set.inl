@@ -28,6 +28,10 @@ namespace hash_set
 	template <typename TKey, typename Hash, typename KeyEqual> void insert(HashSet<TKey, Hash, KeyEqual>& m, const TKey& key);
 
 	/// Removes the @a key from the set if it exists.
+	///
+	/// @note
+	/// The items following @a key may move back by one slot, so items must
+	/// not be removed while iterating with begin() and end().
 	template <typename TKey, typename Hash, typename KeyEqual> void remove(HashSet<TKey, Hash, KeyEqual>& m, const TKey& key);
 
 	/// Removes all the items in the set.
@@ -253,8 +257,26 @@ namespace hash_set
 			return;
 
 		m._data[i].~TKey();
-		m._index[i].index |= hash_set_internal::DELETED;
 		--m._size;
+
+		// Shift the following elements back by one slot, so that lookups
+		// never have to probe past a deleted element.
+		u32 hole = i;
+		for (;;)
+		{
+			const u32 next = (hole + 1) & m._mask;
+			if (m._index[next].index == hash_set_internal::FREE
+				|| hash_set_internal::probe_distance(m, m._index[next].hash, next) == 0
+				)
+				break;
+
+			memcpy((void*)(m._data + hole), (void*)(m._data + next), sizeof(m._data[0]));
+			m._index[hole] = m._index[next];
+			hole = next;
+		}
+
+		m._index[hole].hash = 0;
+		m._index[hole].index = hash_set_internal::FREE;
 	}
 
 	template <typename TKey, typename Hash, typename KeyEqual>
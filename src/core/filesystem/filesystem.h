@@ -67,6 +67,14 @@ struct Filesystem
 	/// the root path of the file source. If @a path is absolute,
 	/// the given path is returned.
 	virtual void absolute_path(DynamicString& os_path, const char* path) = 0;
+
+	/// Maps the file at the given @a path into memory for reading.
+	/// Returns the address of the mapping and sets @a size to the size of
+	/// the file, or returns NULL if the file cannot be mapped.
+	virtual const void* map(const char* path, u32* size) = 0;
+
+	/// Unmaps the @a data of @a size bytes returned by map().
+	virtual void unmap(const void* data, u32 size) = 0;
 };
 
 } // namespace crown
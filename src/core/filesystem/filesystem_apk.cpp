@@ -210,6 +210,15 @@ void FilesystemApk::absolute_path(DynamicString& os_path, const char* path)
 	os_path = path;
 }
 
+const void* FilesystemApk::map(const char* /*path*/, u32* /*size*/)
+{
+	return NULL;
+}
+
+void FilesystemApk::unmap(const void* /*data*/, u32 /*size*/)
+{
+}
+
 } // namespace crown
 
 #endif // CROWN_PLATFORM_ANDROID
@@ -61,6 +61,12 @@ struct FilesystemApk : public Filesystem
 
 	/// @copydoc Filesystem::absolute_path()
 	void absolute_path(DynamicString& os_path, const char* path);
+
+	/// @copydoc Filesystem::map()
+	const void* map(const char* path, u32* size);
+
+	/// @copydoc Filesystem::unmap()
+	void unmap(const void* data, u32 size);
 };
 
 } // namespace crown
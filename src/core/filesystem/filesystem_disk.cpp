@@ -14,6 +14,10 @@
 #if CROWN_PLATFORM_POSIX
 	#include <stdio.h>
 	#include <errno.h>
+	#include <fcntl.h>    // open
+	#include <sys/mman.h> // mmap, munmap
+	#include <sys/stat.h> // fstat
+	#include <unistd.h>   // close
 #elif CROWN_PLATFORM_WINDOWS
 	#include <tchar.h>
 	#include <windows.h>
@@ -345,4 +349,48 @@ void FilesystemDisk::absolute_path(DynamicString& os_path, const char* path)
 	path::reduce(os_path, str.c_str());
 }
 
+const void* FilesystemDisk::map(const char* path, u32* size)
+{
+	CE_ENSURE(NULL != path);
+
+#if CROWN_PLATFORM_POSIX
+	TempAllocator256 ta;
+	DynamicString abs_path(ta);
+	absolute_path(abs_path, path);
+
+	int fd = ::open(abs_path.c_str(), O_RDONLY);
+	if (fd == -1)
+		return NULL;
+
+	void* data = NULL;
+	struct stat st;
+	if (fstat(fd, &st) == 0 && st.st_size > 0)
+	{
+		data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+		if (data == MAP_FAILED)
+			data = NULL;
+		else
+			*size = (u32)st.st_size;
+	}
+
+	::close(fd);
+	return data;
+#else
+	// Windows does not allow to replace files while they are mapped, which
+	// would prevent the data compiler from updating data in use.
+	CE_UNUSED(size);
+	return NULL;
+#endif
+}
+
+void FilesystemDisk::unmap(const void* data, u32 size)
+{
+#if CROWN_PLATFORM_POSIX
+	munmap((void*)data, size);
+#else
+	CE_UNUSED(data);
+	CE_UNUSED(size);
+#endif
+}
+
 } // namespace crown
@@ -0,0 +1,198 @@
+/*
+ * Copyright (c) 2012-2021 Daniele Bartolini et al.
+ * License: https://github.com/dbartolini/crown/blob/master/LICENSE
+ */
+
+#include "core/lz4.h"
+#include <string.h> // memcpy, memset
+
+/// Compressor and decompressor for the LZ4 block format, by Yann Collet.
+///
+/// A block is a sequence of (literals, match) pairs. Each pair starts with a
+/// token whose high nibble is the number of literals and whose low nibble is
+/// the length of the match minus LZ4_MIN_MATCH; a nibble of 15 means the
+/// length continues in the following bytes. The literals follow, then the
+/// 16-bit little-endian offset of the match. The last pair has no match.
+#define LZ4_MIN_MATCH     4
+#define LZ4_LAST_LITERALS 5  // The last 5 bytes are always literals.
+#define LZ4_MF_LIMIT      12 // The last match starts at least 12 bytes before the end.
+#define LZ4_MAX_OFFSET    65535
+#define LZ4_HASH_LOG      12
+
+namespace crown
+{
+static inline u32 lz4_read32(const u8* p)
+{
+	u32 v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+static inline u32 lz4_hash(u32 v)
+{
+	return (v * 2654435761u) >> (32 - LZ4_HASH_LOG);
+}
+
+static inline u8* lz4_write_length(u8* op, u32 len)
+{
+	for (; len >= 255; len -= 255)
+		*op++ = 255;
+	*op++ = (u8)len;
+	return op;
+}
+
+static inline bool lz4_read_length(u32& len, const u8*& ip, const u8* end)
+{
+	u32 s;
+	do
+	{
+		if (ip >= end)
+			return false;
+		s = *ip++;
+		len += s;
+	}
+	while (s == 255);
+
+	return true;
+}
+
+u32 lz4_compress_bound(u32 size)
+{
+	return size + size/255 + 16;
+}
+
+u32 lz4_compress(void* dst, const void* src, u32 size)
+{
+	const u8* in = (const u8*)src;
+	const u8* end = in + size;
+	const u8* anchor = in;
+	u8* op = (u8*)dst;
+
+	if (size > LZ4_MF_LIMIT)
+	{
+		const u8* match_limit = end - LZ4_MF_LIMIT;
+		const u8* match_end_limit = end - LZ4_LAST_LITERALS;
+
+		// Positions of the last occurrences of each 4-byte sequence.
+		u32 table[1 << LZ4_HASH_LOG];
+		memset(table, 0, sizeof(table));
+
+		const u8* ip = in;
+		while (ip < match_limit)
+		{
+			const u32 h = lz4_hash(lz4_read32(ip));
+			const u8* ref = in + table[h];
+			table[h] = u32(ip - in);
+
+			if (ref >= ip || ip - ref > LZ4_MAX_OFFSET || lz4_read32(ref) != lz4_read32(ip))
+			{
+				++ip;
+				continue;
+			}
+
+			// Extend the match backwards into the pending literals.
+			while (ip > anchor && ref > in && ip[-1] == ref[-1])
+			{
+				--ip;
+				--ref;
+			}
+
+			const u8* mp = ip + LZ4_MIN_MATCH;
+			const u8* mr = ref + LZ4_MIN_MATCH;
+			while (mp < match_end_limit && *mp == *mr)
+			{
+				++mp;
+				++mr;
+			}
+
+			const u32 num_literals = u32(ip - anchor);
+			const u32 match_length = u32(mp - ip) - LZ4_MIN_MATCH;
+			const u32 offset = u32(ip - ref);
+
+			u8* token = op++;
+			*token = u8((num_literals < 15 ? num_literals : 15) << 4 | (match_length < 15 ? match_length : 15));
+			if (num_literals >= 15)
+				op = lz4_write_length(op, num_literals - 15);
+			memcpy(op, anchor, num_literals);
+			op += num_literals;
+			*op++ = u8(offset & 0xff);
+			*op++ = u8(offset >> 8);
+			if (match_length >= 15)
+				op = lz4_write_length(op, match_length - 15);
+
+			ip = mp;
+			anchor = ip;
+
+			if (ip < match_limit)
+				table[lz4_hash(lz4_read32(ip - 2))] = u32(ip - 2 - in);
+		}
+	}
+
+	const u32 num_literals = u32(end - anchor);
+	*op++ = u8((num_literals < 15 ? num_literals : 15) << 4);
+	if (num_literals >= 15)
+		op = lz4_write_length(op, num_literals - 15);
+	memcpy(op, anchor, num_literals);
+	op += num_literals;
+
+	return u32(op - (u8*)dst);
+}
+
+bool lz4_decompress(void* dst, u32 dst_size, const void* src, u32 src_size)
+{
+	const u8* ip = (const u8*)src;
+	const u8* end = ip + src_size;
+	u8* begin = (u8*)dst;
+	u8* op = begin;
+	u8* op_end = op + dst_size;
+
+	while (ip < end)
+	{
+		const u32 token = *ip++;
+
+		u32 num_literals = token >> 4;
+		if (num_literals == 15 && !lz4_read_length(num_literals, ip, end))
+			return false;
+		if (num_literals > u32(end - ip) || num_literals > u32(op_end - op))
+			return false;
+
+		memcpy(op, ip, num_literals);
+		op += num_literals;
+		ip += num_literals;
+
+		// The last sequence has no match.
+		if (ip == end)
+			break;
+
+		if (end - ip < 2)
+			return false;
+		const u32 offset = u32(ip[0]) | u32(ip[1]) << 8;
+		ip += 2;
+		if (offset == 0 || offset > u32(op - begin))
+			return false;
+
+		u32 match_length = token & 15;
+		if (match_length == 15 && !lz4_read_length(match_length, ip, end))
+			return false;
+		match_length += LZ4_MIN_MATCH;
+		if (match_length > u32(op_end - op))
+			return false;
+
+		const u8* ref = op - offset;
+		if (offset >= match_length)
+		{
+			memcpy(op, ref, match_length);
+			op += match_length;
+		}
+		else
+		{
+			// Overlapping matches repeat the last offset bytes.
+			for (u32 i = 0; i < match_length; ++i)
+				*op++ = *ref++;
+		}
+	}
+
+	return op == op_end;
+}
+
+} // namespace crown
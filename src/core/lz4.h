@@ -0,0 +1,23 @@
+/*
+ * Copyright (c) 2012-2021 Daniele Bartolini et al.
+ * License: https://github.com/dbartolini/crown/blob/master/LICENSE
+ */
+
+#pragma once
+
+#include "core/types.h"
+
+namespace crown
+{
+/// Returns the maximum size of the data compressed from @a size bytes.
+u32 lz4_compress_bound(u32 size);
+
+/// Compresses @a size bytes of @a src into @a dst and returns the size of the
+/// compressed data. @a dst must be at least lz4_compress_bound(size) bytes.
+u32 lz4_compress(void* dst, const void* src, u32 size);
+
+/// Decompresses @a src_size bytes of @a src into @a dst. Returns true if the
+/// data decompressed to exactly @a dst_size bytes, false if it is corrupted.
+bool lz4_decompress(void* dst, u32 dst_size, const void* src, u32 src_size);
+
+} // namespace crown
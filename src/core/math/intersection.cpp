@@ -154,7 +154,8 @@ f32 ray_triangle_intersection(const Vector3& from, const Vector3& dir, const Vec
 	return ray_mesh_intersection(from, dir, MATRIX4X4_IDENTITY, verts, sizeof(Vector3), inds, 3);
 }
 
-f32 ray_mesh_intersection(const Vector3& from, const Vector3& dir, const Matrix4x4& tm, const void* vertices, u32 stride, const u16* indices, u32 num)
+template <typename TIndex>
+static f32 ray_mesh_intersection_internal(const Vector3& from, const Vector3& dir, const Matrix4x4& tm, const void* vertices, u32 stride, const TIndex* indices, u32 num)
 {
 	bool hit = false;
 	f32 tmin = 999999999.9f;
@@ -218,6 +219,16 @@ f32 ray_mesh_intersection(const Vector3& from, const Vector3& dir, const Matrix4
 	return hit ? tmin : -1.0f;
 }
 
+f32 ray_mesh_intersection(const Vector3& from, const Vector3& dir, const Matrix4x4& tm, const void* vertices, u32 stride, const u16* indices, u32 num)
+{
+	return ray_mesh_intersection_internal(from, dir, tm, vertices, stride, indices, num);
+}
+
+f32 ray_mesh_intersection(const Vector3& from, const Vector3& dir, const Matrix4x4& tm, const void* vertices, u32 stride, const u32* indices, u32 num)
+{
+	return ray_mesh_intersection_internal(from, dir, tm, vertices, stride, indices, num);
+}
+
 bool plane_3_intersection(const Plane3& a, const Plane3& b, const Plane3& c, Vector3& ip)
 {
 	const Vector3 na = a.n;
@@ -264,80 +275,21 @@ bool frustum_sphere_intersection(const Frustum& f, const Sphere& s)
 
 bool frustum_box_intersection(const Frustum& f, const AABB& b)
 {
-	const Vector3 v0 = aabb::vertex(b, 0);
-	const Vector3 v1 = aabb::vertex(b, 1);
-	const Vector3 v2 = aabb::vertex(b, 2);
-	const Vector3 v3 = aabb::vertex(b, 3);
-	const Vector3 v4 = aabb::vertex(b, 4);
-	const Vector3 v5 = aabb::vertex(b, 5);
-	const Vector3 v6 = aabb::vertex(b, 6);
-	const Vector3 v7 = aabb::vertex(b, 7);
-
-	u8 out = 0;
-	out += (plane3::distance_to_point(f.plane_left, v0) < 0.0f) ? 1 : 0;
-	out += (plane3::distance_to_point(f.plane_left, v1) < 0.0f) ? 1 : 0;
-	out += (plane3::distance_to_point(f.plane_left, v2) < 0.0f) ? 1 : 0;
-	out += (plane3::distance_to_point(f.plane_left, v3) < 0.0f) ? 1 : 0;
-	out += (plane3::distance_to_point(f.plane_left, v4) < 0.0f) ? 1 : 0;
-	out += (plane3::distance_to_point(f.plane_left, v5) < 0.0f) ? 1 : 0;
-	out += (plane3::distance_to_point(f.plane_left, v6) < 0.0f) ? 1 : 0;
-	out += (plane3::distance_to_point(f.plane_left, v7) < 0.0f) ? 1 : 0;
-	if (out == 8) return false;
-
-	out = 0;
-	out += (plane3::distance_to_point(f.plane_right, v0) < 0.0f) ? 1 : 0;
-	out += (plane3::distance_to_point(f.plane_right, v1) < 0.0f) ? 1 : 0;
-	out += (plane3::distance_to_point(f.plane_right, v2) < 0.0f) ? 1 : 0;
-	out += (plane3::distance_to_point(f.plane_right, v3) < 0.0f) ? 1 : 0;
-	out += (plane3::distance_to_point(f.plane_right, v4) < 0.0f) ? 1 : 0;
-	out += (plane3::distance_to_point(f.plane_right, v5) < 0.0f) ? 1 : 0;
-	out += (plane3::distance_to_point(f.plane_right, v6) < 0.0f) ? 1 : 0;
-	out += (plane3::distance_to_point(f.plane_right, v7) < 0.0f) ? 1 : 0;
-	if (out == 8) return false;
-
-	out = 0;
-	out += (plane3::distance_to_point(f.plane_bottom, v0) < 0.0f) ? 1 : 0;
-	out += (plane3::distance_to_point(f.plane_bottom, v1) < 0.0f) ? 1 : 0;
-	out += (plane3::distance_to_point(f.plane_bottom, v2) < 0.0f) ? 1 : 0;
-	out += (plane3::distance_to_point(f.plane_bottom, v3) < 0.0f) ? 1 : 0;
-	out += (plane3::distance_to_point(f.plane_bottom, v4) < 0.0f) ? 1 : 0;
-	out += (plane3::distance_to_point(f.plane_bottom, v5) < 0.0f) ? 1 : 0;
-	out += (plane3::distance_to_point(f.plane_bottom, v6) < 0.0f) ? 1 : 0;
-	out += (plane3::distance_to_point(f.plane_bottom, v7) < 0.0f) ? 1 : 0;
-	if (out == 8) return false;
-
-	out = 0;
-	out += (plane3::distance_to_point(f.plane_top, v0) < 0.0f) ? 1 : 0;
-	out += (plane3::distance_to_point(f.plane_top, v1) < 0.0f) ? 1 : 0;
-	out += (plane3::distance_to_point(f.plane_top, v2) < 0.0f) ? 1 : 0;
-	out += (plane3::distance_to_point(f.plane_top, v3) < 0.0f) ? 1 : 0;
-	out += (plane3::distance_to_point(f.plane_top, v4) < 0.0f) ? 1 : 0;
-	out += (plane3::distance_to_point(f.plane_top, v5) < 0.0f) ? 1 : 0;
-	out += (plane3::distance_to_point(f.plane_top, v6) < 0.0f) ? 1 : 0;
-	out += (plane3::distance_to_point(f.plane_top, v7) < 0.0f) ? 1 : 0;
-	if (out == 8) return false;
-
-	out = 0;
-	out += (plane3::distance_to_point(f.plane_near, v0) < 0.0f) ? 1 : 0;
-	out += (plane3::distance_to_point(f.plane_near, v1) < 0.0f) ? 1 : 0;
-	out += (plane3::distance_to_point(f.plane_near, v2) < 0.0f) ? 1 : 0;
-	out += (plane3::distance_to_point(f.plane_near, v3) < 0.0f) ? 1 : 0;
-	out += (plane3::distance_to_point(f.plane_near, v4) < 0.0f) ? 1 : 0;
-	out += (plane3::distance_to_point(f.plane_near, v5) < 0.0f) ? 1 : 0;
-	out += (plane3::distance_to_point(f.plane_near, v6) < 0.0f) ? 1 : 0;
-	out += (plane3::distance_to_point(f.plane_near, v7) < 0.0f) ? 1 : 0;
-	if (out == 8) return false;
-
-	out = 0;
-	out += (plane3::distance_to_point(f.plane_far, v0) < 0.0f) ? 1 : 0;
-	out += (plane3::distance_to_point(f.plane_far, v1) < 0.0f) ? 1 : 0;
-	out += (plane3::distance_to_point(f.plane_far, v2) < 0.0f) ? 1 : 0;
-	out += (plane3::distance_to_point(f.plane_far, v3) < 0.0f) ? 1 : 0;
-	out += (plane3::distance_to_point(f.plane_far, v4) < 0.0f) ? 1 : 0;
-	out += (plane3::distance_to_point(f.plane_far, v5) < 0.0f) ? 1 : 0;
-	out += (plane3::distance_to_point(f.plane_far, v6) < 0.0f) ? 1 : 0;
-	out += (plane3::distance_to_point(f.plane_far, v7) < 0.0f) ? 1 : 0;
-	if (out == 8) return false;
+	const Vector3 c = aabb::center(b);
+	const Vector3 e = b.max - c;
+
+	// The box is outside the frustum as soon as it lies entirely behind
+	// one of the planes, i.e. its vertex farthest along the plane normal
+	// (the positive vertex) is behind it.
+	const Plane3* planes = &f.plane_left;
+	for (u32 i = 0; i < 6; ++i)
+	{
+		const Plane3& p = planes[i];
+		const f32 r = e.x*fabs(p.n.x) + e.y*fabs(p.n.y) + e.z*fabs(p.n.z);
+
+		if (plane3::distance_to_point(p, c) + r < 0.0f)
+			return false;
+	}
 
 	// If we are here, it is because either the box intersects or it is contained in the frustum
 	return true;
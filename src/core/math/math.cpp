@@ -23,6 +23,11 @@ f32 ffract(f32 a)
 	return a - floorf(a);
 }
 
+f32 ffloor(f32 a)
+{
+	return floorf(a);
+}
+
 f32 fabs(f32 a)
 {
 	return ::fabsf(a);
@@ -23,6 +23,9 @@ bool fequal(f32 a, f32 b, f32 epsilon = FLOAT_EPSILON);
 /// Returns the fractional part of @a a.
 f32 ffract(f32 a);
 
+/// Returns the largest integral value not greater than @a a.
+f32 ffloor(f32 a);
+
 /// Returns the absolute value of @a a.
 f32 fabs(f32 a);
 
@@ -17,7 +17,8 @@
 	#include <dirent.h>   // opendir, readdir
 	#include <dlfcn.h>    // dlopen, dlclose, dlsym
 	#include <errno.h>
-	#include <stdio.h>    // fputs
+	#include <sched.h>    // sched_yield
+	#include <stdio.h>    // fputs, rename
 	#include <stdlib.h>   // getenv
 	#include <string.h>   // memset
 	#include <sys/wait.h> // wait
@@ -45,6 +46,27 @@ namespace os
 #endif
 	}
 
+	void yield()
+	{
+#if CROWN_PLATFORM_POSIX
+		sched_yield();
+#elif CROWN_PLATFORM_WINDOWS
+		SwitchToThread();
+#endif
+	}
+
+	u32 num_processors()
+	{
+#if CROWN_PLATFORM_POSIX
+		const long num = sysconf(_SC_NPROCESSORS_ONLN);
+		return num > 0 ? (u32)num : 1;
+#elif CROWN_PLATFORM_WINDOWS
+		SYSTEM_INFO si;
+		GetSystemInfo(&si);
+		return si.dwNumberOfProcessors;
+#endif
+	}
+
 	void* library_open(const char* path)
 	{
 #if CROWN_PLATFORM_POSIX
@@ -164,6 +186,15 @@ namespace os
 		return dr;
 	}
 
+	s32 rename(const char* old_path, const char* new_path)
+	{
+#if CROWN_PLATFORM_POSIX
+		return ::rename(old_path, new_path);
+#elif CROWN_PLATFORM_WINDOWS
+		return MoveFileEx(old_path, new_path, MOVEFILE_REPLACE_EXISTING) != 0 ? 0 : -1;
+#endif
+	}
+
 	CreateResult create_directory(const char* path)
 	{
 		CreateResult cr;
@@ -77,6 +77,12 @@ namespace os
 	/// Suspends execution for @a ms milliseconds.
 	void sleep(u32 ms);
 
+	/// Gives up the remainder of the calling thread's time slice.
+	void yield();
+
+	/// Returns the number of processors available.
+	u32 num_processors();
+
 	/// Opens the library at @a path.
 	void* library_open(const char* path);
 
@@ -100,6 +106,10 @@ namespace os
 	/// Deletes the file at @a path.
 	DeleteResult delete_file(const char* path);
 
+	/// Renames the file at @a old_path to @a new_path, replacing it if it
+	/// already exists. Returns 0 on success.
+	s32 rename(const char* old_path, const char* new_path);
+
 	/// Creates a directory @a path.
 	CreateResult create_directory(const char* path);
 
@@ -11,6 +11,7 @@
 	#include <unistd.h>   // fork, execvp
 	#include <sys/wait.h> // waitpid
 	#include <errno.h>
+	#include <fcntl.h>    // fcntl
 #elif CROWN_PLATFORM_WINDOWS
 	#include <windows.h>
 #endif
@@ -72,6 +73,11 @@ s32 Process::spawn(const char* const* argv, u32 flags)
 	{
 		if (pipe(fildes) < 0)
 			return -1;
+
+		// Do not leak the pipe into processes spawned concurrently by other
+		// threads. dup2() clears the flag on the child's standard streams.
+		fcntl(fildes[0], F_SETFD, FD_CLOEXEC);
+		fcntl(fildes[1], F_SETFD, FD_CLOEXEC);
 	}
 
 	pid = fork();
@@ -34,6 +34,9 @@ struct ConditionVariable
 
 	///
 	void signal();
+
+	///
+	void broadcast();
 };
 
 } // namespace crown
@@ -0,0 +1,235 @@
+/*
+ * Copyright (c) 2012-2021 Daniele Bartolini et al.
+ * License: https://github.com/dbartolini/crown/blob/master/LICENSE
+ */
+
+#include "core/containers/array.inl"
+#include "core/containers/queue.inl"
+#include "core/memory/globals.h"
+#include "core/memory/temp_allocator.inl"
+#include "core/os.h"
+#include "core/thread/job_system.h"
+#include "core/thread/mutex.h"
+#include "core/thread/scoped_mutex.inl"
+#include "core/thread/semaphore.h"
+#include "core/thread/thread.h"
+
+namespace crown
+{
+namespace job_system_globals
+{
+	enum { MAX_WORKERS = 64 };
+
+	struct Entry
+	{
+		Job job;
+		JobCounter* counter;
+	};
+
+	struct Worker
+	{
+		Mutex _mutex;
+		Queue<Entry> _queue;
+		Thread _thread;
+
+		explicit Worker(Allocator& a)
+			: _queue(a)
+		{
+		}
+	};
+
+	static Worker* _workers[MAX_WORKERS];
+	static u32 _num_workers = 0;
+	static Semaphore _sem;
+	static std::atomic_int _quit(0);
+	static thread_local u32 _worker_index = 0;
+
+	static bool pop(u32 index, Entry& entry)
+	{
+		// Newest job from our own deque first.
+		{
+			Worker& w = *_workers[index];
+			ScopedMutex sm(w._mutex);
+			if (queue::size(w._queue) != 0)
+			{
+				entry = queue::back(w._queue);
+				queue::pop_back(w._queue);
+				return true;
+			}
+		}
+
+		// Then steal the oldest job from somebody else.
+		for (u32 i = 1; i < _num_workers; ++i)
+		{
+			Worker& w = *_workers[(index + i) % _num_workers];
+			ScopedMutex sm(w._mutex);
+			if (queue::size(w._queue) != 0)
+			{
+				entry = queue::front(w._queue);
+				queue::pop_front(w._queue);
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	static void execute(const Entry& entry)
+	{
+		entry.job.function(entry.job.user_data);
+		entry.counter->value.fetch_sub(1);
+	}
+
+	static s32 worker_main(void* user_data)
+	{
+		_worker_index = (u32)(uintptr_t)user_data;
+
+		while (_quit.load() == 0)
+		{
+			Entry entry;
+			if (pop(_worker_index, entry))
+				execute(entry);
+			else
+				_sem.wait();
+		}
+
+		return 0;
+	}
+
+	void init(u32 num_workers)
+	{
+		CE_ASSERT(_num_workers == 0, "Job system already initialized");
+
+		if (num_workers == 0)
+			num_workers = os::num_processors();
+		num_workers = clamp(num_workers, 1u, (u32)MAX_WORKERS);
+
+		_quit = 0;
+		_worker_index = 0;
+		for (u32 i = 0; i < num_workers; ++i)
+			_workers[i] = CE_NEW(default_allocator(), Worker)(default_allocator());
+		_num_workers = num_workers;
+
+		// The calling thread is worker 0.
+		for (u32 i = 1; i < num_workers; ++i)
+			_workers[i]->_thread.start(worker_main, (void*)(uintptr_t)i);
+	}
+
+	void shutdown()
+	{
+		_quit = 1;
+		_sem.post(_num_workers);
+
+		for (u32 i = 1; i < _num_workers; ++i)
+			_workers[i]->_thread.stop();
+
+		for (u32 i = 0; i < _num_workers; ++i)
+			CE_DELETE(default_allocator(), _workers[i]);
+		_num_workers = 0;
+	}
+
+} // namespace job_system_globals
+
+namespace job_system
+{
+	void run(const Job* jobs, u32 num, JobCounter& counter)
+	{
+		using namespace job_system_globals;
+
+		counter.value.fetch_add(num);
+
+		// Run inline when there is nobody to hand the jobs to.
+		if (_num_workers <= 1)
+		{
+			for (u32 i = 0; i < num; ++i)
+			{
+				jobs[i].function(jobs[i].user_data);
+				counter.value.fetch_sub(1);
+			}
+			return;
+		}
+
+		Worker& w = *_workers[_worker_index];
+		{
+			ScopedMutex sm(w._mutex);
+			for (u32 i = 0; i < num; ++i)
+			{
+				Entry entry;
+				entry.job = jobs[i];
+				entry.counter = &counter;
+				queue::push_back(w._queue, entry);
+			}
+		}
+
+		_sem.post(min(num, _num_workers - 1));
+	}
+
+	void wait(JobCounter& counter)
+	{
+		using namespace job_system_globals;
+
+		while (counter.value.load() > 0)
+		{
+			Entry entry;
+			if (pop(_worker_index, entry))
+				execute(entry);
+			else
+				os::yield(); // The remaining jobs are running on other threads.
+		}
+	}
+
+	struct ParallelForRange
+	{
+		ParallelForFunction func;
+		void* user_data;
+		u32 begin;
+		u32 end;
+	};
+
+	static void parallel_for_job(void* user_data)
+	{
+		const ParallelForRange* r = (ParallelForRange*)user_data;
+		r->func(r->begin, r->end, r->user_data);
+	}
+
+	void parallel_for(u32 num, u32 grain, ParallelForFunction func, void* user_data)
+	{
+		grain = max(grain, 1u);
+		const u32 num_ranges = (num + grain - 1) / grain;
+
+		if (num_ranges <= 1 || num_workers() <= 1)
+		{
+			if (num != 0)
+				func(0, num, user_data);
+			return;
+		}
+
+		TempAllocator1024 ta;
+		Array<ParallelForRange> ranges(ta);
+		Array<Job> jobs(ta);
+		array::resize(ranges, num_ranges);
+		array::resize(jobs, num_ranges);
+
+		for (u32 i = 0; i < num_ranges; ++i)
+		{
+			ranges[i].func      = func;
+			ranges[i].user_data = user_data;
+			ranges[i].begin     = i * grain;
+			ranges[i].end       = min((i + 1) * grain, num);
+			jobs[i].function    = parallel_for_job;
+			jobs[i].user_data   = &ranges[i];
+		}
+
+		JobCounter counter;
+		run(array::begin(jobs), num_ranges, counter);
+		wait(counter);
+	}
+
+	u32 num_workers()
+	{
+		return job_system_globals::_num_workers;
+	}
+
+} // namespace job_system
+
+} // namespace crown
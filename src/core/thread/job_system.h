@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2012-2021 Daniele Bartolini et al.
+ * License: https://github.com/dbartolini/crown/blob/master/LICENSE
+ */
+
+#pragma once
+
+#include "core/types.h"
+#include <atomic>
+
+namespace crown
+{
+typedef void (*JobFunction)(void* user_data);
+typedef void (*ParallelForFunction)(u32 begin, u32 end, void* user_data);
+
+/// Job.
+///
+/// @ingroup Thread
+struct Job
+{
+	JobFunction function;
+	void* user_data;
+};
+
+/// Counts the jobs that have not finished yet.
+///
+/// @ingroup Thread
+struct JobCounter
+{
+	std::atomic_int value;
+
+	///
+	JobCounter()
+		: value(0)
+	{
+	}
+};
+
+/// Functions to schedule jobs on worker threads.
+///
+/// Each worker owns a deque of jobs: it pops the most recent job from its
+/// own deque and steals the oldest ones from the others when it runs out.
+///
+/// @ingroup Thread
+namespace job_system
+{
+	/// Schedules the @a num @a jobs and increments @a counter by @a num.
+	/// The counter is decremented each time one of the jobs finishes.
+	void run(const Job* jobs, u32 num, JobCounter& counter);
+
+	/// Waits until @a counter reaches zero. The calling thread executes
+	/// pending jobs while waiting.
+	void wait(JobCounter& counter);
+
+	/// Calls @a func over the range [0; @a num) split into chunks of at
+	/// most @a grain items and waits for all of them to finish.
+	void parallel_for(u32 num, u32 grain, ParallelForFunction func, void* user_data);
+
+	/// Returns the number of threads executing jobs, including the main
+	/// thread.
+	u32 num_workers();
+
+} // namespace job_system
+
+namespace job_system_globals
+{
+	/// Starts the job system with @a num_workers threads, including the
+	/// calling thread. If @a num_workers is 0, one thread per processor is
+	/// used.
+	void init(u32 num_workers = 0);
+
+	///
+	void shutdown();
+
+} // namespace job_system_globals
+
+} // namespace crown
@@ -9,6 +9,8 @@ namespace crown
 {
 struct AtomicInt;
 struct ConditionVariable;
+struct Job;
+struct JobCounter;
 struct Mutex;
 struct ScopedMutex;
 struct Semaphore;
@@ -12,13 +12,18 @@
 #include "core/containers/hash_map.inl"
 #include "core/containers/hash_set.inl"
 #include "core/containers/vector.inl"
+#include "core/filesystem/file.h"
+#include "core/filesystem/filesystem_disk.h"
 #include "core/filesystem/path.h"
 #include "core/guid.inl"
 #include "core/json/json.h"
 #include "core/json/sjson.h"
+#include "core/lz4.h"
 #include "core/math/aabb.inl"
 #include "core/math/color4.inl"
 #include "core/math/constants.h"
+#include "core/math/frustum.inl"
+#include "core/math/intersection.h"
 #include "core/math/math.h"
 #include "core/math/matrix3x3.inl"
 #include "core/math/matrix4x4.inl"
@@ -36,8 +41,23 @@
 #include "core/strings/string.inl"
 #include "core/strings/string_id.inl"
 #include "core/strings/string_view.inl"
+#include "core/thread/job_system.h"
 #include "core/thread/thread.h"
 #include "core/time.h"
+#include "device/console_server.h"
+#include "device/device_options.h"
+#include "resource/compile_options.h"
+#include "resource/data_compiler.h"
+#include "resource/package_resource.h"
+#include "resource/physics_resource.h"
+#include "resource/resource_id.inl"
+#include "resource/resource_loader.h"
+#include "resource/resource_manager.h"
+#include "world/debug_line.h"
+#include "world/physics.h"
+#include "world/physics_world.h"
+#include "world/shader_manager.h"
+#include "world/unit_manager.h"
 #include <stdlib.h> // EXIT_SUCCESS, EXIT_FAILURE
 
 #undef CE_ASSERT
@@ -150,6 +170,29 @@ static void test_hash_map()
 			hash_map::remove(m, i);
 		}
 	}
+	{
+		HashMap<s32, s32> m(a);
+		hash_map_internal::grow(m);
+		ENSURE(hash_map::capacity(m) == 16);
+
+		// 0, 16 and 32 share the same slot.
+		hash_map::set(m, 0, 0);
+		hash_map::set(m, 16, 16);
+		hash_map::set(m, 32, 32);
+		hash_map::remove(m, 16);
+		hash_map::set(m, 1, 1);
+		ENSURE(hash_map::size(m) == 3);
+		ENSURE(hash_map::has(m, 0));
+		ENSURE(hash_map::has(m, 1));
+		ENSURE(!hash_map::has(m, 16));
+		ENSURE(hash_map::has(m, 32));
+		ENSURE(hash_map::get(m, 32, -1) == 32);
+
+		hash_map::remove(m, 0);
+		ENSURE(hash_map::has(m, 1));
+		ENSURE(hash_map::has(m, 32));
+		ENSURE(hash_map::get(m, 32, -1) == 32);
+	}
 	{
 		HashMap<s32, s32> ma(a);
 		HashMap<s32, s32> mb(a);
@@ -188,6 +231,27 @@ static void test_hash_set()
 		for (s32 i = 0; i < 100; ++i)
 			ENSURE(!hash_set::has(m, i*i));
 	}
+	{
+		HashSet<s32> m(a);
+		hash_set_internal::grow(m);
+		ENSURE(hash_set::capacity(m) == 16);
+
+		// 0, 16 and 32 share the same slot.
+		hash_set::insert(m, 0);
+		hash_set::insert(m, 16);
+		hash_set::insert(m, 32);
+		hash_set::remove(m, 16);
+		hash_set::insert(m, 1);
+		ENSURE(hash_set::size(m) == 3);
+		ENSURE(hash_set::has(m, 0));
+		ENSURE(hash_set::has(m, 1));
+		ENSURE(!hash_set::has(m, 16));
+		ENSURE(hash_set::has(m, 32));
+
+		hash_set::remove(m, 0);
+		ENSURE(hash_set::has(m, 1));
+		ENSURE(hash_set::has(m, 32));
+	}
 	{
 		HashSet<s32> ma(a);
 		HashSet<s32> mb(a);
@@ -894,6 +958,38 @@ static void test_sphere()
 	}
 }
 
+static void test_frustum()
+{
+	{
+		Frustum f;
+		frustum::from_matrix(f, MATRIX4X4_IDENTITY);
+		ENSURE( frustum::contains_point(f, vector3( 0.0f, 0.0f, 0.5f)));
+		ENSURE(!frustum::contains_point(f, vector3( 1.5f, 0.0f, 0.5f)));
+		ENSURE(!frustum::contains_point(f, vector3( 0.0f, 0.0f, 1.5f)));
+	}
+	{
+		Frustum f;
+		frustum::from_matrix(f, MATRIX4X4_IDENTITY);
+
+		AABB a;
+		a.min = vector3(-0.5f, -0.5f, 0.2f);
+		a.max = vector3( 0.5f,  0.5f, 0.8f);
+		ENSURE(frustum_box_intersection(f, a));
+
+		a.min = vector3( 0.8f,  0.8f, 0.8f);
+		a.max = vector3( 3.0f,  3.0f, 3.0f);
+		ENSURE(frustum_box_intersection(f, a));
+
+		a.min = vector3( 1.5f, -0.5f, 0.2f);
+		a.max = vector3( 2.5f,  0.5f, 0.8f);
+		ENSURE(!frustum_box_intersection(f, a));
+
+		a.min = vector3(-0.5f, -0.5f, -2.0f);
+		a.max = vector3( 0.5f,  0.5f, -1.0f);
+		ENSURE(!frustum_box_intersection(f, a));
+	}
+}
+
 static void test_murmur()
 {
 	const u32 m = murmur32("murmur32", 8, 0);
@@ -902,6 +998,37 @@ static void test_murmur()
 	ENSURE(n == 0x90631502d1a3432bu);
 }
 
+static void test_lz4()
+{
+	{
+		char data[1024];
+		for (u32 i = 0; i < sizeof(data); ++i)
+			data[i] = "crown"[i % 5] + char(i / 256);
+
+		char compressed[1024 + 1024/255 + 16];
+		const u32 size = lz4_compress(compressed, data, sizeof(data));
+		ENSURE(size <= lz4_compress_bound(sizeof(data)));
+		ENSURE(size < sizeof(data) / 4);
+
+		char decompressed[1024];
+		ENSURE(lz4_decompress(decompressed, sizeof(decompressed), compressed, size));
+		ENSURE(memcmp(data, decompressed, sizeof(data)) == 0);
+		ENSURE(!lz4_decompress(decompressed, sizeof(decompressed) - 1, compressed, size));
+		ENSURE(!lz4_decompress(decompressed, sizeof(decompressed), compressed, size - 1));
+	}
+	{
+		// Inputs shorter than the minimum match length are stored as literals.
+		char compressed[16];
+		const u32 size = lz4_compress(compressed, "crown", 5);
+		ENSURE(size == 6);
+		ENSURE(compressed[0] == 0x50);
+
+		char decompressed[5];
+		ENSURE(lz4_decompress(decompressed, sizeof(decompressed), compressed, size));
+		ENSURE(memcmp(decompressed, "crown", 5) == 0);
+	}
+}
+
 static void test_string_id()
 {
 	memory_globals::init();
@@ -1470,6 +1597,41 @@ static void test_thread()
 	ENSURE(thread.exit_code() == 0xbadc0d3);
 }
 
+static void test_job_system()
+{
+	memory_globals::init();
+	job_system_globals::init(4);
+	{
+		u32 values[1000];
+		job_system::parallel_for(countof(values), 64, [](u32 begin, u32 end, void* user_data)
+			{
+				for (u32 i = begin; i < end; ++i)
+					((u32*)user_data)[i] = i*2;
+			}
+			, values
+			);
+		for (u32 i = 0; i < countof(values); ++i)
+			ENSURE(values[i] == i*2);
+	}
+	{
+		std::atomic_int sum(0);
+		Job jobs[16];
+		for (u32 i = 0; i < countof(jobs); ++i)
+		{
+			jobs[i].function = [](void* user_data) { ((std::atomic_int*)user_data)->fetch_add(1); };
+			jobs[i].user_data = &sum;
+		}
+
+		JobCounter counter;
+		job_system::run(jobs, countof(jobs), counter);
+		job_system::wait(counter);
+		ENSURE(counter.value == 0);
+		ENSURE(sum == 16);
+	}
+	job_system_globals::shutdown();
+	memory_globals::shutdown();
+}
+
 static void test_process()
 {
 #if CROWN_PLATFORM_LINUX
@@ -1531,6 +1693,243 @@ static void test_filesystem()
 #endif // CROWN_PLATFORM_POSIX
 }
 
+#if CROWN_CAN_COMPILE && CROWN_PLATFORM_POSIX
+static std::atomic_int _num_compiled(0);
+
+/// Compiles a test resource. Its source is either "-" or the type and the
+/// name of another resource, which it both requires and depends on.
+static s32 compile_test_resource(CompileOptions& opts)
+{
+	Buffer buf = opts.read();
+
+	TempAllocator256 ta;
+	DynamicString source(ta);
+	source.set(array::begin(buf), array::size(buf));
+
+	const char* name = strchr(source.c_str(), ' ');
+	if (name != NULL)
+	{
+		DynamicString type(ta);
+		type.set(source.c_str(), u32(name - source.c_str()));
+		++name;
+
+		DynamicString path(ta);
+		path += name;
+		path += ".";
+		path += type;
+
+		opts.add_requirement(type.c_str(), name);
+		opts.read(path.c_str());
+	}
+
+	opts.write(buf);
+	_num_compiled.fetch_add(1);
+	return 0;
+}
+
+static void write_test_file(const char* dir, const char* path, const char* data)
+{
+	FilesystemDisk fs(default_allocator());
+	fs.set_prefix(dir);
+	File* file = fs.open(path, FileOpenMode::WRITE);
+	file->write(data, strlen32(data));
+	fs.close(*file);
+}
+
+static void delete_test_tree(const char* dir)
+{
+	Vector<DynamicString> files(default_allocator());
+	os::list_files(dir, files);
+
+	for (u32 i = 0; i < vector::size(files); ++i)
+	{
+		DynamicString path(default_allocator());
+		path::join(path, dir, files[i].c_str());
+
+		Stat st;
+		os::stat(st, path.c_str());
+		if (st.file_type == Stat::DIRECTORY)
+			delete_test_tree(path.c_str());
+		else
+			os::delete_file(path.c_str());
+	}
+
+	os::delete_directory(dir);
+}
+
+/// Compiles the test resources in @a source_dir, restoring the state of the
+/// compiler from @a data_dir and saving it back, as the data compiler does.
+static bool compile_test_data(const char* source_dir, const char* data_dir)
+{
+	const char* argv[] = { "crown" };
+	DeviceOptions opts(default_allocator(), countof(argv), argv);
+
+	DataCompiler dc(opts, *console_server());
+	dc.register_compiler("material",       1,                               compile_test_resource);
+	dc.register_compiler("package",        RESOURCE_VERSION_PACKAGE,        package_resource_internal::compile);
+	dc.register_compiler("physics_config", RESOURCE_VERSION_PHYSICS_CONFIG, physics_config_resource_internal::compile);
+	dc.register_compiler("texture",        1,                               compile_test_resource);
+	dc.register_compiler("unit",           1,                               compile_test_resource);
+	dc.map_source_dir("", source_dir);
+	dc.scan_and_restore(data_dir);
+
+	const bool success = dc.compile(data_dir, "linux");
+	dc.save(data_dir);
+	return success;
+}
+#endif // CROWN_CAN_COMPILE && CROWN_PLATFORM_POSIX
+
+static void test_data_compiler()
+{
+#if CROWN_CAN_COMPILE && CROWN_PLATFORM_POSIX
+	memory_globals::init();
+	guid_globals::init();
+	job_system_globals::init(4);
+	console_server_globals::init();
+	{
+		char dir[5 + GUID_BUF_LEN] = "/tmp/";
+		guid::to_string(dir + 5, sizeof(dir) - 5, guid::new_guid());
+		os::create_directory(dir);
+
+		DynamicString source_dir(default_allocator());
+		DynamicString data_dir(default_allocator());
+		path::join(source_dir, dir, "source");
+		path::join(data_dir, dir, "data");
+		os::create_directory(source_dir.c_str());
+
+		write_test_file(source_dir.c_str(), "boot.package", "unit = [ \"a\" ]");
+		write_test_file(source_dir.c_str(), "a.unit", "material m");
+		write_test_file(source_dir.c_str(), "m.material", "texture t");
+		write_test_file(source_dir.c_str(), "t.texture", "-");
+
+		_num_compiled = 0;
+		ENSURE(compile_test_data(source_dir.c_str(), data_dir.c_str()));
+		ENSURE(_num_compiled == 3);
+
+		// Packages contain the resources required through a chain of
+		// requirements.
+		{
+			FilesystemDisk data_fs(default_allocator());
+			data_fs.set_prefix(data_dir.c_str());
+
+			DynamicString dest(default_allocator());
+			destination_path(dest, resource_id(StringId64("package"), StringId64("boot")));
+			File* file = data_fs.open(dest.c_str(), FileOpenMode::READ);
+			ENSURE(file->is_open());
+			PackageResource* pr = (PackageResource*)package_resource_internal::load(*file, default_allocator());
+			data_fs.close(*file);
+
+			bool has_texture = false;
+			for (u32 i = 0; i < array::size(pr->resources); ++i)
+			{
+				has_texture = has_texture
+					|| (pr->resources[i].type == StringId64("texture") && pr->resources[i].name == StringId64("t"))
+					;
+			}
+			ENSURE(array::size(pr->resources) == 3);
+			ENSURE(has_texture);
+
+			package_resource_internal::unload(default_allocator(), pr);
+		}
+
+		// Resources are recompiled when any file down their chain of
+		// dependencies changes.
+		write_test_file(source_dir.c_str(), "t.texture", "--");
+
+		_num_compiled = 0;
+		ENSURE(compile_test_data(source_dir.c_str(), data_dir.c_str()));
+		ENSURE(_num_compiled == 3);
+
+		delete_test_tree(dir);
+	}
+	console_server_globals::shutdown();
+	job_system_globals::shutdown();
+	guid_globals::shutdown();
+	memory_globals::shutdown();
+#endif // CROWN_CAN_COMPILE && CROWN_PLATFORM_POSIX
+}
+
+static void test_physics_world()
+{
+#if CROWN_CAN_COMPILE && CROWN_PLATFORM_POSIX
+	memory_globals::init();
+	guid_globals::init();
+	job_system_globals::init(4);
+	console_server_globals::init();
+	physics_globals::init(default_allocator());
+	{
+		char dir[5 + GUID_BUF_LEN] = "/tmp/";
+		guid::to_string(dir + 5, sizeof(dir) - 5, guid::new_guid());
+		os::create_directory(dir);
+
+		DynamicString source_dir(default_allocator());
+		DynamicString data_dir(default_allocator());
+		path::join(source_dir, dir, "source");
+		path::join(data_dir, dir, "data");
+		os::create_directory(source_dir.c_str());
+
+		write_test_file(source_dir.c_str(), "global.physics_config",
+			"materials = { default = { friction = 0.8 rolling_friction = 0.5 restitution = 0.81 } }"
+			"collision_filters = { default = { collides_with = [ \"default\" ] } }"
+			"actors = { dynamic = { dynamic = true } }"
+			);
+		ENSURE(compile_test_data(source_dir.c_str(), data_dir.c_str()));
+
+		FilesystemDisk data_fs(default_allocator());
+		data_fs.set_prefix(data_dir.c_str());
+		ResourceLoader rl(data_fs, 1);
+		ResourceManager rm(rl);
+		rm.register_type(RESOURCE_TYPE_PHYSICS_CONFIG, RESOURCE_VERSION_PHYSICS_CONFIG, NULL, NULL, NULL, NULL);
+		rm.load(RESOURCE_TYPE_PHYSICS_CONFIG, StringId64("global"));
+		rm.flush();
+
+		UnitManager um(default_allocator());
+		ShaderManager sm(default_allocator());
+		DebugLine dl(sm, false);
+		{
+			PhysicsWorld pw(default_allocator(), rm, um, dl);
+
+			ActorResource ar;
+			ar.actor_class      = StringId32("dynamic");
+			ar.mass             = 1.0f;
+			ar.collision_filter = StringId32("default");
+			ar.material         = StringId32("default");
+			ar.flags            = 0u;
+
+			// Teleport a dynamic actor.
+			ActorInstance actor = pw.actor_create(um.create(), &ar, MATRIX4X4_IDENTITY);
+
+			const Vector3 pos = { 1.0f, 2.0f, 3.0f };
+			pw.actor_teleport_world_position(actor, pos);
+			ENSURE(fequal(pw.actor_world_position(actor).x, 1.0f, 0.00001f));
+			ENSURE(fequal(pw.actor_world_position(actor).y, 2.0f, 0.00001f));
+			ENSURE(fequal(pw.actor_world_position(actor).z, 3.0f, 0.00001f));
+
+			const Quaternion rot = from_axis_angle(VECTOR3_YAXIS, PI_HALF);
+			pw.actor_teleport_world_rotation(actor, rot);
+			ENSURE(fequal(dot(pw.actor_world_rotation(actor), rot), 1.0f, 0.00001f));
+			ENSURE(fequal(pw.actor_world_position(actor).x, 1.0f, 0.00001f));
+
+			const Matrix4x4 pose = from_quaternion_translation(QUATERNION_IDENTITY, VECTOR3_ZERO);
+			pw.actor_teleport_world_pose(actor, pose);
+			ENSURE(fequal(pw.actor_world_position(actor).x, 0.0f, 0.00001f));
+			ENSURE(fequal(pw.actor_world_position(actor).y, 0.0f, 0.00001f));
+			ENSURE(fequal(pw.actor_world_position(actor).z, 0.0f, 0.00001f));
+			ENSURE(fequal(dot(pw.actor_world_rotation(actor), QUATERNION_IDENTITY), 1.0f, 0.00001f));
+		}
+
+		rm.unload(RESOURCE_TYPE_PHYSICS_CONFIG, StringId64("global"));
+
+		delete_test_tree(dir);
+	}
+	physics_globals::shutdown(default_allocator());
+	console_server_globals::shutdown();
+	job_system_globals::shutdown();
+	guid_globals::shutdown();
+	memory_globals::shutdown();
+#endif // CROWN_CAN_COMPILE && CROWN_PLATFORM_POSIX
+}
+
 #define RUN_TEST(name)      \
 	do {                    \
 		printf(#name "\n"); \
@@ -1553,7 +1952,9 @@ int main_unit_tests()
 	RUN_TEST(test_matrix4x4);
 	RUN_TEST(test_aabb);
 	RUN_TEST(test_sphere);
+	RUN_TEST(test_frustum);
 	RUN_TEST(test_murmur);
+	RUN_TEST(test_lz4);
 	RUN_TEST(test_string_id);
 	RUN_TEST(test_dynamic_string);
 	RUN_TEST(test_string_view);
@@ -1563,8 +1964,11 @@ int main_unit_tests()
 	RUN_TEST(test_path);
 	RUN_TEST(test_command_line);
 	RUN_TEST(test_thread);
+	RUN_TEST(test_job_system);
 	RUN_TEST(test_process);
 	RUN_TEST(test_filesystem);
+	RUN_TEST(test_data_compiler);
+	RUN_TEST(test_physics_world);
 
 	return EXIT_SUCCESS;
 }
@@ -4,15 +4,39 @@
  */
 
 #include "config.h"
+#include "core/containers/hash_map.inl"
 #include "core/json/json_object.inl"
 #include "core/json/sjson.h"
 #include "core/memory/temp_allocator.inl"
 #include "core/platform.h"
 #include "core/strings/dynamic_string.inl"
+#include "core/strings/string_id.inl"
 #include "device/boot_config.h"
+#include "device/log.h"
+#include <errno.h>
+#include <stdlib.h> // strtoull
+
+LOG_SYSTEM(BOOT_CONFIG, "boot_config")
 
 namespace crown
 {
+/// Parses the budget @a json, in megabytes, into @a budget. Returns false if
+/// @a json is not an integer in the range [0; UINT64_MAX >> 20].
+static bool parse_budget(u64& budget, const char* json)
+{
+	if (*json < '0' || *json > '9')
+		return false;
+
+	char* end;
+	errno = 0;
+	const unsigned long long val = strtoull(json, &end, 10);
+	if (errno != 0 || *end == '.' || *end == 'e' || *end == 'E' || val > (UINT64_MAX >> 20))
+		return false;
+
+	budget = val;
+	return true;
+}
+
 BootConfig::BootConfig(Allocator& a)
 	: boot_script_name(a)
 	, boot_package_name(u64(0))
@@ -22,6 +46,9 @@ BootConfig::BootConfig(Allocator& a)
 	, aspect_ratio(-1.0f)
 	, vsync(true)
 	, fullscreen(false)
+	, resource_cache(false)
+	, resource_budget(0)
+	, resource_budgets(a)
 {
 }
 
@@ -63,6 +90,39 @@ bool BootConfig::parse(const char* json)
 			if (json_object::has(renderer, "fullscreen"))
 				fullscreen = sjson::parse_bool(renderer["fullscreen"]);
 		}
+
+		if (json_object::has(platform, "resources"))
+		{
+			JsonObject resources(ta);
+			sjson::parse(resources, platform["resources"]);
+
+			if (json_object::has(resources, "cache"))
+				resource_cache = sjson::parse_bool(resources["cache"]);
+			if (json_object::has(resources, "budgets"))
+			{
+				JsonObject budgets(ta);
+				sjson::parse(budgets, resources["budgets"]);
+
+				auto cur = json_object::begin(budgets);
+				auto end = json_object::end(budgets);
+				for (; cur != end; ++cur)
+				{
+					JSON_OBJECT_SKIP_HOLE(budgets, cur);
+
+					u64 budget;
+					if (!parse_budget(budget, cur->second))
+					{
+						logw(BOOT_CONFIG, "Invalid budget: %.*s", cur->first.length(), cur->first.data());
+						continue;
+					}
+
+					if (cur->first == "total")
+						resource_budget = budget;
+					else
+						hash_map::set(resource_budgets, StringId64(cur->first.data(), cur->first.length()), budget);
+				}
+			}
+		}
 	}
 
 	return true;
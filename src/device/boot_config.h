@@ -5,6 +5,7 @@
 
 #pragma once
 
+#include "core/containers/types.h"
 #include "core/strings/dynamic_string.h"
 #include "core/strings/string_id.h"
 #include "core/types.h"
@@ -24,6 +25,9 @@ struct BootConfig
 	float aspect_ratio;
 	bool vsync;
 	bool fullscreen;
+	bool resource_cache;
+	u64 resource_budget;                       ///< In megabytes, 0 means no limit.
+	HashMap<StringId64, u64> resource_budgets; ///< In megabytes, per resource type.
 
 	BootConfig(Allocator& a);
 	bool parse(const char* json);
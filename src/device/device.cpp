@@ -5,6 +5,7 @@
 
 #include "config.h"
 #include "core/containers/array.inl"
+#include "core/containers/hash_map.inl"
 #include "core/filesystem/file.h"
 #include "core/filesystem/filesystem.h"
 #include "core/filesystem/filesystem_apk.h"
@@ -25,6 +26,7 @@
 #include "core/strings/string.inl"
 #include "core/strings/string_id.inl"
 #include "core/strings/string_stream.inl"
+#include "core/thread/job_system.h"
 #include "core/time.h"
 #include "core/types.h"
 #include "device/console_server.h"
@@ -215,12 +217,14 @@ Device::Device(const DeviceOptions& opts, ConsoleServer& cs)
 	, _pipeline(NULL)
 	, _display(NULL)
 	, _window(NULL)
+	, _loaded_packages(default_allocator())
 	, _width(0)
 	, _height(0)
 	, _quit(false)
 	, _paused(false)
 {
 	list::init_head(_worlds);
+	list::init_head(_resource_packages);
 }
 
 bool Device::process_events(bool vsync)
@@ -304,6 +308,7 @@ void Device::run()
 	logi(DEVICE, "Crown %s %s %s", CROWN_VERSION, CROWN_PLATFORM_NAME, CROWN_ARCH_NAME);
 
 	profiler_globals::init();
+	job_system_globals::init();
 
 	namespace smr = state_machine_internal;
 	namespace cor = config_resource_internal;
@@ -321,7 +326,7 @@ void Device::run()
 	namespace txr = texture_resource_internal;
 	namespace utr = unit_resource_internal;
 
-	_resource_loader  = CE_NEW(_allocator, ResourceLoader)(*_data_filesystem);
+	_resource_loader  = CE_NEW(_allocator, ResourceLoader)(*_data_filesystem, _options._num_loader_threads);
 	_resource_loader->register_fallback(RESOURCE_TYPE_TEXTURE,  STRING_ID_64("core/fallback/fallback", 0xd09058ae71962248));
 	_resource_loader->register_fallback(RESOURCE_TYPE_MATERIAL, STRING_ID_64("core/fallback/fallback", 0xd09058ae71962248));
 	_resource_loader->register_fallback(RESOURCE_TYPE_UNIT,     STRING_ID_64("core/fallback/fallback", 0xd09058ae71962248));
@@ -336,7 +341,7 @@ void Device::run()
 	_resource_manager->register_type(RESOURCE_TYPE_PHYSICS_CONFIG,   RESOURCE_VERSION_PHYSICS_CONFIG,   NULL,      NULL,        NULL,        NULL        );
 	_resource_manager->register_type(RESOURCE_TYPE_SCRIPT,           RESOURCE_VERSION_SCRIPT,           NULL,      NULL,        NULL,        NULL        );
 	_resource_manager->register_type(RESOURCE_TYPE_SHADER,           RESOURCE_VERSION_SHADER,           shr::load, shr::unload, shr::online, shr::offline);
-	_resource_manager->register_type(RESOURCE_TYPE_SOUND,            RESOURCE_VERSION_SOUND,            NULL,      NULL,        NULL,        NULL        );
+	_resource_manager->register_type(RESOURCE_TYPE_SOUND,            RESOURCE_VERSION_SOUND,            NULL,      NULL,        sdr::online, sdr::offline);
 	_resource_manager->register_type(RESOURCE_TYPE_SPRITE,           RESOURCE_VERSION_SPRITE,           NULL,      NULL,        NULL,        NULL        );
 	_resource_manager->register_type(RESOURCE_TYPE_SPRITE_ANIMATION, RESOURCE_VERSION_SPRITE_ANIMATION, NULL,      NULL,        NULL,        NULL        );
 	_resource_manager->register_type(RESOURCE_TYPE_STATE_MACHINE,    RESOURCE_VERSION_STATE_MACHINE,    NULL,      NULL,        NULL,        NULL        );
@@ -355,10 +360,21 @@ void Device::run()
 		boot_dir += CROWN_BOOT_CONFIG;
 
 		const StringId64 config_name(boot_dir.c_str());
-		_resource_manager->load(RESOURCE_TYPE_CONFIG, config_name);
+		_resource_manager->load(RESOURCE_TYPE_CONFIG, config_name, ResourcePriority::HIGH);
 		_resource_manager->flush();
 		_boot_config.parse((const char*)_resource_manager->get(RESOURCE_TYPE_CONFIG, config_name));
-		_resource_manager->unload(RESOURCE_TYPE_CONFIG, config_name);
+		_resource_manager->unload(RESOURCE_TYPE_CONFIG, config_name, ResourcePriority::HIGH);
+	}
+
+	_resource_manager->enable_cache(_boot_config.resource_cache);
+	_resource_manager->set_total_budget(_boot_config.resource_budget << 20);
+	auto cur = hash_map::begin(_boot_config.resource_budgets);
+	auto end = hash_map::end(_boot_config.resource_budgets);
+	for (; cur != end; ++cur)
+	{
+		HASH_MAP_SKIP_HOLE(_boot_config.resource_budgets, cur);
+
+		_resource_manager->set_budget(cur->first, cur->second << 20);
 	}
 
 	// Init all remaining subsystems
@@ -400,7 +416,7 @@ void Device::run()
 	bgfx::init(init);
 
 	_shader_manager   = CE_NEW(_allocator, ShaderManager)(default_allocator());
-	_material_manager = CE_NEW(_allocator, MaterialManager)(default_allocator(), *_resource_manager);
+	_material_manager = CE_NEW(_allocator, MaterialManager)(default_allocator(), *_resource_manager, *_shader_manager);
 	_input_manager    = CE_NEW(_allocator, InputManager)(default_allocator());
 	_unit_manager     = CE_NEW(_allocator, UnitManager)(default_allocator());
 	_lua_environment  = CE_NEW(_allocator, LuaEnvironment)();
@@ -410,6 +426,7 @@ void Device::run()
 	physics_globals::init(_allocator);
 
 	ResourcePackage* boot_package = create_resource_package(_boot_config.boot_package_name);
+	boot_package->set_priority(ResourcePriority::HIGH);
 	boot_package->load();
 	boot_package->flush();
 
@@ -455,6 +472,23 @@ void Device::run()
 		{
 			_resource_manager->complete_requests();
 
+			// LoadedFunctions may destroy any package, so they are called
+			// only after all the packages have been advanced.
+			ListNode* cur;
+			list_for_each(cur, &_resource_packages)
+			{
+				ResourcePackage* package = (ResourcePackage*)container_of(cur, ResourcePackage, _node);
+				if (package->advance())
+					array::push_back(_loaded_packages, package);
+			}
+
+			for (u32 i = 0; i < array::size(_loaded_packages); ++i)
+			{
+				if (_loaded_packages[i] != NULL)
+					_loaded_packages[i]->call_loaded_function();
+			}
+			array::clear(_loaded_packages);
+
 			{
 				const s64 t0 = time::now();
 				LuaStack stack(_lua_environment->L);
@@ -519,6 +553,7 @@ void Device::run()
 
 	CE_DELETE(_allocator, _data_filesystem);
 
+	job_system_globals::shutdown();
 	profiler_globals::shutdown();
 
 	_allocator.clear();
@@ -628,7 +663,7 @@ void Device::render(World& world, UnitId camera_unit)
 	bgfx::touch(VIEW_GUI);
 	bgfx::touch(VIEW_GRAPH);
 
-	world.render(view);
+	world.render(view, proj);
 
 #if !CROWN_TOOLS
 	_pipeline->render(*_shader_manager, STRING_ID_32("blit", 0xc04ce9f7), 0, _width, _height);
@@ -657,11 +692,20 @@ void Device::destroy_world(World& world)
 
 ResourcePackage* Device::create_resource_package(StringId64 id)
 {
-	return CE_NEW(default_allocator(), ResourcePackage)(id, *_resource_manager);
+	ResourcePackage* package = CE_NEW(default_allocator(), ResourcePackage)(id, *_resource_manager);
+	list::add(package->_node, _resource_packages);
+	return package;
 }
 
 void Device::destroy_resource_package(ResourcePackage& rp)
 {
+	for (u32 i = 0; i < array::size(_loaded_packages); ++i)
+	{
+		if (_loaded_packages[i] == &rp)
+			_loaded_packages[i] = NULL;
+	}
+
+	list::remove(rp._node);
 	CE_DELETE(default_allocator(), &rp);
 }
 
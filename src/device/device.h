@@ -6,6 +6,7 @@
 #pragma once
 
 #include "config.h"
+#include "core/containers/types.h"
 #include "core/filesystem/types.h"
 #include "core/list.h"
 #include "core/memory/allocator.h"
@@ -55,6 +56,8 @@ struct Device
 	Display* _display;
 	Window* _window;
 	ListNode _worlds;
+	ListNode _resource_packages;
+	Array<ResourcePackage*> _loaded_packages; ///< Packages whose LoadedFunction has to be called.
 
 	u16 _width;
 	u16 _height;
@@ -27,6 +27,7 @@ static void help(const char* msg = NULL)
 		"  -v --version                    Display engine version.\n"
 		"  --source-dir <path>             Specify the <path> of the project's source data.\n"
 		"  --data-dir <path>               Specify the <path> where to put the compiled data.\n"
+		"  --cache-dir <path>              Reuse compiled data from the cache at <path>.\n"
 		"  --map-source-dir <name> <path>  Mount <path>/<name> at <source-dir>/<name>.\n"
 		"  --boot-dir <prefix>             Use <prefix>/boot.config to boot the engine.\n"
 		"  --compile                       Compile the project's source data.\n"
@@ -34,6 +35,10 @@ static void help(const char* msg = NULL)
 		"      linux\n"
 		"      windows\n"
 		"      android\n"
+		"  --jobs <n>                      Run <n> data compiler jobs in parallel (default: one per processor).\n"
+		"  --bundle                        Pack the compiled data of each package into a single file.\n"
+		"  --compress <types>              Compress the compiled data of the comma-separated resource <types>.\n"
+		"  --loader-threads <n>            Decode resources on <n> threads (default: " CE_STRINGIZE(CROWN_DEFAULT_LOADER_THREADS) ").\n"
 		"  --continue                      Run the engine after the data has been compiled.\n"
 		"  --console-port <port>           Set port of the console server.\n"
 		"  --wait-console                  Wait for a console connection before booting the engine.\n"
@@ -54,15 +59,20 @@ DeviceOptions::DeviceOptions(Allocator& a, int argc, const char** argv)
 	, _map_source_dir_name(NULL)
 	, _map_source_dir_prefix(a)
 	, _data_dir(a)
+	, _cache_dir(a)
 	, _boot_dir(NULL)
 	, _platform(NULL)
+	, _compress(NULL)
 	, _lua_string(a)
 	, _wait_console(false)
 	, _do_compile(false)
+	, _do_bundle(false)
 	, _do_continue(false)
 	, _server(false)
 	, _parent_window(0)
 	, _console_port(CROWN_DEFAULT_CONSOLE_PORT)
+	, _num_jobs(0)
+	, _num_loader_threads(CROWN_DEFAULT_LOADER_THREADS)
 	, _window_x(0)
 	, _window_y(0)
 	, _window_width(CROWN_DEFAULT_WINDOW_WIDTH)
@@ -94,6 +104,7 @@ int DeviceOptions::parse(bool* quit)
 
 	path::reduce(_source_dir, cl.get_parameter(0, "source-dir"));
 	path::reduce(_data_dir, cl.get_parameter(0, "data-dir"));
+	path::reduce(_cache_dir, cl.get_parameter(0, "cache-dir"));
 
 	_map_source_dir_name = cl.get_parameter(0, "map-source-dir");
 	if (_map_source_dir_name)
@@ -139,6 +150,15 @@ int DeviceOptions::parse(bool* quit)
 		}
 	}
 
+	_do_bundle = cl.has_option("bundle");
+
+	_compress = cl.get_parameter(0, "compress");
+	if (cl.has_option("compress") && _compress == NULL)
+	{
+		help("Resource types to compress must be specified.");
+		return EXIT_FAILURE;
+	}
+
 	_server = cl.has_option("server");
 	if (_server)
 	{
@@ -158,6 +178,15 @@ int DeviceOptions::parse(bool* quit)
 		}
 	}
 
+	if (!_cache_dir.empty())
+	{
+		if (!path::is_absolute(_cache_dir.c_str()))
+		{
+			help("Cache dir must be absolute.");
+			return EXIT_FAILURE;
+		}
+	}
+
 	if (!_source_dir.empty())
 	{
 		if (!path::is_absolute(_source_dir.c_str()))
@@ -218,6 +247,26 @@ int DeviceOptions::parse(bool* quit)
 		}
 	}
 
+	const char* jobs = cl.get_parameter(0, "jobs");
+	if (jobs)
+	{
+		if (sscanf(jobs, "%u", &_num_jobs) != 1 || _num_jobs == 0)
+		{
+			help("Number of jobs is invalid.");
+			return EXIT_FAILURE;
+		}
+	}
+
+	const char* loader_threads = cl.get_parameter(0, "loader-threads");
+	if (loader_threads)
+	{
+		if (sscanf(loader_threads, "%u", &_num_loader_threads) != 1 || _num_loader_threads == 0)
+		{
+			help("Number of loader threads is invalid.");
+			return EXIT_FAILURE;
+		}
+	}
+
 	const char* ls = cl.get_parameter(0, "lua-string");
 	if (ls)
 		_lua_string = ls;
@@ -22,15 +22,20 @@ struct DeviceOptions
 	const char* _map_source_dir_name;
 	DynamicString _map_source_dir_prefix;
 	DynamicString _data_dir;
+	DynamicString _cache_dir;
 	const char* _boot_dir;
 	const char* _platform;
+	const char* _compress;
 	DynamicString _lua_string;
 	bool _wait_console;
 	bool _do_compile;
+	bool _do_bundle;
 	bool _do_continue;
 	bool _server;
 	u32 _parent_window;
 	u16 _console_port;
+	u32 _num_jobs;
+	u32 _num_loader_threads;
 	u16 _window_x;
 	u16 _window_y;
 	u16 _window_width;
@@ -13,6 +13,17 @@
 
 namespace crown
 {
+namespace profiler
+{
+	enum { THREAD_BUFFER_SIZE = 4 * 1024 };
+	static thread_local char _thread_buffer[THREAD_BUFFER_SIZE];
+	static thread_local u32 _thread_buffer_size = 0;
+	static thread_local u32 _thread_scope_depth = 0;
+	static thread_local bool _thread_is_main = false;
+	static Mutex _buffer_mutex;
+
+} // namespace profiler
+
 namespace profiler_globals
 {
 	char _mem[sizeof(Buffer)];
@@ -21,6 +32,7 @@ namespace profiler_globals
 	void init()
 	{
 		_buffer = new (_mem)Buffer(default_allocator());
+		profiler::_thread_is_main = true;
 	}
 
 	void shutdown()
@@ -43,11 +55,6 @@ namespace profiler_globals
 
 namespace profiler
 {
-	enum { THREAD_BUFFER_SIZE = 4 * 1024 };
-	static char _thread_buffer[THREAD_BUFFER_SIZE];
-	static u32 _thread_buffer_size = 0;
-	static Mutex _buffer_mutex;
-
 	static void flush_local_buffer()
 	{
 		ScopedMutex sm(_buffer_mutex);
@@ -78,6 +85,7 @@ namespace profiler
 		ev.time = time::now();
 
 		push(ProfilerEventType::ENTER_PROFILE_SCOPE, ev);
+		++_thread_scope_depth;
 	}
 
 	void leave_profile_scope()
@@ -86,6 +94,12 @@ namespace profiler
 		ev.time = time::now();
 
 		push(ProfilerEventType::LEAVE_PROFILE_SCOPE, ev);
+
+		// The main thread's buffer is flushed once per frame. Other threads
+		// flush whenever they leave their outermost scope so that the events
+		// of each scope reach the global buffer together.
+		if (--_thread_scope_depth == 0 && !_thread_is_main)
+			flush_local_buffer();
 	}
 
 	void record_float(const char* name, f32 value)
@@ -101,6 +101,20 @@ static const CursorModeInfo s_mode[] =
 };
 CE_STATIC_ASSERT(countof(s_mode) == CursorMode::COUNT);
 
+struct ResourcePriorityInfo
+{
+	const char* name;
+	ResourcePriority::Enum type;
+};
+
+static const ResourcePriorityInfo s_resource_priority[] =
+{
+	{ "high",   ResourcePriority::HIGH   },
+	{ "normal", ResourcePriority::NORMAL },
+	{ "low",    ResourcePriority::LOW    }
+};
+CE_STATIC_ASSERT(countof(s_resource_priority) == ResourcePriority::COUNT);
+
 static LightType::Enum name_to_light_type(const char* name)
 {
 	for (u32 i = 0; i < countof(s_light); ++i)
@@ -145,6 +159,46 @@ static CursorMode::Enum name_to_cursor_mode(const char* name)
 	return CursorMode::COUNT;
 }
 
+static ResourcePriority::Enum name_to_resource_priority(const char* name)
+{
+	for (u32 i = 0; i < countof(s_resource_priority); ++i)
+	{
+		if (strcmp(s_resource_priority[i].name, name) == 0)
+			return s_resource_priority[i].type;
+	}
+
+	return ResourcePriority::COUNT;
+}
+
+static void resource_package_loaded(ResourcePackage& package, void* user_data)
+{
+	const int ref = (int)(uintptr_t)user_data;
+	LuaEnvironment* env = device()->_lua_environment;
+
+	LuaStack stack(env->L);
+	lua_rawgeti(stack.L, LUA_REGISTRYINDEX, ref);
+	luaL_unref(stack.L, LUA_REGISTRYINDEX, ref);
+	stack.push_resource_package(&package);
+	int status = env->call(1, 0);
+	if (status != LUA_OK)
+	{
+		report(stack.L, status);
+		device()->pause();
+	}
+}
+
+/// Releases the Lua function passed to ResourcePackage.load(), if it has
+/// not been called yet.
+static void resource_package_release_callback(lua_State* L, ResourcePackage& package)
+{
+	if (package._loaded_function == resource_package_loaded)
+	{
+		luaL_unref(L, LUA_REGISTRYINDEX, (int)(uintptr_t)package._loaded_user_data);
+		package._loaded_function = NULL;
+		package._loaded_user_data = NULL;
+	}
+}
+
 static int vector3box_store(lua_State* L)
 {
 	LuaStack stack(L);
@@ -1612,6 +1666,7 @@ void load_api(LuaEnvironment& env)
 			const f32 volume      = nargs > 3 ? stack.get_float(4)   : 1.0f;
 			const Vector3& pos    = nargs > 4 ? stack.get_vector3(5) : VECTOR3_ZERO;
 			const f32 range       = nargs > 5 ? stack.get_float(6)   : 1000.0f;
+			const s32 priority    = nargs > 6 ? stack.get_int(7)     : 0;
 
 			char name_str[RESOURCE_ID_BUF_LEN];
 			LUA_ASSERT(device()->_resource_manager->can_get(RESOURCE_TYPE_SOUND, name)
@@ -1621,7 +1676,7 @@ void load_api(LuaEnvironment& env)
 				);
 			CE_UNUSED(name_str);
 
-			stack.push_sound_instance_id(world->play_sound(name, loop, volume, pos, range));
+			stack.push_sound_instance_id(world->play_sound(name, loop, volume, pos, range, priority));
 			return 1;
 		});
 	env.add_module_function("World", "stop_sound", [](lua_State* L)
@@ -2181,6 +2236,12 @@ void load_api(LuaEnvironment& env)
 			stack.get_render_world(1)->enable_debug_drawing(stack.get_bool(2));
 			return 0;
 		});
+	env.add_module_function("RenderWorld", "enable_instancing", [](lua_State* L)
+		{
+			LuaStack stack(L);
+			stack.get_render_world(1)->enable_instancing(stack.get_bool(2));
+			return 0;
+		});
 
 	env.add_module_function("PhysicsWorld", "actor_instance", [](lua_State* L)
 		{
@@ -2264,6 +2325,18 @@ void load_api(LuaEnvironment& env)
 			stack.get_physics_world(1)->actor_disable_collision(stack.get_actor_instance(2));
 			return 0;
 		});
+	env.add_module_function("PhysicsWorld", "actor_enable_collision_events", [](lua_State* L)
+		{
+			LuaStack stack(L);
+			stack.get_physics_world(1)->actor_enable_collision_events(stack.get_actor_instance(2));
+			return 0;
+		});
+	env.add_module_function("PhysicsWorld", "actor_disable_collision_events", [](lua_State* L)
+		{
+			LuaStack stack(L);
+			stack.get_physics_world(1)->actor_disable_collision_events(stack.get_actor_instance(2));
+			return 0;
+		});
 	env.add_module_function("PhysicsWorld", "actor_set_collision_filter", [](lua_State* L)
 		{
 			LuaStack stack(L);
@@ -2700,7 +2773,9 @@ void load_api(LuaEnvironment& env)
 	env.add_module_function("Device", "destroy_resource_package", [](lua_State* L)
 		{
 			LuaStack stack(L);
-			device()->destroy_resource_package(*stack.get_resource_package(1));
+			ResourcePackage* package = stack.get_resource_package(1);
+			resource_package_release_callback(L, *package);
+			device()->destroy_resource_package(*package);
 			return 0;
 		});
 	env.add_module_function("Device", "console_send", [](lua_State* L)
@@ -2728,6 +2803,37 @@ void load_api(LuaEnvironment& env)
 			device()->_resource_manager->enable_autoload(stack.get_bool(1));
 			return 0;
 		});
+	env.add_module_function("Device", "enable_resource_cache", [](lua_State* L)
+		{
+			LuaStack stack(L);
+			device()->_resource_manager->enable_cache(stack.get_bool(1));
+			return 0;
+		});
+	env.add_module_function("Device", "set_resource_budget", [](lua_State* L)
+		{
+			LuaStack stack(L);
+			const f64 megabytes = stack.get_float(1);
+			LUA_ASSERT(megabytes >= 0.0 && megabytes < f64(UINT64_MAX >> 20), stack, "Invalid budget: %f", megabytes);
+			const u64 size = u64(megabytes * 1024.0 * 1024.0);
+			if (stack.num_args() == 1)
+				device()->_resource_manager->set_total_budget(size);
+			else
+				device()->_resource_manager->set_budget(StringId64(stack.get_string(2)), size);
+			return 0;
+		});
+	env.add_module_function("Device", "resource_memory", [](lua_State* L)
+		{
+			LuaStack stack(L);
+			u64 memory;
+			u64 gpu_memory;
+			if (stack.num_args() == 0)
+				device()->_resource_manager->total_memory(&memory, &gpu_memory);
+			else
+				device()->_resource_manager->memory(StringId64(stack.get_string(1)), &memory, &gpu_memory);
+			stack.push_float(f32(memory) / (1024.0f * 1024.0f));
+			stack.push_float(f32(gpu_memory) / (1024.0f * 1024.0f));
+			return 2;
+		});
 	env.add_module_function("Device", "temp_count", [](lua_State* L)
 		{
 			LuaStack stack(L);
@@ -2911,13 +3017,39 @@ void load_api(LuaEnvironment& env)
 	env.add_module_function("ResourcePackage", "load", [](lua_State* L)
 		{
 			LuaStack stack(L);
-			stack.get_resource_package(1)->load();
+			ResourcePackage* package = stack.get_resource_package(1);
+
+			if (stack.num_args() > 1)
+			{
+				LUA_ASSERT(stack.is_function(2), stack, "Function expected");
+				if (package->_state != ResourcePackage::State::UNLOADED)
+					return 0;
+
+				lua_pushvalue(L, 2);
+				const int ref = luaL_ref(L, LUA_REGISTRYINDEX);
+				package->load(resource_package_loaded, (void*)(uintptr_t)ref);
+			}
+			else
+			{
+				package->load();
+			}
 			return 0;
 		});
 	env.add_module_function("ResourcePackage", "unload", [](lua_State* L)
 		{
 			LuaStack stack(L);
-			stack.get_resource_package(1)->unload();
+			ResourcePackage* package = stack.get_resource_package(1);
+			resource_package_release_callback(L, *package);
+			package->unload();
+			return 0;
+		});
+	env.add_module_function("ResourcePackage", "set_priority", [](lua_State* L)
+		{
+			LuaStack stack(L);
+			const char* name = stack.get_string(2);
+			const ResourcePriority::Enum rp = name_to_resource_priority(name);
+			LUA_ASSERT(rp != ResourcePriority::COUNT, stack, "Unknown resource priority: '%s'", name);
+			stack.get_resource_package(1)->set_priority(rp);
 			return 0;
 		});
 	env.add_module_function("ResourcePackage", "flush", [](lua_State* L)
@@ -2932,6 +3064,18 @@ void load_api(LuaEnvironment& env)
 			stack.push_bool(stack.get_resource_package(1)->has_loaded());
 			return 1;
 		});
+	env.add_module_function("ResourcePackage", "progress", [](lua_State* L)
+		{
+			LuaStack stack(L);
+			u32 num_loaded;
+			u32 num_resources;
+			u32 loaded_size;
+			stack.get_resource_package(1)->progress(&num_loaded, &num_resources, &loaded_size);
+			stack.push_int(num_loaded);
+			stack.push_int(num_resources);
+			stack.push_int(loaded_size);
+			return 3;
+		});
 	env.add_module_metafunction("ResourcePackage", "__tostring", [](lua_State* L)
 		{
 			LuaStack stack(L);
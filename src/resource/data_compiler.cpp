@@ -17,12 +17,15 @@
 #include "core/guid.inl"
 #include "core/json/json_object.inl"
 #include "core/json/sjson.h"
+#include "core/lz4.h"
 #include "core/memory/allocator.h"
 #include "core/memory/temp_allocator.inl"
+#include "core/murmur.h"
 #include "core/os.h"
 #include "core/strings/dynamic_string.inl"
 #include "core/strings/string_id.inl"
 #include "core/strings/string_stream.inl"
+#include "core/thread/job_system.h"
 #include "core/time.h"
 #include "device/console_server.h"
 #include "device/device_options.h"
@@ -37,6 +40,8 @@
 #include "resource/mesh_resource.h"
 #include "resource/package_resource.h"
 #include "resource/physics_resource.h"
+#include "resource/resource_bundle.h"
+#include "resource/resource_compression.h"
 #include "resource/resource_id.inl"
 #include "resource/shader_resource.h"
 #include "resource/sound_resource.h"
@@ -46,7 +51,9 @@
 #include "resource/types.h"
 #include "resource/unit_resource.h"
 #include <algorithm>
+#include <atomic>
 #include <inttypes.h>
+#include <string.h> // memcpy
 #if CROWN_PLATFORM_POSIX
 #include <signal.h>
 #elif CROWN_PLATFORM_WINDOWS
@@ -57,8 +64,9 @@ LOG_SYSTEM(DATA_COMPILER, "data_compiler")
 
 #define CROWN_DATA_VERSIONS "data_versions.sjson"
 #define CROWN_DATA_INDEX "data_index.sjson"
-#define CROWN_DATA_MTIMES "data_mtimes.sjson"
+#define CROWN_DATA_HASHES "data_hashes.sjson"
 #define CROWN_DATA_DEPENDENCIES "data_dependencies.sjson"
+#define CROWN_SOURCE_HASHES "source_hashes.sjson"
 
 namespace crown
 {
@@ -347,7 +355,7 @@ static void read_data_index(HashMap<StringId64, DynamicString>& index, Filesyste
 	parse_data_index(index, obj, sources);
 }
 
-static void parse_data_mtimes(HashMap<StringId64, u64>& mtimes, const JsonObject& obj, const HashMap<StringId64, DynamicString>& data_index)
+static void parse_data_hashes(HashMap<StringId64, u64>& hashes, const JsonObject& obj, const HashMap<StringId64, DynamicString>& data_index)
 {
 	auto cur = json_object::begin(obj);
 	auto end = json_object::end(obj);
@@ -363,16 +371,16 @@ static void parse_data_mtimes(HashMap<StringId64, u64>& mtimes, const JsonObject
 			continue;
 
 		TempAllocator64 ta;
-		DynamicString mtime_json(ta);
-		sjson::parse_string(mtime_json, cur->second);
+		DynamicString hash_json(ta);
+		sjson::parse_string(hash_json, cur->second);
 
-		u64 mtime;
-		sscanf(mtime_json.c_str(), "%" SCNu64, &mtime);
-		hash_map::set(mtimes, id, mtime);
+		u64 hash;
+		sscanf(hash_json.c_str(), "%" SCNx64, &hash);
+		hash_map::set(hashes, id, hash);
 	}
 }
 
-static void read_data_mtimes(HashMap<StringId64, u64>& mtimes, FilesystemDisk& data_fs, const char* filename, const HashMap<StringId64, DynamicString>& data_index)
+static void read_data_hashes(HashMap<StringId64, u64>& hashes, FilesystemDisk& data_fs, const char* filename, const HashMap<StringId64, DynamicString>& data_index)
 {
 	Buffer json = read(data_fs, filename);
 
@@ -380,7 +388,37 @@ static void read_data_mtimes(HashMap<StringId64, u64>& mtimes, FilesystemDisk& d
 	JsonObject obj(ta);
 	sjson::parse(obj, json);
 
-	parse_data_mtimes(mtimes, obj, data_index);
+	parse_data_hashes(hashes, obj, data_index);
+}
+
+static void read_source_hashes(HashMap<DynamicString, DataCompiler::SourceHash>& hashes, FilesystemDisk& data_fs, const char* filename, const SourceIndex& sources)
+{
+	Buffer json = read(data_fs, filename);
+
+	TempAllocator1024 ta;
+	JsonObject obj(ta);
+	sjson::parse(obj, json);
+
+	auto cur = json_object::begin(obj);
+	auto end = json_object::end(obj);
+	for (; cur != end; ++cur)
+	{
+		JSON_OBJECT_SKIP_HOLE(obj, cur);
+
+		DynamicString path(ta);
+		path.set(cur->first.data(), cur->first.length());
+
+		// Skip reading hashes of non-existent source files.
+		if (!hash_map::has(sources._paths, path))
+			continue;
+
+		DynamicString value(ta);
+		sjson::parse_string(value, cur->second);
+
+		DataCompiler::SourceHash sh;
+		if (sscanf(value.c_str(), "%" SCNu64 " %" SCNu64 " %" SCNx64, &sh.mtime, &sh.size, &sh.hash) == 3)
+			hash_map::set(hashes, path, sh);
+	}
 }
 
 static void add_dependency_internal(HashMap<StringId64, HashMap<DynamicString, u32> >& dependencies, ResourceId id, const DynamicString& dependency)
@@ -492,7 +530,7 @@ static void write_data_versions(FilesystemDisk& data_fs, const char* filename, c
 	data_fs.close(*file);
 }
 
-static void write_data_mtimes(FilesystemDisk& data_fs, const char* filename, const HashMap<StringId64, u64>& mtimes)
+static void write_data_hashes(FilesystemDisk& data_fs, const char* filename, const HashMap<StringId64, u64>& hashes)
 {
 	StringStream ss(default_allocator());
 
@@ -500,16 +538,48 @@ static void write_data_mtimes(FilesystemDisk& data_fs, const char* filename, con
 	if (file->is_open())
 	{
 
-		auto cur = hash_map::begin(mtimes);
-		auto end = hash_map::end(mtimes);
+		auto cur = hash_map::begin(hashes);
+		auto end = hash_map::end(hashes);
 		for (; cur != end; ++cur)
 		{
-			HASH_MAP_SKIP_HOLE(mtimes, cur);
+			HASH_MAP_SKIP_HOLE(hashes, cur);
 
 			TempAllocator64 ta;
 			DynamicString key(ta);
 			key.from_string_id(cur->first);
-			ss << "\"" << key.c_str() << "\" = \"" << cur->second << "\"\n";
+
+			char hash[17];
+			snprintf(hash, sizeof(hash), "%.16" PRIx64, cur->second);
+			ss << "\"" << key.c_str() << "\" = \"" << hash << "\"\n";
+		}
+
+		file->write(string_stream::c_str(ss), strlen32(string_stream::c_str(ss)));
+	}
+	data_fs.close(*file);
+}
+
+static void write_source_hashes(FilesystemDisk& data_fs, const char* filename, const HashMap<DynamicString, DataCompiler::SourceHash>& hashes)
+{
+	StringStream ss(default_allocator());
+
+	File* file = data_fs.open(filename, FileOpenMode::WRITE);
+	if (file->is_open())
+	{
+		auto cur = hash_map::begin(hashes);
+		auto end = hash_map::end(hashes);
+		for (; cur != end; ++cur)
+		{
+			HASH_MAP_SKIP_HOLE(hashes, cur);
+
+			char value[64];
+			snprintf(value
+				, sizeof(value)
+				, "%" PRIu64 " %" PRIu64 " %.16" PRIx64
+				, cur->second.mtime
+				, cur->second.size
+				, cur->second.hash
+				);
+			ss << "\"" << cur->first.c_str() << "\" = \"" << value << "\"\n";
 		}
 
 		file->write(string_stream::c_str(ss), strlen32(string_stream::c_str(ss)));
@@ -580,7 +650,9 @@ DataCompiler::DataCompiler(const DeviceOptions& opts, ConsoleServer& cs)
 	, _compilers(default_allocator())
 	, _globs(default_allocator())
 	, _data_index(default_allocator())
-	, _data_mtimes(default_allocator())
+	, _data_hashes(default_allocator())
+	, _source_hashes(default_allocator())
+	, _dependency_hashes(default_allocator())
 	, _data_dependencies(default_allocator())
 	, _data_requirements(default_allocator())
 	, _data_versions(default_allocator())
@@ -799,7 +871,8 @@ void DataCompiler::scan_and_restore(const char* data_dir)
 	data_fs.set_prefix(data_dir);
 
 	read_data_index(_data_index, data_fs, CROWN_DATA_INDEX, _source_index);
-	read_data_mtimes(_data_mtimes, data_fs, CROWN_DATA_MTIMES, _data_index);
+	read_data_hashes(_data_hashes, data_fs, CROWN_DATA_HASHES, _data_index);
+	read_source_hashes(_source_hashes, data_fs, CROWN_SOURCE_HASHES, _source_index);
 	read_data_dependencies(*this, data_fs, CROWN_DATA_DEPENDENCIES, _data_index);
 	read_data_versions(_data_versions, data_fs, CROWN_DATA_VERSIONS);
 	logi(DATA_COMPILER, "Restored state in " TIME_FMT, time::seconds(time::now() - time_start));
@@ -830,62 +903,142 @@ void DataCompiler::save(const char* data_dir)
 	data_fs.set_prefix(data_dir);
 
 	write_data_index(data_fs, CROWN_DATA_INDEX, _data_index);
-	write_data_mtimes(data_fs, CROWN_DATA_MTIMES, _data_mtimes);
+	write_data_hashes(data_fs, CROWN_DATA_HASHES, _data_hashes);
+	write_source_hashes(data_fs, CROWN_SOURCE_HASHES, _source_hashes);
 	write_data_dependencies(data_fs, CROWN_DATA_DEPENDENCIES, _data_index, _data_dependencies, _data_requirements);
 	write_data_versions(data_fs, CROWN_DATA_VERSIONS, _data_versions);
 	logi(DATA_COMPILER, "Saved state in " TIME_FMT, time::seconds(time::now() - time_start));
 }
 
-bool DataCompiler::dependency_changed(const DynamicString& path, ResourceId id, u64 dst_mtime)
+u64 DataCompiler::source_hash(const DynamicString& path)
 {
 	Stat stat;
 	stat.file_type = Stat::FileType::NO_ENTRY;
 	stat.size = 0;
 	stat.mtime = 0;
 	stat = hash_map::get(_source_index._paths, path, stat);
-	if (stat.file_type == Stat::FileType::NO_ENTRY || stat.mtime > dst_mtime)
-		return true;
+	if (stat.file_type == Stat::FileType::NO_ENTRY)
+		return 0u;
+
+	// Hash the file only if it has been touched since the last time.
+	SourceHash sh;
+	sh.mtime = UINT64_MAX;
+	sh.size = UINT64_MAX;
+	sh.hash = 0u;
+	sh = hash_map::get(_source_hashes, path, sh);
+	if (sh.mtime == stat.mtime && sh.size == stat.size)
+		return sh.hash;
+
+	TempAllocator256 ta;
+	DynamicString source_dir(ta);
+	this->source_dir(path.c_str(), source_dir);
+
+	FilesystemDisk source_fs(ta);
+	source_fs.set_prefix(source_dir.c_str());
 
-	const HashMap<DynamicString, u32> deffault(default_allocator());
-	const HashMap<DynamicString, u32>& deps = hash_map::get(_data_dependencies, id, deffault);
-	auto cur = hash_map::begin(deps);
-	auto end = hash_map::end(deps);
+	Buffer data = read(source_fs, path.c_str());
+
+	sh.mtime = stat.mtime;
+	sh.size = stat.size;
+	sh.hash = murmur64(array::begin(data), array::size(data), 0);
+	hash_map::set(_source_hashes, path, sh);
+	return sh.hash;
+}
+
+/// Mixes the name, contents and compiler version of the file @a path into
+/// @a hash.
+static u64 hash_dependency(DataCompiler& dc, u64 hash, const DynamicString& path)
+{
+	hash = murmur64(path.c_str(), path.length(), hash);
+
+	const u64 source_hash = dc.source_hash(path);
+	hash = murmur64(&source_hash, sizeof(source_hash), hash);
+
+	const char* type = resource_type(path.c_str());
+	if (type != NULL && dc.can_compile(type))
+	{
+		const u32 version = dc.data_version(type);
+		hash = murmur64(&version, sizeof(version), hash);
+	}
+
+	return hash;
+}
+
+u64 DataCompiler::dependency_hash(const DynamicString& path)
+{
+	const u64 hash_none = 0u;
+	u64 hash = hash_map::get(_dependency_hashes, path, hash_none);
+	if (hash == hash_none)
+	{
+		hash = hash_dependency(*this, 0u, path);
+		hash_map::set(_dependency_hashes, path, hash);
+	}
+
+	return hash;
+}
+
+void DataCompiler::dependency_closure(HashMap<DynamicString, u32>& closure, const HashMap<DynamicString, u32>& dependencies)
+{
+	auto cur = hash_map::begin(dependencies);
+	auto end = hash_map::end(dependencies);
 	for (; cur != end; ++cur)
 	{
-		HASH_MAP_SKIP_HOLE(deps, cur);
+		HASH_MAP_SKIP_HOLE(dependencies, cur);
 
-		if (path == cur->first)
+		if (hash_map::has(closure, cur->first))
 			continue;
 
-		if (dependency_changed(cur->first, resource_id(cur->first.c_str()), dst_mtime))
-			return true;
-	}
+		hash_map::set(closure, cur->first, 0u);
 
-	return false;
+		const HashMap<DynamicString, u32> deffault(default_allocator());
+		const HashMap<DynamicString, u32>& deps = hash_map::get(_data_dependencies, resource_id(cur->first.c_str()), deffault);
+		dependency_closure(closure, deps);
+	}
 }
 
-bool DataCompiler::version_changed(const DynamicString& path, ResourceId id)
+u64 DataCompiler::data_hash(const DynamicString& path, const HashMap<DynamicString, u32>& dependencies, const char* platform)
 {
+	u64 hash = murmur64(platform, strlen32(platform), 0);
+	hash = hash_dependency(*this, hash, path);
+
 	const char* type = resource_type(path.c_str());
-	if (data_version_stored(type) != data_version(type))
-		return true;
+	const u32 compression = type != NULL ? data_compression(type) : ResourceCompression::NONE;
+	if (compression != ResourceCompression::NONE)
+		hash = murmur64(&compression, sizeof(compression), hash);
+
+	// Dependencies are followed recursively, so that a change to any file
+	// down the chain changes the hash. They are hashed in a fixed order so
+	// that the result does not depend on the layout of the hash map.
+	HashMap<DynamicString, u32> closure(default_allocator());
+	dependency_closure(closure, dependencies);
 
-	const HashMap<DynamicString, u32> deffault(default_allocator());
-	const HashMap<DynamicString, u32>& deps = hash_map::get(_data_dependencies, id, deffault);
-	auto cur = hash_map::begin(deps);
-	auto end = hash_map::end(deps);
+	TempAllocator1024 ta;
+	Array<const DynamicString*> names(ta);
+
+	auto cur = hash_map::begin(closure);
+	auto end = hash_map::end(closure);
 	for (; cur != end; ++cur)
 	{
-		HASH_MAP_SKIP_HOLE(deps, cur);
+		HASH_MAP_SKIP_HOLE(closure, cur);
 
 		if (path == cur->first)
 			continue;
 
-		if (version_changed(cur->first, resource_id(cur->first.c_str())))
-			return true;
+		array::push_back(names, &cur->first);
 	}
 
-	return false;
+	std::sort(array::begin(names), array::end(names), [](const DynamicString* a, const DynamicString* b)
+		{
+			return *a < *b;
+		});
+
+	for (u32 i = 0; i < array::size(names); ++i)
+	{
+		const u64 dep_hash = dependency_hash(*names[i]);
+		hash = murmur64(&dep_hash, sizeof(dep_hash), hash);
+	}
+
+	return hash;
 }
 
 bool DataCompiler::path_matches_ignore_glob(const char* path)
@@ -906,10 +1059,480 @@ bool DataCompiler::path_is_special(const char* path)
 		;
 }
 
+struct CompileJob
+{
+	enum Result
+	{
+		NOT_COMPILED,
+		SUCCESS,
+		FAILURE
+	};
+
+	DataCompiler* data_compiler;
+	FilesystemDisk* data_fs;
+	FilesystemDisk* cache_fs; // NULL if the cache is disabled.
+	const DynamicString* path;
+	ResourceId id;
+	const char* platform;
+	DataCompiler::CompileFunction compiler;
+	HashMap<DynamicString, u32> new_dependencies;
+	HashMap<DynamicString, u32> new_requirements;
+	u64 manifest_hash; // Name of the cache manifest listing the dependencies.
+	u64 cache_hash;    // Name of the cached data, if the manifest exists.
+	bool cached;
+	Result result;
+	ResourceCompression::Enum compression;
+	u32 size;            // Size of the compiled data.
+	u32 compressed_size; // Size of the compiled data after compression.
+	s64 decode_time;     // Time taken to decompress the compiled data.
+
+	explicit CompileJob(Allocator& a)
+		: data_compiler(NULL)
+		, data_fs(NULL)
+		, cache_fs(NULL)
+		, path(NULL)
+		, platform(NULL)
+		, compiler(NULL)
+		, new_dependencies(a)
+		, new_requirements(a)
+		, manifest_hash(0u)
+		, cache_hash(0u)
+		, cached(false)
+		, result(NOT_COMPILED)
+		, compression(ResourceCompression::NONE)
+		, size(0u)
+		, compressed_size(0u)
+		, decode_time(0)
+	{
+	}
+};
+
+static void cache_filename(DynamicString& filename, u64 hash, const char* suffix)
+{
+	char name[32];
+	snprintf(name, sizeof(name), "%.16" PRIx64 ".%s", hash, suffix);
+	filename = name;
+}
+
+/// Writes @a size bytes of @a data to @a filename. The data is written to a
+/// temporary file in @a temp_dir first and then renamed, so that readers
+/// never see partially written files and mappings of the old file, e.g. by
+/// a running engine, stay valid.
+static bool write_file(FilesystemDisk& fs, const char* filename, const char* temp_dir, const char* data, u32 size)
+{
+	TempAllocator1024 ta;
+	DynamicString guid(ta);
+	guid.from_guid(guid::new_guid());
+	DynamicString tmp(ta);
+	path::join(tmp, temp_dir, guid.c_str());
+	tmp += ".tmp";
+
+	File* file = fs.open(tmp.c_str(), FileOpenMode::WRITE);
+	bool success = file->is_open() && file->write(data, size) == size;
+	fs.close(*file);
+
+	DynamicString tmp_path(ta);
+	DynamicString path(ta);
+	fs.absolute_path(tmp_path, tmp.c_str());
+	fs.absolute_path(path, filename);
+
+	success = success && os::rename(tmp_path.c_str(), path.c_str()) == 0;
+	if (!success)
+		fs.delete_file(tmp.c_str());
+
+	return success;
+}
+
+static bool read_cache_manifest(HashMap<DynamicString, u32>& dependencies, HashMap<DynamicString, u32>& requirements, FilesystemDisk& cache_fs, const char* filename)
+{
+	if (!cache_fs.exists(filename))
+		return false;
+
+	Buffer json = read(cache_fs, filename);
+
+	TempAllocator1024 ta;
+	JsonObject obj(ta);
+	sjson::parse(obj, json);
+
+	if (!json_object::has(obj, "dependencies") || !json_object::has(obj, "requirements"))
+		return false;
+
+	JsonArray deps(ta);
+	sjson::parse_array(deps, obj["dependencies"]);
+	for (u32 i = 0; i < array::size(deps); ++i)
+	{
+		DynamicString path(ta);
+		sjson::parse_string(path, deps[i]);
+		hash_map::set(dependencies, path, 0u);
+	}
+
+	JsonArray reqs(ta);
+	sjson::parse_array(reqs, obj["requirements"]);
+	for (u32 i = 0; i < array::size(reqs); ++i)
+	{
+		DynamicString path(ta);
+		sjson::parse_string(path, reqs[i]);
+		hash_map::set(requirements, path, 0u);
+	}
+
+	return true;
+}
+
+static void write_cache_manifest(FilesystemDisk& cache_fs, const char* filename, const HashMap<DynamicString, u32>& dependencies, const HashMap<DynamicString, u32>& requirements)
+{
+	StringStream ss(default_allocator());
+
+	ss << "dependencies = [\n";
+	auto cur = hash_map::begin(dependencies);
+	auto end = hash_map::end(dependencies);
+	for (; cur != end; ++cur)
+	{
+		HASH_MAP_SKIP_HOLE(dependencies, cur);
+
+		ss << "    \"" << cur->first.c_str() << "\"\n";
+	}
+	ss << "]\n";
+
+	ss << "requirements = [\n";
+	cur = hash_map::begin(requirements);
+	end = hash_map::end(requirements);
+	for (; cur != end; ++cur)
+	{
+		HASH_MAP_SKIP_HOLE(requirements, cur);
+
+		ss << "    \"" << cur->first.c_str() << "\"\n";
+	}
+	ss << "]\n";
+
+	const char* str = string_stream::c_str(ss);
+	write_file(cache_fs, filename, ".", str, strlen32(str));
+}
+
+/// Compresses the @a output of @a job into @a compressed and measures how
+/// fast it decompresses.
+static void compress(Buffer& compressed, CompileJob& job, const Buffer& output)
+{
+	ResourceCompressionHeader header;
+	header.magic = RESOURCE_COMPRESSED_MAGIC;
+	header.compression = job.compression;
+	header.size = array::size(output);
+	array::resize(compressed, sizeof(header) + lz4_compress_bound(header.size));
+	header.compressed_size = lz4_compress(array::begin(compressed) + sizeof(header), array::begin(output), header.size);
+	array::resize(compressed, sizeof(header) + header.compressed_size);
+	memcpy(array::begin(compressed), &header, sizeof(header));
+
+	Buffer decompressed(default_allocator());
+	array::resize(decompressed, header.size);
+	const s64 time_start = time::now();
+	lz4_decompress(array::begin(decompressed), header.size, array::begin(compressed) + sizeof(header), header.compressed_size);
+	job.decode_time = time::now() - time_start;
+
+	job.size = header.size;
+	job.compressed_size = array::size(compressed);
+}
+
+/// Decompresses @a data in-place if it is compressed. Returns false if the
+/// data is corrupted.
+static bool decompress(Buffer& data)
+{
+	ResourceCompressionHeader header;
+	if (array::size(data) < sizeof(header))
+		return true;
+
+	memcpy(&header, array::begin(data), sizeof(header));
+	if (header.magic != RESOURCE_COMPRESSED_MAGIC)
+		return true;
+
+	Buffer decompressed(default_allocator());
+	array::resize(decompressed, header.size);
+	if (header.compression != ResourceCompression::LZ4
+		|| header.compressed_size > array::size(data) - sizeof(header)
+		|| !lz4_decompress(array::begin(decompressed), header.size, array::begin(data) + sizeof(header), header.compressed_size)
+		)
+		return false;
+
+	data = decompressed;
+	return true;
+}
+
+struct CompileBatch
+{
+	CompileJob** jobs;
+	std::atomic_bool failed;
+};
+
+static void compile_resource(CompileJob& job)
+{
+	DataCompiler& dc = *job.data_compiler;
+	const DynamicString& path = *job.path;
+	logi(DATA_COMPILER, dc._options->_server ? RESOURCE_ID_FMT_STR : "%s", path.c_str());
+
+	// Build destination file path
+	TempAllocator256 ta;
+	DynamicString dest(ta);
+	destination_path(dest, job.id);
+
+	// Reuse the data from the cache if available
+	if (job.cache_hash != 0u)
+	{
+		DynamicString filename(ta);
+		cache_filename(filename, job.cache_hash, "data");
+
+		if (job.cache_fs->exists(filename.c_str()))
+		{
+			Buffer data = read(*job.cache_fs, filename.c_str());
+
+			if (write_file(*job.data_fs, dest.c_str(), CROWN_TEMP_DIRECTORY, array::begin(data), array::size(data)))
+			{
+				job.cached = true;
+				job.result = CompileJob::SUCCESS;
+				return;
+			}
+		}
+
+		// Cache miss: the dependencies read from the manifest will be
+		// regenerated by the compiler.
+		hash_map::clear(job.new_dependencies);
+		hash_map::clear(job.new_requirements);
+	}
+
+	// Dependencies and requirements lists must be regenerated each time
+	// the resource is being compiled. For example, if you delete
+	// "foo.unit" from a package, you do not want the list of
+	// requirements to include "foo.unit" again the next time that
+	// package is compiled.
+	Buffer output(default_allocator());
+	FileBuffer file_buffer(output);
+	// Invoke compiler
+	CompileOptions opts(file_buffer
+		, job.new_dependencies
+		, job.new_requirements
+		, dc
+		, *job.data_fs
+		, job.id
+		, path
+		, job.platform
+		);
+	bool success = job.compiler(opts) == 0;
+
+	if (success)
+	{
+		const char* data = array::begin(output);
+		u32 size = array::size(output);
+
+		// Data that does not shrink is stored uncompressed.
+		Buffer compressed(default_allocator());
+		if (job.compression != ResourceCompression::NONE)
+		{
+			compress(compressed, job, output);
+			if (array::size(compressed) < size)
+			{
+				data = array::begin(compressed);
+				size = array::size(compressed);
+			}
+			else
+			{
+				job.compressed_size = size;
+			}
+		}
+
+		// Write output to disk
+		success = write_file(*job.data_fs, dest.c_str(), CROWN_TEMP_DIRECTORY, data, size);
+	}
+
+	job.result = success ? CompileJob::SUCCESS : CompileJob::FAILURE;
+}
+
+/// Packs the compiled data of the resources in the package @a id into its
+/// bundle.
+static void write_bundle(FilesystemDisk& data_fs, ResourceId id, const PackageResource::Resource* resources, u32 num)
+{
+	TempAllocator1024 ta;
+	Array<ResourceBundleEntry> entries(default_allocator());
+
+	for (u32 i = 0; i < num; ++i)
+	{
+		// Resources without data are left to the loader's fallback.
+		DynamicString path(ta);
+		destination_path(path, resource_id(resources[i].type, resources[i].name));
+		if (!data_fs.exists(path.c_str()))
+			continue;
+
+		ResourceBundleEntry entry;
+		entry.type   = resources[i].type;
+		entry.name   = resources[i].name;
+		entry.offset = 0;
+		entry.size   = 0;
+		array::push_back(entries, entry);
+	}
+	num = array::size(entries);
+
+	std::sort(array::begin(entries), array::end(entries), [](const ResourceBundleEntry& a, const ResourceBundleEntry& b)
+		{
+			return resource_id(a.type, a.name) < resource_id(b.type, b.name);
+		});
+
+	ResourceBundleHeader header;
+	header.version = RESOURCE_HEADER(RESOURCE_BUNDLE_VERSION);
+	header.num_resources = num;
+
+	// Write to a temporary file to not disturb running engines which might
+	// be reading from the old bundle.
+	DynamicString guid(ta);
+	guid.from_guid(guid::new_guid());
+	DynamicString tmp(ta);
+	path::join(tmp, CROWN_TEMP_DIRECTORY, guid.c_str());
+	tmp += ".bundle";
+
+	File* file = data_fs.open(tmp.c_str(), FileOpenMode::WRITE);
+	if (!file->is_open())
+	{
+		data_fs.close(*file);
+		return;
+	}
+
+	const char padding[RESOURCE_BUNDLE_ALIGN] = { 0 };
+	u32 offset = sizeof(header) + sizeof(ResourceBundleEntry)*num;
+	file->write(&header, sizeof(header));
+	file->write(array::begin(entries), sizeof(ResourceBundleEntry)*num);
+
+	for (u32 i = 0; i < num; ++i)
+	{
+		DynamicString path(ta);
+		destination_path(path, resource_id(entries[i].type, entries[i].name));
+		Buffer data = read(data_fs, path.c_str());
+
+		const u32 aligned = (offset + RESOURCE_BUNDLE_ALIGN - 1) & ~(RESOURCE_BUNDLE_ALIGN - 1);
+		file->write(padding, aligned - offset);
+		file->write(array::begin(data), array::size(data));
+
+		entries[i].offset = aligned;
+		entries[i].size   = array::size(data);
+		offset = aligned + array::size(data);
+	}
+
+	file->seek(sizeof(header));
+	file->write(array::begin(entries), sizeof(ResourceBundleEntry)*num);
+	data_fs.close(*file);
+
+	DynamicString bundle(ta);
+	bundle_path(bundle, id);
+	DynamicString tmp_path(ta);
+	DynamicString bundle_abs_path(ta);
+	data_fs.absolute_path(tmp_path, tmp.c_str());
+	data_fs.absolute_path(bundle_abs_path, bundle.c_str());
+	if (os::rename(tmp_path.c_str(), bundle_abs_path.c_str()) != 0)
+		data_fs.delete_file(tmp.c_str());
+}
+
+/// Rebuilds the bundles of the packages that changed or that contain any of
+/// the @a compiled resources. If @a bundle is false, the bundles are deleted
+/// instead, so that the runtime does not load stale data from them.
+static void update_bundles(DataCompiler& dc, FilesystemDisk& data_fs, const HashMap<StringId64, u32>& compiled, bool bundle)
+{
+	auto cur = hash_map::begin(dc._data_index);
+	auto end = hash_map::end(dc._data_index);
+	for (; cur != end; ++cur)
+	{
+		HASH_MAP_SKIP_HOLE(dc._data_index, cur);
+
+		if (!cur->second.has_suffix(".package"))
+			continue;
+
+		TempAllocator256 ta;
+		DynamicString path(ta);
+		bundle_path(path, cur->first);
+
+		if (!bundle)
+		{
+			if (data_fs.exists(path.c_str()))
+				data_fs.delete_file(path.c_str());
+			continue;
+		}
+
+		DynamicString package_path(ta);
+		destination_path(package_path, cur->first);
+		Buffer package = read(data_fs, package_path.c_str());
+		if (!decompress(package) || array::size(package) < sizeof(u32)*2)
+			continue;
+
+		const u32* header = (u32*)array::begin(package);
+		if (header[0] != RESOURCE_HEADER(RESOURCE_VERSION_PACKAGE))
+			continue;
+
+		const u32 num = header[1];
+		const PackageResource::Resource* resources = (PackageResource::Resource*)&header[2];
+
+		bool changed = hash_map::has(compiled, cur->first) || !data_fs.exists(path.c_str());
+		for (u32 i = 0; i < num && !changed; ++i)
+			changed = hash_map::has(compiled, resource_id(resources[i].type, resources[i].name));
+
+		if (changed)
+			write_bundle(data_fs, cur->first, resources, num);
+	}
+}
+
+/// Compression statistics of a resource type.
+struct CompressionStats
+{
+	const char* type;
+	u32 num;
+	u64 size;
+	u64 compressed_size;
+	s64 decode_time;
+};
+
+static void add_compression_stats(Array<CompressionStats>& stats, const CompileJob& job)
+{
+	const char* type = resource_type(job.path->c_str());
+
+	u32 i = 0;
+	for (; i < array::size(stats); ++i)
+	{
+		if (strcmp(stats[i].type, type) == 0)
+			break;
+	}
+
+	if (i == array::size(stats))
+	{
+		CompressionStats cs;
+		cs.type = type;
+		cs.num = 0u;
+		cs.size = 0u;
+		cs.compressed_size = 0u;
+		cs.decode_time = 0;
+		array::push_back(stats, cs);
+	}
+
+	++stats[i].num;
+	stats[i].size += job.size;
+	stats[i].compressed_size += job.compressed_size;
+	stats[i].decode_time += job.decode_time;
+}
+
+static void compile_resources(u32 begin, u32 end, void* user_data)
+{
+	CompileBatch* batch = (CompileBatch*)user_data;
+
+	for (u32 i = begin; i < end; ++i)
+	{
+		// Do not start new compilations after the first failure.
+		if (batch->failed)
+			return;
+
+		compile_resource(*batch->jobs[i]);
+		if (batch->jobs[i]->result == CompileJob::FAILURE)
+			batch->failed = true;
+	}
+}
+
 bool DataCompiler::compile(const char* data_dir, const char* platform)
 {
 	const s64 time_start = time::now();
 
+	// Sources may have changed since the last run.
+	hash_map::clear(_dependency_hashes);
+
 	FilesystemDisk data_fs(default_allocator());
 	data_fs.set_prefix(data_dir);
 	data_fs.create_directory("");
@@ -942,16 +1565,17 @@ bool DataCompiler::compile(const char* data_dir, const char* platform)
 
 			const ResourceId id = resource_id(path.c_str());
 
-			const u64 mtime_epoch = 0u;
-			const u64 mtime = hash_map::get(_data_mtimes, id, mtime_epoch);
+			const HashMap<DynamicString, u32> deffault(default_allocator());
+			const HashMap<DynamicString, u32>& deps = hash_map::get(_data_dependencies, id, deffault);
+
+			const u64 hash_none = 0u;
+			const u64 hash = hash_map::get(_data_hashes, id, hash_none);
 
-			bool source_never_compiled_before    = hash_map::has(_data_index, id) == false;
-			bool source_dependency_changed       = dependency_changed(path, id, mtime);
-			bool data_version_dependency_changed = version_changed(path, id);
+			bool source_never_compiled_before = hash_map::has(_data_index, id) == false;
+			bool source_or_version_changed    = hash != data_hash(path, deps, platform);
 
 			if (source_never_compiled_before
-				|| source_dependency_changed
-				|| data_version_dependency_changed
+				|| source_or_version_changed
 				)
 			{
 				vector::push_back(to_compile, path);
@@ -969,6 +1593,7 @@ bool DataCompiler::compile(const char* data_dir, const char* platform)
 	{
 		// Remove from source index
 		hash_map::remove(_source_index._paths, to_remove[i]);
+		hash_map::remove(_source_hashes, to_remove[i]);
 
 		// If it does not have extension it cannot be a resource so it cannot be
 		// in tracking structures nor in the data folder.
@@ -978,7 +1603,7 @@ bool DataCompiler::compile(const char* data_dir, const char* platform)
 		// Remove from tracking structures
 		ResourceId id = resource_id(to_remove[i].c_str());
 		hash_map::remove(_data_index, id);
-		hash_map::remove(_data_mtimes, id);
+		hash_map::remove(_data_hashes, id);
 		hash_map::remove(_data_dependencies, id);
 		hash_map::remove(_data_requirements, id);
 
@@ -1003,13 +1628,21 @@ bool DataCompiler::compile(const char* data_dir, const char* platform)
 #undef PACKAGE
 		});
 
-	bool success = true;
+	FilesystemDisk cache_fs(default_allocator());
+	const bool use_cache = !_options->_cache_dir.empty();
+	if (use_cache)
+	{
+		cache_fs.set_prefix(_options->_cache_dir.c_str());
+		cache_fs.create_directory("");
+	}
+
+	// Create a compile job for each resource
+	Array<CompileJob*> jobs(default_allocator());
+	u32 num_packages = 0;
 
-	// Compile all changed resources
 	for (u32 i = 0; i < vector::size(to_compile); ++i)
 	{
 		const DynamicString& path = to_compile[i];
-		logi(DATA_COMPILER, _options->_server ? RESOURCE_ID_FMT_STR : "%s", path.c_str());
 
 		const char* type = resource_type(path.c_str());
 		if (type == NULL || !can_compile(type))
@@ -1019,84 +1652,169 @@ bool DataCompiler::compile(const char* data_dir, const char* platform)
 			continue;
 		}
 
-		// Build destination file path
-		ResourceId id = resource_id(path.c_str());
-		TempAllocator256 ta;
-		DynamicString dest(ta);
-		destination_path(dest, id);
+		TempAllocator64 ta;
+		DynamicString type_str(ta);
+		type_str = type;
 
-		// Compile data
 		ResourceTypeData rtd;
 		rtd.version = 0;
 		rtd.compiler = NULL;
+		rtd.compression = ResourceCompression::NONE;
+		rtd = hash_map::get(_compilers, type_str, rtd);
 
-		DynamicString type_str(ta);
-		type_str = type;
+		CompileJob* job = CE_NEW(default_allocator(), CompileJob)(default_allocator());
+		job->data_compiler = this;
+		job->data_fs = &data_fs;
+		job->path = &path;
+		job->id = resource_id(path.c_str());
+		job->platform = platform;
+		job->compiler = rtd.compiler;
+		job->compression = rtd.compression;
+
+		// The cache manifest is named after the hash of the resource alone
+		// and lists the files it depended on the last time it was compiled.
+		// The cached data is named after the hash of all those files.
+		if (use_cache && !path_is_special(path.c_str()))
+		{
+			const HashMap<DynamicString, u32> deps_none(default_allocator());
+			job->cache_fs = &cache_fs;
+			job->manifest_hash = data_hash(path, deps_none, platform);
 
-		rtd = hash_map::get(_compilers, type_str, rtd);
+			DynamicString manifest(ta);
+			cache_filename(manifest, job->manifest_hash, "sjson");
+
+			if (read_cache_manifest(job->new_dependencies, job->new_requirements, cache_fs, manifest.c_str()))
+				job->cache_hash = data_hash(path, job->new_dependencies, platform);
+		}
+
+		array::push_back(jobs, job);
+
+		if (path.has_suffix(".package"))
+			++num_packages;
+	}
+
+	// Update the tracking structures in the same order the resources have
+	// been sorted in, so that the results do not depend on the scheduling.
+	bool success = true;
+	HashMap<StringId64, u32> compiled(default_allocator());
+	Array<CompressionStats> stats(default_allocator());
+
+	auto merge_results = [&](u32 begin, u32 end)
+	{
+		// Update dependencies and requirements only if compiler(opts)
+		// succeeded. If the compilation fails due to a missing dependency
+		// and you update the dependency database with new partial data, the
+		// next call to compile() would not trigger a recompilation. They are
+		// all updated before any hash is computed, since hashes follow the
+		// dependencies of the dependencies.
+		for (u32 i = begin; i < end; ++i)
 		{
-			// Dependencies and requirements lists must be regenerated each time
-			// the resource is being compiled. For example, if you delete
-			// "foo.unit" from a package, you do not want the list of
-			// requirements to include "foo.unit" again the next time that
-			// package is compiled.
-			HashMap<DynamicString, u32> new_dependencies(default_allocator());
-			HashMap<DynamicString, u32> new_requirements(default_allocator());
-
-			Buffer output(default_allocator());
-			FileBuffer file_buffer(output);
-			// Invoke compiler
-			CompileOptions opts(file_buffer
-				, new_dependencies
-				, new_requirements
-				, *this
-				, data_fs
-				, id
-				, path
-				, platform
-				);
-			success = rtd.compiler(opts) == 0;
+			CompileJob* job = jobs[i];
 
-			if (success)
+			if (job->result == CompileJob::SUCCESS)
 			{
-				// Update dependencies and requirements only if compiler(opts)
-				// succeeded. If the compilation fails due to a missing
-				// dependency and you update the dependency database with new
-				// partial data, the next call to compile() would not trigger a
-				// recompilation.
 				HashMap<DynamicString, u32> dependencies_deffault(default_allocator());
-				hash_map::clear(hash_map::get(_data_dependencies, id, dependencies_deffault));
+				hash_map::clear(hash_map::get(_data_dependencies, job->id, dependencies_deffault));
 				HashMap<DynamicString, u32> requirements_deffault(default_allocator());
-				hash_map::clear(hash_map::get(_data_requirements, id, requirements_deffault));
-				hash_map::set(_data_dependencies, id, new_dependencies);
-				hash_map::set(_data_requirements, id, new_requirements);
-
-				// Write output to disk
-				File* outf = data_fs.open(dest.c_str(), FileOpenMode::WRITE);
-				u32 size = array::size(output);
-				u32 written = outf->write(array::begin(output), size);
-				data_fs.close(*outf);
-
-				success = size == written;
+				hash_map::clear(hash_map::get(_data_requirements, job->id, requirements_deffault));
+				hash_map::set(_data_dependencies, job->id, job->new_dependencies);
+				hash_map::set(_data_requirements, job->id, job->new_requirements);
 			}
 		}
 
-		if (success)
+		for (u32 i = begin; i < end; ++i)
 		{
-			// Do not include special paths in content tracking structures.
-			if (!path_is_special(path.c_str()))
+			CompileJob* job = jobs[i];
+
+			if (job->result == CompileJob::SUCCESS)
+			{
+				hash_map::set(compiled, job->id, 0u);
+
+				if (job->compression != ResourceCompression::NONE && !job->cached)
+					add_compression_stats(stats, *job);
+
+				// Do not include special paths in content tracking structures.
+				if (!path_is_special(job->path->c_str()))
+				{
+					const u64 hash = job->cached
+						? job->cache_hash
+						: data_hash(*job->path, job->new_dependencies, platform)
+						;
+
+					hash_map::set(_data_index, job->id, *job->path);
+					hash_map::set(_data_hashes, job->id, hash);
+					hash_map::set(_data_revisions, job->id, _revision + 1);
+
+					// Store freshly compiled data in the cache. The manifest
+					// lists every file the data depends on, directly or not,
+					// so that the hash can be computed without knowing the
+					// dependencies of the dependencies.
+					if (job->cache_fs != NULL && !job->cached)
+					{
+						TempAllocator256 ta;
+						DynamicString dest(ta);
+						destination_path(dest, job->id);
+						DynamicString filename(ta);
+
+						HashMap<DynamicString, u32> closure(default_allocator());
+						dependency_closure(closure, job->new_dependencies);
+
+						cache_filename(filename, job->manifest_hash, "sjson");
+						write_cache_manifest(cache_fs, filename.c_str(), closure, job->new_requirements);
+
+						Buffer data = read(data_fs, dest.c_str());
+						cache_filename(filename, hash, "data");
+						write_file(cache_fs, filename.c_str(), ".", array::begin(data), array::size(data));
+					}
+				}
+			}
+			else if (job->result == CompileJob::FAILURE)
 			{
-				hash_map::set(_data_index, id, path);
-				hash_map::set(_data_mtimes, id, data_fs.last_modified_time(dest.c_str()));
-				hash_map::set(_data_revisions, id, _revision + 1);
+				success = false;
 			}
+
+			CE_DELETE(default_allocator(), job);
 		}
-		else
-		{
-			loge(DATA_COMPILER, "Failed to compile data");
-			break;
-		}
+	};
+
+	// Resources are compiled in parallel. Packages bring in the
+	// requirements of the resources they list, so they are compiled only
+	// after the results of every other resource have been merged.
+	const u32 num_jobs = array::size(jobs);
+	const u32 num_resources = num_jobs - num_packages;
+
+	CompileBatch batch;
+	batch.jobs = array::begin(jobs);
+	batch.failed = false;
+
+	job_system::parallel_for(num_resources, 1, compile_resources, &batch);
+	merge_results(0, num_resources);
+
+	if (!batch.failed)
+	{
+		batch.jobs = array::begin(jobs) + num_resources;
+		job_system::parallel_for(num_packages, 1, compile_resources, &batch);
 	}
+	merge_results(num_resources, num_jobs);
+
+	for (u32 i = 0; i < array::size(stats); ++i)
+	{
+		const CompressionStats& cs = stats[i];
+		const f64 seconds = time::seconds(cs.decode_time);
+		logi(DATA_COMPILER, "Compressed %u %s: %" PRIu64 " -> %" PRIu64 " bytes (%.1f%%), decode %.1f MiB/s"
+			, cs.num
+			, cs.type
+			, cs.size
+			, cs.compressed_size
+			, cs.size != 0u ? 100.0*cs.compressed_size/cs.size : 100.0
+			, seconds > 0.0 ? cs.size/seconds/(1024.0*1024.0) : 0.0
+			);
+	}
+
+	if (!success)
+		loge(DATA_COMPILER, "Failed to compile data");
+	else
+		update_bundles(*this, data_fs, compiled, _options->_do_bundle);
 
 	if (success)
 	{
@@ -1138,10 +1856,41 @@ void DataCompiler::register_compiler(const char* type, u32 version, CompileFunct
 	ResourceTypeData rtd;
 	rtd.version = version;
 	rtd.compiler = compiler;
+	rtd.compression = ResourceCompression::NONE;
+
+	hash_map::set(_compilers, type_str, rtd);
+}
+
+void DataCompiler::set_compression(const char* type, ResourceCompression::Enum compression)
+{
+	TempAllocator64 ta;
+	DynamicString type_str(ta);
+	type_str = type;
 
+	CE_ASSERT(hash_map::has(_compilers, type_str), "Type not registered");
+
+	ResourceTypeData rtd;
+	rtd.version = COMPILER_NOT_FOUND;
+	rtd.compiler = NULL;
+	rtd.compression = ResourceCompression::NONE;
+	rtd = hash_map::get(_compilers, type_str, rtd);
+	rtd.compression = compression;
 	hash_map::set(_compilers, type_str, rtd);
 }
 
+ResourceCompression::Enum DataCompiler::data_compression(const char* type)
+{
+	TempAllocator64 ta;
+	DynamicString type_str(ta);
+	type_str = type;
+
+	ResourceTypeData rtd;
+	rtd.version = COMPILER_NOT_FOUND;
+	rtd.compiler = NULL;
+	rtd.compression = ResourceCompression::NONE;
+	return hash_map::get(_compilers, type_str, rtd).compression;
+}
+
 u32 DataCompiler::data_version(const char* type)
 {
 	TempAllocator64 ta;
@@ -1151,6 +1900,7 @@ u32 DataCompiler::data_version(const char* type)
 	ResourceTypeData rtd;
 	rtd.version = COMPILER_NOT_FOUND;
 	rtd.compiler = NULL;
+	rtd.compression = ResourceCompression::NONE;
 	return hash_map::get(_compilers, type_str, rtd).version;
 }
 
@@ -1287,6 +2037,32 @@ void DataCompiler::file_monitor_callback(void* thiz, FileMonitorEvent::Enum fme,
 	((DataCompiler*)thiz)->file_monitor_callback(fme, is_dir, path_original, path_modified);
 }
 
+/// Enables compression of the data compiled for each resource type in the
+/// comma-separated list @a types. Returns false if any type is unknown.
+static bool compress_types(DataCompiler& dc, const char* types)
+{
+	TempAllocator64 ta;
+	DynamicString type(ta);
+
+	for (const char* cur = types; *cur != '\0';)
+	{
+		const char* comma = strchr(cur, ',');
+		const u32 len = comma != NULL ? u32(comma - cur) : strlen32(cur);
+		type.set(cur, len);
+
+		if (!dc.can_compile(type.c_str()))
+		{
+			loge(DATA_COMPILER, "Unknown resource type: '%s'", type.c_str());
+			return false;
+		}
+
+		dc.set_compression(type.c_str(), ResourceCompression::LZ4);
+		cur += comma != NULL ? len + 1 : len;
+	}
+
+	return true;
+}
+
 int main_data_compiler(const DeviceOptions& opts)
 {
 #if CROWN_PLATFORM_POSIX
@@ -1314,6 +2090,7 @@ int main_data_compiler(const DeviceOptions& opts)
 
 	console_server_globals::init();
 	console_server()->listen(CROWN_DEFAULT_COMPILER_PORT, opts._wait_console);
+	job_system_globals::init(opts._num_jobs);
 
 	namespace cor = config_resource_internal;
 	namespace ftr = font_resource_internal;
@@ -1349,6 +2126,8 @@ int main_data_compiler(const DeviceOptions& opts)
 	dc->register_compiler("texture",          RESOURCE_VERSION_TEXTURE,          txr::compile);
 	dc->register_compiler("unit",             RESOURCE_VERSION_UNIT,             utr::compile);
 
+	bool success = opts._compress == NULL || compress_types(*dc, opts._compress);
+
 	dc->add_ignore_glob("*.bak");
 	dc->add_ignore_glob("*.dds");
 	dc->add_ignore_glob("*.goutputstream-*"); // https://askubuntu.com/questions/151101/why-are-goutputstream-xxxxx-files-created-in-home-folder
@@ -1377,24 +2156,26 @@ int main_data_compiler(const DeviceOptions& opts)
 
 	dc->scan_and_restore(opts._data_dir.c_str());
 
-	bool success = true;
-
-	if (opts._server)
+	if (success)
 	{
-		while (!_quit)
+		if (opts._server)
 		{
-			console_server()->update();
-			os::sleep(60);
+			while (!_quit)
+			{
+				console_server()->update();
+				os::sleep(60);
+			}
+		}
+		else
+		{
+			success = dc->compile(opts._data_dir.c_str(), opts._platform);
 		}
-	}
-	else
-	{
-		success = dc->compile(opts._data_dir.c_str(), opts._platform);
 	}
 
 	dc->save(opts._data_dir.c_str());
 
 	CE_DELETE(default_allocator(), dc);
+	job_system_globals::shutdown();
 	console_server_globals::shutdown();
 
 #if CROWN_PLATFORM_POSIX
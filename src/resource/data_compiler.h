@@ -11,6 +11,7 @@
 #include "core/guid.h"
 #include "device/console_server.h"
 #include "device/device_options.h"
+#include "resource/resource_compression.h"
 #include "resource/resource_id.h"
 #include "resource/types.h"
 
@@ -47,6 +48,17 @@ struct DataCompiler
 	{
 		u32 version;
 		CompileFunction compiler;
+		ResourceCompression::Enum compression;
+	};
+
+	/// Content hash of a source file.
+	/// Holds the file's size and mtime from when the hash was computed, so
+	/// that the file is read again only when any of them changes.
+	struct SourceHash
+	{
+		u64 mtime;
+		u64 size;
+		u64 hash;
 	};
 
 	const DeviceOptions* _options;
@@ -56,7 +68,9 @@ struct DataCompiler
 	HashMap<DynamicString, ResourceTypeData> _compilers;
 	Vector<DynamicString> _globs;
 	HashMap<StringId64, DynamicString> _data_index;
-	HashMap<StringId64, u64> _data_mtimes;
+	HashMap<StringId64, u64> _data_hashes;
+	HashMap<DynamicString, SourceHash> _source_hashes;
+	HashMap<DynamicString, u64> _dependency_hashes;
 	HashMap<StringId64, HashMap<DynamicString, u32> > _data_dependencies;
 	HashMap<StringId64, HashMap<DynamicString, u32> > _data_requirements;
 	HashMap<DynamicString, u32> _data_versions;
@@ -104,6 +118,12 @@ struct DataCompiler
 	/// Registers the resource @a compiler for the given resource @a type and @a version.
 	void register_compiler(const char* type, u32 version, CompileFunction compiler);
 
+	/// Sets the @a compression of the data compiled for the resource @a type.
+	void set_compression(const char* type, ResourceCompression::Enum compression);
+
+	/// Returns the compression of the data compiled for the resource @a type.
+	ResourceCompression::Enum data_compression(const char* type);
+
 	/// Returns whether there is a compiler for the resource @a type.
 	bool can_compile(const char* type);
 
@@ -114,13 +134,23 @@ struct DataCompiler
 	///
 	u32 data_version_stored(const char* type);
 
-	/// Returns whether any dependency of @a path, including itself, has changed
-	/// since last call to compile().
-	bool dependency_changed(const DynamicString& path, ResourceId id, u64 mtime);
+	/// Returns the hash of the contents of the source file @a path or 0 if
+	/// the file does not exist.
+	u64 source_hash(const DynamicString& path);
+
+	/// Returns the hash of the name, contents and compiler version of the
+	/// dependency @a path. It is computed once per call to compile().
+	u64 dependency_hash(const DynamicString& path);
+
+	/// Adds the @a dependencies to @a closure, followed by the dependencies
+	/// of each of them, recursively.
+	void dependency_closure(HashMap<DynamicString, u32>& closure, const HashMap<DynamicString, u32>& dependencies);
 
-	/// Returns whether the data version for @a path or any of its dependencies
-	/// has changed since last call to compile().
-	bool version_changed(const DynamicString& path, ResourceId id);
+	/// Returns the hash identifying the data compiled from @a path for the
+	/// given @a platform. It covers the contents of @a path and of its
+	/// @a dependencies, direct or not, together with the versions of their
+	/// compilers.
+	u64 data_hash(const DynamicString& path, const HashMap<DynamicString, u32>& dependencies, const char* platform);
 
 	/// Returns whether the @a path should be ignored because
 	/// it matches a pattern from the CROWN_DATAIGNORE file or
@@ -12,10 +12,12 @@
 #include "core/json/sjson.h"
 #include "core/math/aabb.inl"
 #include "core/math/constants.h"
+#include "core/math/math.h"
 #include "core/math/matrix4x4.inl"
 #include "core/math/vector2.inl"
 #include "core/math/vector3.inl"
 #include "core/memory/temp_allocator.inl"
+#include "core/murmur.h"
 #include "core/strings/dynamic_string.inl"
 #include "core/strings/string_id.inl"
 #include "device/log.h"
@@ -24,6 +26,7 @@
 #include "resource/resource_manager.h"
 #include <bx/readerwriter.h>
 #include <bx/error.h>
+#include <bx/uint32_t.h> // bx::halfFromFloat
 #include <vertexlayout.h> // bgfx::write, bgfx::read
 
 namespace crown
@@ -124,6 +127,15 @@ namespace mesh_resource_internal
 			OBB obb;
 			br.read(obb);
 
+			u32 compression;
+			br.read(compression);
+
+			Vector3 position_scale;
+			br.read(position_scale);
+
+			Vector3 position_offset;
+			br.read(position_offset);
+
 			u32 num_verts;
 			br.read(num_verts);
 
@@ -133,8 +145,11 @@ namespace mesh_resource_internal
 			u32 num_inds;
 			br.read(num_inds);
 
+			u32 index_stride;
+			br.read(index_stride);
+
 			const u32 vsize = num_verts*stride;
-			const u32 isize = num_inds*sizeof(u16);
+			const u32 isize = num_inds*index_stride;
 
 			const u32 size = sizeof(MeshGeometry) + vsize + isize;
 
@@ -145,8 +160,12 @@ namespace mesh_resource_internal
 			mg->index_buffer    = BGFX_INVALID_HANDLE;
 			mg->vertices.num    = num_verts;
 			mg->vertices.stride = stride;
+			mg->vertices.compression     = compression;
+			mg->vertices.position_scale  = position_scale;
+			mg->vertices.position_offset = position_offset;
 			mg->vertices.data   = (char*)&mg[1];
 			mg->indices.num     = num_inds;
+			mg->indices.stride  = index_stride;
 			mg->indices.data    = mg->vertices.data + vsize;
 
 			br.read(mg->vertices.data, vsize);
@@ -162,25 +181,31 @@ namespace mesh_resource_internal
 	void online(StringId64 id, ResourceManager& rm)
 	{
 		MeshResource* mr = (MeshResource*)rm.get(RESOURCE_TYPE_MESH, id);
+		u32 gpu_size = 0;
 
 		for (u32 i = 0; i < array::size(mr->geometries); ++i)
 		{
 			MeshGeometry& mg = *mr->geometries[i];
 
 			const u32 vsize = mg.vertices.num * mg.vertices.stride;
-			const u32 isize = mg.indices.num * sizeof(u16);
+			const u32 isize = mg.indices.num * mg.indices.stride;
+			gpu_size += vsize + isize;
 
 			const bgfx::Memory* vmem = bgfx::makeRef(mg.vertices.data, vsize);
 			const bgfx::Memory* imem = bgfx::makeRef(mg.indices.data, isize);
 
 			bgfx::VertexBufferHandle vbh = bgfx::createVertexBuffer(vmem, mg.layout);
-			bgfx::IndexBufferHandle ibh  = bgfx::createIndexBuffer(imem);
+			bgfx::IndexBufferHandle ibh  = bgfx::createIndexBuffer(imem
+				, mg.indices.stride == sizeof(u32) ? BGFX_BUFFER_INDEX32 : BGFX_BUFFER_NONE
+				);
 			CE_ASSERT(bgfx::isValid(vbh), "Invalid vertex buffer");
 			CE_ASSERT(bgfx::isValid(ibh), "Invalid index buffer");
 
 			mg.vertex_buffer = vbh;
 			mg.index_buffer  = ibh;
 		}
+
+		rm.set_gpu_size(RESOURCE_TYPE_MESH, id, gpu_size);
 	}
 
 	void offline(StringId64 id, ResourceManager& rm)
@@ -208,7 +233,28 @@ namespace mesh_resource_internal
 
 } // namespace mesh_resource_internal
 
+namespace mesh_resource
+{
+	void decode_positions(Array<Vector3>& positions, const MeshGeometry& mg)
+	{
+		array::resize(positions, mg.vertices.num);
+
+		for (u32 i = 0; i < mg.vertices.num; ++i)
+		{
+			f32 v[4];
+			bgfx::vertexUnpack(v, bgfx::Attrib::Position, mg.layout, mg.vertices.data, i);
+
+			positions[i].x = v[0] * mg.vertices.position_scale.x + mg.vertices.position_offset.x;
+			positions[i].y = v[1] * mg.vertices.position_scale.y + mg.vertices.position_offset.y;
+			positions[i].z = v[2] * mg.vertices.position_scale.z + mg.vertices.position_offset.z;
+		}
+	}
+
+} // namespace mesh_resource
+
 #if CROWN_CAN_COMPILE
+LOG_SYSTEM(MESH_COMPILER, "mesh_compiler")
+
 namespace mesh_resource_internal
 {
 	static void parse_float_array(Array<f32>& output, const char* json)
@@ -222,7 +268,7 @@ namespace mesh_resource_internal
 			output[i] = sjson::parse_float(floats[i]);
 	}
 
-	static void parse_index_array(Array<u16>& output, const char* json)
+	static void parse_index_array(Array<u32>& output, const char* json)
 	{
 		TempAllocator4096 ta;
 		JsonArray indices(ta);
@@ -230,7 +276,265 @@ namespace mesh_resource_internal
 
 		array::resize(output, array::size(indices));
 		for (u32 i = 0; i < array::size(indices); ++i)
-			output[i] = (u16)sjson::parse_int(indices[i]);
+			output[i] = (u32)sjson::parse_int(indices[i]);
+	}
+
+	static s16 float_to_snorm16(f32 a)
+	{
+		a = clamp(a, -1.0f, 1.0f) * 32767.0f;
+		return s16(a >= 0.0f ? a + 0.5f : a - 0.5f);
+	}
+
+	static f32 snorm16_to_float(s16 a)
+	{
+		return max(f32(a) / 32767.0f, -1.0f);
+	}
+
+	/// Returns the octahedral encoding of the unit vector @a n, in [-1; 1].
+	/// See: Cigolle et al., "A Survey of Efficient Representations for
+	/// Independent Unit Vectors".
+	static Vector2 octahedral_encode(const Vector3& n)
+	{
+		const f32 l1 = fabs(n.x) + fabs(n.y) + fabs(n.z);
+		if (l1 == 0.0f)
+			return VECTOR2_ZERO;
+
+		Vector2 e;
+		e.x = n.x / l1;
+		e.y = n.y / l1;
+
+		if (n.z < 0.0f)
+		{
+			const f32 x = e.x;
+			e.x = (1.0f - fabs(e.y)) * (x   >= 0.0f ? 1.0f : -1.0f);
+			e.y = (1.0f - fabs(x))   * (e.y >= 0.0f ? 1.0f : -1.0f);
+		}
+
+		return e;
+	}
+
+	/// Returns the unit vector encoded in @a e. Must match the decoding in
+	/// the mesh shaders.
+	static Vector3 octahedral_decode(const Vector2& e)
+	{
+		Vector3 n;
+		n.x = e.x;
+		n.y = e.y;
+		n.z = 1.0f - fabs(e.x) - fabs(e.y);
+
+		const f32 t = max(-n.z, 0.0f);
+		n.x += n.x >= 0.0f ? -t : t;
+		n.y += n.y >= 0.0f ? -t : t;
+		return normalize(n);
+	}
+
+	#define VERTEX_CACHE_SIZE 32
+
+	/// Returns the score of a vertex given its position in the post-transform
+	/// cache and the number of triangles still to be drawn that use it.
+	static f32 vertex_score(s32 cache_pos, u32 num_remaining)
+	{
+		if (num_remaining == 0)
+			return -1.0f;
+
+		f32 score = 0.0f;
+		if (cache_pos >= 0)
+		{
+			if (cache_pos < 3)
+			{
+				// The vertex was used by the last triangle: give it a fixed
+				// score to avoid favoring long, thin strips.
+				score = 0.75f;
+			}
+			else
+			{
+				const f32 s = 1.0f - f32(cache_pos - 3) / f32(VERTEX_CACHE_SIZE - 3);
+				score = s * fsqrt(s);
+			}
+		}
+
+		// Favor vertices with few triangles left so that they are done with
+		// as soon as possible.
+		return score + 2.0f / fsqrt(f32(num_remaining));
+	}
+
+	/// Reorders the triangles in @a indices to improve the hit rate of the
+	/// post-transform vertex cache.
+	/// See: Tom Forsyth, "Linear-Speed Vertex Cache Optimisation".
+	static void optimize_vertex_cache(Array<u32>& indices, u32 num_vertices)
+	{
+		const u32 num_indices = array::size(indices);
+		const u32 num_triangles = num_indices / 3;
+		if (num_triangles == 0)
+			return;
+
+		// Triangles using each vertex.
+		Array<u32> num_remaining(default_allocator());
+		array::resize(num_remaining, num_vertices);
+		memset(array::begin(num_remaining), 0, num_vertices*sizeof(u32));
+		for (u32 i = 0; i < num_indices; ++i)
+			++num_remaining[indices[i]];
+
+		Array<u32> offsets(default_allocator());
+		array::resize(offsets, num_vertices);
+		for (u32 i = 0, offset = 0; i < num_vertices; ++i)
+		{
+			offsets[i] = offset;
+			offset += num_remaining[i];
+		}
+
+		Array<u32> triangles(default_allocator());
+		array::resize(triangles, num_indices);
+		for (u32 i = 0; i < num_indices; ++i)
+			triangles[offsets[indices[i]]++] = i / 3;
+		for (u32 i = 0; i < num_vertices; ++i)
+			offsets[i] -= num_remaining[i];
+
+		Array<s32> cache_pos(default_allocator());
+		array::resize(cache_pos, num_vertices);
+		Array<f32> score(default_allocator());
+		array::resize(score, num_vertices);
+		for (u32 i = 0; i < num_vertices; ++i)
+		{
+			cache_pos[i] = -1;
+			score[i] = vertex_score(-1, num_remaining[i]);
+		}
+
+		Array<f32> triangle_score(default_allocator());
+		array::resize(triangle_score, num_triangles);
+		Array<u8> emitted(default_allocator());
+		array::resize(emitted, num_triangles);
+		u32 best = 0;
+		for (u32 i = 0; i < num_triangles; ++i)
+		{
+			triangle_score[i] = score[indices[i*3 + 0]] + score[indices[i*3 + 1]] + score[indices[i*3 + 2]];
+			emitted[i] = 0;
+			if (triangle_score[i] > triangle_score[best])
+				best = i;
+		}
+
+		Array<u32> output(default_allocator());
+		array::resize(output, num_indices);
+
+		u32 cache[VERTEX_CACHE_SIZE + 3];
+		u32 cache_size = 0;
+		u32 next_unemitted = 0;
+
+		for (u32 nt = 0; nt < num_triangles; ++nt)
+		{
+			if (best == UINT32_MAX)
+			{
+				// Dead end: restart from the first triangle not emitted yet.
+				while (emitted[next_unemitted])
+					++next_unemitted;
+				best = next_unemitted;
+			}
+
+			emitted[best] = 1;
+			const u32* tri = &indices[best*3];
+			output[nt*3 + 0] = tri[0];
+			output[nt*3 + 1] = tri[1];
+			output[nt*3 + 2] = tri[2];
+
+			// Remove the triangle from its vertices.
+			for (u32 i = 0; i < 3; ++i)
+			{
+				const u32 v = tri[i];
+				u32* adj = &triangles[offsets[v]];
+				u32 last = --num_remaining[v];
+				for (u32 j = 0; j < last; ++j)
+				{
+					if (adj[j] == best)
+					{
+						adj[j] = adj[last];
+						break;
+					}
+				}
+			}
+
+			// Move the vertices of the triangle to the front of the cache.
+			u32 new_cache[VERTEX_CACHE_SIZE + 3];
+			u32 new_cache_size = 0;
+			for (u32 i = 0; i < 3; ++i)
+			{
+				if (i == 0 || (tri[i] != tri[0] && (i == 1 || tri[i] != tri[1])))
+					new_cache[new_cache_size++] = tri[i];
+			}
+			for (u32 i = 0; i < cache_size; ++i)
+			{
+				const u32 v = cache[i];
+				if (v != tri[0] && v != tri[1] && v != tri[2])
+					new_cache[new_cache_size++] = v;
+			}
+
+			// Update the scores of the vertices whose position changed.
+			for (u32 i = 0; i < new_cache_size; ++i)
+			{
+				const u32 v = new_cache[i];
+				cache_pos[v] = i < VERTEX_CACHE_SIZE ? s32(i) : -1;
+
+				const f32 new_score = vertex_score(cache_pos[v], num_remaining[v]);
+				const f32 delta = new_score - score[v];
+				score[v] = new_score;
+
+				for (u32 j = 0; j < num_remaining[v]; ++j)
+					triangle_score[triangles[offsets[v] + j]] += delta;
+			}
+
+			cache_size = new_cache_size < VERTEX_CACHE_SIZE ? new_cache_size : VERTEX_CACHE_SIZE;
+			memcpy(cache, new_cache, cache_size*sizeof(u32));
+
+			// Pick the best triangle among those using cached vertices.
+			best = UINT32_MAX;
+			f32 best_score = -1.0f;
+			for (u32 i = 0; i < cache_size; ++i)
+			{
+				const u32 v = cache[i];
+				for (u32 j = 0; j < num_remaining[v]; ++j)
+				{
+					const u32 t = triangles[offsets[v] + j];
+					if (triangle_score[t] > best_score)
+					{
+						best = t;
+						best_score = triangle_score[t];
+					}
+				}
+			}
+		}
+
+		indices = output;
+	}
+
+	/// Reorders the vertices in @a vertices in the order they are first used by
+	/// @a indices to improve the locality of vertex fetches, and updates
+	/// @a indices accordingly.
+	static void optimize_vertex_fetch(Array<char>& vertices, Array<u32>& indices, u32 stride)
+	{
+		const u32 num_vertices = array::size(vertices) / stride;
+
+		Array<u32> remap(default_allocator());
+		array::resize(remap, num_vertices);
+		for (u32 i = 0; i < num_vertices; ++i)
+			remap[i] = UINT32_MAX;
+
+		Array<char> output(default_allocator());
+		array::resize(output, array::size(vertices));
+
+		u32 next = 0;
+		for (u32 i = 0; i < array::size(indices); ++i)
+		{
+			const u32 v = indices[i];
+			if (remap[v] == UINT32_MAX)
+			{
+				memcpy(&output[next*stride], &vertices[v*stride], stride);
+				remap[v] = next++;
+			}
+
+			indices[i] = remap[v];
+		}
+
+		array::resize(output, next*stride);
+		vertices = output;
 	}
 
 	struct MeshCompiler
@@ -243,15 +547,16 @@ namespace mesh_resource_internal
 		Array<f32> _tangents;
 		Array<f32> _binormals;
 
-		Array<u16> _position_indices;
-		Array<u16> _normal_indices;
-		Array<u16> _uv_indices;
-		Array<u16> _tangent_indices;
-		Array<u16> _binormal_indices;
+		Array<u32> _position_indices;
+		Array<u32> _normal_indices;
+		Array<u32> _uv_indices;
+		Array<u32> _tangent_indices;
+		Array<u32> _binormal_indices;
 
 		u32 _vertex_stride;
 		Array<char> _vertex_buffer;
-		Array<u16> _index_buffer;
+		Array<u32> _index_buffer;
+		Array<u32> _vertex_table;
 
 		AABB _aabb;
 		OBB _obb;
@@ -261,6 +566,11 @@ namespace mesh_resource_internal
 		bool _has_normal;
 		bool _has_uv;
 
+		bool _compress_vertices;
+		u32 _compression;
+		Vector3 _position_scale;
+		Vector3 _position_offset;
+
 		explicit MeshCompiler(CompileOptions& opts)
 			: _opts(opts)
 			, _positions(default_allocator())
@@ -276,8 +586,13 @@ namespace mesh_resource_internal
 			, _vertex_stride(0)
 			, _vertex_buffer(default_allocator())
 			, _index_buffer(default_allocator())
+			, _vertex_table(default_allocator())
 			, _has_normal(false)
 			, _has_uv(false)
+			, _compress_vertices(false)
+			, _compression(VertexCompression::NONE)
+			, _position_scale(VECTOR3_ONE)
+			, _position_offset(VECTOR3_ZERO)
 		{
 		}
 
@@ -298,6 +613,7 @@ namespace mesh_resource_internal
 			_vertex_stride = 0;
 			array::clear(_vertex_buffer);
 			array::clear(_index_buffer);
+			array::clear(_vertex_table);
 
 			aabb::reset(_aabb);
 			memset(&_obb, 0, sizeof(_obb));
@@ -305,6 +621,10 @@ namespace mesh_resource_internal
 
 			_has_normal = false;
 			_has_uv = false;
+
+			_compression = VertexCompression::NONE;
+			_position_scale = VECTOR3_ONE;
+			_position_offset = VECTOR3_ZERO;
 		}
 
 		void parse_indices(const char* json)
@@ -355,40 +675,70 @@ namespace mesh_resource_internal
 			_vertex_stride += (_has_normal ? 3 * sizeof(f32) : 0);
 			_vertex_stride += (_has_uv     ? 2 * sizeof(f32) : 0);
 
-			// Generate vb/ib
-			array::resize(_index_buffer, array::size(_position_indices));
+			// Generate vb/ib, welding identical vertices
+			const u32 num_indices = array::size(_position_indices);
+			array::resize(_index_buffer, num_indices);
 
-			u16 index = 0;
-			for (u32 i = 0; i < array::size(_position_indices); ++i)
+			u32 table_size = 1;
+			while (table_size < num_indices*2)
+				table_size *= 2;
+			array::resize(_vertex_table, table_size);
+			for (u32 i = 0; i < table_size; ++i)
+				_vertex_table[i] = UINT32_MAX;
+
+			for (u32 i = 0; i < num_indices; ++i)
 			{
-				_index_buffer[i] = index++;
+				char vertex[3*sizeof(f32) + 3*sizeof(f32) + 2*sizeof(f32)];
+				u32 size = 0;
 
-				const u16 p_idx = _position_indices[i] * 3;
+				const u32 p_idx = _position_indices[i] * 3;
 				Vector3 xyz;
 				xyz.x = _positions[p_idx + 0];
 				xyz.y = _positions[p_idx + 1];
 				xyz.z = _positions[p_idx + 2];
-				array::push(_vertex_buffer, (char*)&xyz, sizeof(xyz));
+				memcpy(vertex + size, &xyz, sizeof(xyz));
+				size += sizeof(xyz);
 
 				if (_has_normal)
 				{
-					const u16 n_idx = _normal_indices[i] * 3;
+					const u32 n_idx = _normal_indices[i] * 3;
 					Vector3 n;
 					n.x = _normals[n_idx + 0];
 					n.y = _normals[n_idx + 1];
 					n.z = _normals[n_idx + 2];
-					array::push(_vertex_buffer, (char*)&n, sizeof(n));
+					memcpy(vertex + size, &n, sizeof(n));
+					size += sizeof(n);
 				}
 				if (_has_uv)
 				{
-					const u16 t_idx = _uv_indices[i] * 2;
+					const u32 t_idx = _uv_indices[i] * 2;
 					Vector2 uv;
 					uv.x = _uvs[t_idx + 0];
 					uv.y = _uvs[t_idx + 1];
-					array::push(_vertex_buffer, (char*)&uv, sizeof(uv));
+					memcpy(vertex + size, &uv, sizeof(uv));
+					size += sizeof(uv);
+				}
+
+				// Find the vertex or add it to the vertex buffer.
+				u32 slot = murmur32(vertex, size, 0) & (table_size - 1);
+				for (; _vertex_table[slot] != UINT32_MAX; slot = (slot + 1) & (table_size - 1))
+				{
+					if (memcmp(&_vertex_buffer[_vertex_table[slot]*size], vertex, size) == 0)
+						break;
+				}
+
+				if (_vertex_table[slot] == UINT32_MAX)
+				{
+					_vertex_table[slot] = array::size(_vertex_buffer) / size;
+					array::push(_vertex_buffer, vertex, size);
 				}
+
+				_index_buffer[i] = _vertex_table[slot];
 			}
 
+			optimize_vertex_cache(_index_buffer, array::size(_vertex_buffer) / _vertex_stride);
+			optimize_vertex_fetch(_vertex_buffer, _index_buffer, _vertex_stride);
+
 			// Vertex layout
 			_layout.begin();
 			_layout.add(bgfx::Attrib::Position, 3, bgfx::AttribType::Float);
@@ -415,18 +765,163 @@ namespace mesh_resource_internal
 			_obb.half_extents = (_aabb.max - _aabb.min) * 0.5f;
 		}
 
+		/// Converts the vertices to VertexCompression::QUANTIZED and logs the
+		/// maximum error introduced. Positions are stored as 16-bit normalized
+		/// integers relative to the bounds of the geometry, normals are
+		/// octahedral-encoded into two 16-bit normalized integers and texture
+		/// coordinates are stored as 16-bit normalized integers, or as half
+		/// floats if any of them is outside [0; 1].
+		void quantize(const StringView& name)
+		{
+			const u32 num_vertices = array::size(_vertex_buffer) / _vertex_stride;
+			const u32 uv_offset = 3 + (_has_normal ? 3 : 0);
+
+			bool uv_unorm = true;
+			for (u32 i = 0; _has_uv && i < num_vertices; ++i)
+			{
+				const f32* uv = (const f32*)&_vertex_buffer[i*_vertex_stride] + uv_offset;
+				uv_unorm = uv_unorm && uv[0] >= 0.0f && uv[0] <= 1.0f && uv[1] >= 0.0f && uv[1] <= 1.0f;
+			}
+
+			_position_offset = aabb::center(_aabb);
+			_position_scale = _obb.half_extents;
+			f32* scale = to_float_ptr(_position_scale);
+			const f32* offset = to_float_ptr(_position_offset);
+			for (u32 i = 0; i < 3; ++i)
+			{
+				if (scale[i] == 0.0f)
+					scale[i] = 1.0f;
+			}
+
+			const u32 stride = 4*sizeof(s16)
+				+ (_has_normal ? 2*sizeof(s16) : 0)
+				+ (_has_uv     ? 2*sizeof(s16) : 0)
+				;
+
+			Array<char> output(default_allocator());
+			array::resize(output, num_vertices*stride);
+
+			f32 position_error = 0.0f;
+			f32 normal_error = 0.0f;
+			f32 uv_error = 0.0f;
+
+			for (u32 i = 0; i < num_vertices; ++i)
+			{
+				const f32* src = (const f32*)&_vertex_buffer[i*_vertex_stride];
+				s16* dst = (s16*)&output[i*stride];
+
+				for (u32 j = 0; j < 3; ++j)
+				{
+					dst[j] = float_to_snorm16((src[j] - offset[j]) / scale[j]);
+					position_error = max(position_error, fabs(snorm16_to_float(dst[j])*scale[j] + offset[j] - src[j]));
+				}
+				dst[3] = 0;
+				src += 3;
+				dst += 4;
+
+				if (_has_normal)
+				{
+					Vector3 n;
+					n.x = src[0];
+					n.y = src[1];
+					n.z = src[2];
+					normalize(n);
+
+					const Vector2 e = octahedral_encode(n);
+					dst[0] = float_to_snorm16(e.x);
+					dst[1] = float_to_snorm16(e.y);
+
+					Vector2 d;
+					d.x = snorm16_to_float(dst[0]);
+					d.y = snorm16_to_float(dst[1]);
+					normal_error = max(normal_error, facos(clamp(dot(n, octahedral_decode(d)), -1.0f, 1.0f)));
+					src += 3;
+					dst += 2;
+				}
+				if (_has_uv)
+				{
+					for (u32 j = 0; j < 2; ++j)
+					{
+						f32 decoded;
+						if (uv_unorm)
+						{
+							dst[j] = float_to_snorm16(src[j]);
+							decoded = snorm16_to_float(dst[j]);
+						}
+						else
+						{
+							const u16 half = bx::halfFromFloat(src[j]);
+							memcpy(&dst[j], &half, sizeof(half));
+							decoded = bx::halfToFloat(half);
+						}
+						uv_error = max(uv_error, fabs(decoded - src[j]));
+					}
+				}
+			}
+
+			logi(MESH_COMPILER, "Quantized %s %.*s: %u vertices, %u bytes -> %u bytes, max error: position %g, normal %.3f deg, uv %g"
+				, _opts._source_path.c_str()
+				, name.length()
+				, name.data()
+				, num_vertices
+				, array::size(_vertex_buffer)
+				, array::size(output)
+				, position_error
+				, fdeg(normal_error)
+				, uv_error
+				);
+
+			_vertex_buffer = output;
+			_vertex_stride = stride;
+			_compression = VertexCompression::QUANTIZED;
+
+			_layout.begin();
+			_layout.add(bgfx::Attrib::Position, 4, bgfx::AttribType::Int16, true);
+
+			if (_has_normal)
+			{
+				_layout.add(bgfx::Attrib::Normal, 2, bgfx::AttribType::Int16, true);
+			}
+			if (_has_uv)
+			{
+				_layout.add(bgfx::Attrib::TexCoord0
+					, 2
+					, uv_unorm ? bgfx::AttribType::Int16 : bgfx::AttribType::Half
+					, uv_unorm
+					);
+			}
+
+			_layout.end();
+		}
+
 		void write()
 		{
 			BgfxWriter writer(_opts._binary_writer);
 			bgfx::write(&writer, _layout);
 			_opts.write(_obb);
+			_opts.write(_compression);
+			_opts.write(_position_scale);
+			_opts.write(_position_offset);
+
+			const u32 num_vertices = array::size(_vertex_buffer) / _vertex_stride;
+			const u32 num_indices = array::size(_index_buffer);
+			const u32 index_stride = num_vertices > UINT16_MAX ? sizeof(u32) : sizeof(u16);
 
-			_opts.write(array::size(_vertex_buffer) / _vertex_stride);
+			_opts.write(num_vertices);
 			_opts.write(_vertex_stride);
-			_opts.write(array::size(_index_buffer));
+			_opts.write(num_indices);
+			_opts.write(index_stride);
 
 			_opts.write(_vertex_buffer);
-			_opts.write(array::begin(_index_buffer), array::size(_index_buffer) * sizeof(u16));
+			if (index_stride == sizeof(u32))
+			{
+				_opts.write(array::begin(_index_buffer), num_indices * sizeof(u32));
+			}
+			else
+			{
+				for (u32 i = 0; i < num_indices; ++i)
+					_opts.write((u16)_index_buffer[i]);
+			}
 		}
 	};
 
@@ -445,6 +940,8 @@ namespace mesh_resource_internal
 
 		mc.reset();
 		mc.parse(geometry);
+		if (mc._compress_vertices)
+			mc.quantize(key);
 		mc.write();
 
 		if (json_object::has(obj_node, "children"))
@@ -483,6 +980,8 @@ namespace mesh_resource_internal
 		opts.write(json_object::size(geometries));
 
 		MeshCompiler mc(opts);
+		if (json_object::has(obj, "compress_vertices"))
+			mc._compress_vertices = sjson::parse_bool(obj["compress_vertices"]);
 
 		auto cur = json_object::begin(nodes);
 		auto end = json_object::end(nodes);
@@ -16,17 +16,33 @@
 
 namespace crown
 {
+/// Enumerates the vertex compression methods of mesh geometries.
+struct VertexCompression
+{
+	enum Enum
+	{
+		NONE,      ///< 32-bit float attributes.
+		QUANTIZED, ///< 16-bit positions, octahedral normals and texture coordinates.
+
+		COUNT
+	};
+};
+
 struct VertexData
 {
 	u32 num;
 	u32 stride;
+	u32 compression;         ///< VertexCompression::Enum.
+	Vector3 position_scale;  ///< Object-space position = stored position * position_scale + position_offset.
+	Vector3 position_offset;
 	char* data;
 };
 
 struct IndexData
 {
 	u32 num;
-	char* data; // size = num*sizeof(u16)
+	u32 stride; // sizeof(u16) or sizeof(u32)
+	char* data; // size = num*stride
 };
 
 struct MeshGeometry
@@ -61,4 +77,12 @@ namespace mesh_resource_internal
 
 } // namespace mesh_resource_internal
 
+namespace mesh_resource
+{
+	/// Fills @a positions with the object-space position of each vertex of
+	/// the geometry @a mg.
+	void decode_positions(Array<Vector3>& positions, const MeshGeometry& mg);
+
+} // namespace mesh_resource
+
 } // namespace crown
@@ -107,6 +107,9 @@ namespace package_resource_internal
 			const StringId64 req_name_hash(req_filename, req_name_len);
 			hash_set::insert(output, PackageResource::Resource(req_type_hash, req_name_hash));
 
+			// Recompile the package when the requirements change.
+			opts.fake_read(req_filename);
+
 			bring_in_requirements(output, opts, resource_id(req_type_hash, req_name_hash));
 		}
 
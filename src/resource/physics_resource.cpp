@@ -13,8 +13,11 @@
 #include "core/json/sjson.h"
 #include "core/math/aabb.inl"
 #include "core/math/constants.h"
+#include "core/math/matrix4x4.inl"
+#include "core/math/plane3.inl"
 #include "core/math/quaternion.inl"
 #include "core/math/sphere.inl"
+#include "core/memory/memory.inl"
 #include "core/memory/temp_allocator.inl"
 #include "core/strings/dynamic_string.inl"
 #include "core/strings/string.inl"
@@ -22,6 +25,11 @@
 #include "resource/compile_options.inl"
 #include "resource/physics_resource.h"
 #include "world/types.h"
+#include <BulletCollision/CollisionShapes/btOptimizedBvh.h>
+#include <BulletCollision/CollisionShapes/btTriangleIndexVertexArray.h>
+#include <LinearMath/btConvexHullComputer.h>
+#include <float.h> // FLT_MAX
+#include <math.h>  // roundf
 
 namespace crown
 {
@@ -68,6 +76,42 @@ namespace physics_config_resource
 
 } // namespace physics_config_resource
 
+namespace physics_resource
+{
+	ColliderMesh collider_mesh(const ColliderDesc* cd)
+	{
+		CE_ASSERT(cd->type == ColliderType::MESH, "Collider is not a mesh");
+
+		const char* data = (const char*)&cd[1];
+
+		ColliderMesh cm;
+		cm.num_points = *(u32*)data;
+		data += sizeof(u32);
+		cm.points = (const Vector3*)data;
+		data += sizeof(Vector3)*cm.num_points;
+		cm.num_indices = *(u32*)data;
+		data += sizeof(u32);
+		cm.indices = (const u16*)data;
+		data += sizeof(u16)*cm.num_indices;
+		data = (const char*)memory::align_top(data, alignof(u32));
+		cm.bvh_layout = *(u32*)data;
+		data += sizeof(u32);
+		cm.bvh_size = *(u32*)data;
+		data += sizeof(u32);
+		cm.bvh = data;
+		return cm;
+	}
+
+	u32 bvh_layout()
+	{
+		return u32(sizeof(void*))
+			| u32(sizeof(btScalar)) << 8
+			| u32(CROWN_CPU_ENDIAN_LITTLE) << 16
+			;
+	}
+
+} // namespace physics_resource
+
 #if CROWN_CAN_COMPILE
 namespace physics_resource_internal
 {
@@ -159,6 +203,274 @@ namespace physics_resource_internal
 		sd.box.half_size = (aabb.max - aabb.min) * 0.5f;
 	}
 
+	static inline Vector3 to_vector3(const btVector3& v)
+	{
+		return vector3(v.x(), v.y(), v.z());
+	}
+
+	/// Computes the outward planes of the faces of the hull @a ch.
+	void hull_planes(Array<Plane3>& planes, const btConvexHullComputer& ch)
+	{
+		Vector3 centroid = VECTOR3_ZERO;
+		for (int i = 0; i < ch.vertices.size(); ++i)
+			centroid += to_vector3(ch.vertices[i]);
+		centroid *= 1.0f / f32(ch.vertices.size());
+
+		array::clear(planes);
+		for (int i = 0; i < ch.faces.size(); ++i)
+		{
+			const btConvexHullComputer::Edge* e = &ch.edges[ch.faces[i]];
+			const Vector3 a = to_vector3(ch.vertices[e->getSourceVertex()]);
+			const Vector3 b = to_vector3(ch.vertices[e->getTargetVertex()]);
+			const Vector3 c = to_vector3(ch.vertices[e->getNextEdgeOfFace()->getTargetVertex()]);
+
+			Plane3 p = plane3::from_point_and_normal(a, cross(b - a, c - a));
+			if (fequal(length(p.n), 0.0f))
+				continue;
+			plane3::normalize(p);
+
+			if (plane3::distance_to_point(p, centroid) > 0.0f)
+			{
+				p.n = -p.n;
+				p.d = -p.d;
+			}
+
+			array::push_back(planes, p);
+		}
+	}
+
+	/// Replaces @a points with the vertices of their convex hull. Vertices
+	/// closer than @a weld_distance are welded, then the hull is reduced to
+	/// at most @a max_vertices by keeping the vertices which stick out of it
+	/// the most.
+	void compile_convex_hull(Array<Vector3>& points, u32 max_vertices, f32 weld_distance)
+	{
+		btConvexHullComputer ch;
+		ch.compute((const f32*)array::begin(points), sizeof(Vector3), array::size(points), 0.0f, 0.0f);
+
+		Array<Vector3> candidates(default_allocator());
+		for (int i = 0; i < ch.vertices.size(); ++i)
+		{
+			const Vector3 v = to_vector3(ch.vertices[i]);
+
+			bool welded = false;
+			for (u32 j = 0; j < array::size(candidates) && !welded; ++j)
+				welded = length_squared(candidates[j] - v) <= weld_distance*weld_distance;
+
+			if (!welded)
+				array::push_back(candidates, v);
+		}
+
+		Array<Vector3> selected(default_allocator());
+		if (array::size(candidates) <= max_vertices)
+		{
+			selected = candidates;
+		}
+		else
+		{
+			Array<bool> used(default_allocator());
+			array::resize(used, array::size(candidates));
+			for (u32 i = 0; i < array::size(used); ++i)
+				used[i] = false;
+
+			// Start from the extremes along the axes.
+			for (u32 axis = 0; axis < 3; ++axis)
+			{
+				u32 lo = 0;
+				u32 hi = 0;
+				for (u32 i = 1; i < array::size(candidates); ++i)
+				{
+					if (to_float_ptr(candidates[i])[axis] < to_float_ptr(candidates[lo])[axis])
+						lo = i;
+					if (to_float_ptr(candidates[i])[axis] > to_float_ptr(candidates[hi])[axis])
+						hi = i;
+				}
+
+				used[lo] = true;
+				used[hi] = true;
+			}
+
+			for (u32 i = 0; i < array::size(candidates); ++i)
+			{
+				if (used[i])
+					array::push_back(selected, candidates[i]);
+			}
+
+			// Add the vertex farthest from the current hull until the budget
+			// is exhausted or all the vertices are inside the hull.
+			Array<Plane3> planes(default_allocator());
+			while (array::size(selected) < max_vertices)
+			{
+				btConvexHullComputer sch;
+				sch.compute((const f32*)array::begin(selected), sizeof(Vector3), array::size(selected), 0.0f, 0.0f);
+				hull_planes(planes, sch);
+
+				f32 farthest_dist = 0.0f;
+				u32 farthest = UINT32_MAX;
+				for (u32 i = 0; i < array::size(candidates); ++i)
+				{
+					if (used[i])
+						continue;
+
+					f32 dist = -FLT_MAX;
+					if (array::size(planes) < 4)
+					{
+						// Flat hull, use the distance from its vertices.
+						dist = FLT_MAX;
+						for (u32 j = 0; j < array::size(selected); ++j)
+							dist = min(dist, length(candidates[i] - selected[j]));
+					}
+					else
+					{
+						for (u32 j = 0; j < array::size(planes); ++j)
+							dist = max(dist, plane3::distance_to_point(planes[j], candidates[i]));
+					}
+
+					if (dist > farthest_dist)
+					{
+						farthest_dist = dist;
+						farthest = i;
+					}
+				}
+
+				if (farthest == UINT32_MAX)
+					break;
+
+				used[farthest] = true;
+				array::push_back(selected, candidates[farthest]);
+			}
+		}
+
+		// Drop the vertices which ended up inside the hull.
+		ch.compute((const f32*)array::begin(selected), sizeof(Vector3), array::size(selected), 0.0f, 0.0f);
+		array::clear(points);
+		for (int i = 0; i < ch.vertices.size(); ++i)
+			array::push_back(points, to_vector3(ch.vertices[i]));
+	}
+
+	/// Builds the quantized BVH of the triangles @a indices of @a points
+	/// and serializes it to @a bvh.
+	void compile_mesh_bvh(Array<char>& bvh, const Array<Vector3>& points, const Array<u16>& indices)
+	{
+		btIndexedMesh part;
+		part.m_vertexBase          = (const unsigned char*)array::begin(points);
+		part.m_vertexStride        = sizeof(Vector3);
+		part.m_numVertices         = array::size(points);
+		part.m_triangleIndexBase   = (const unsigned char*)array::begin(indices);
+		part.m_triangleIndexStride = sizeof(u16)*3;
+		part.m_numTriangles        = array::size(indices)/3;
+		part.m_indexType           = PHY_SHORT;
+
+		btTriangleIndexVertexArray vertex_array;
+		vertex_array.addIndexedMesh(part, PHY_SHORT);
+
+		// Quantize against the bounds of the mesh to get the most precision
+		// out of the 16-bit node coordinates.
+		AABB aabb;
+		aabb::from_points(aabb, array::size(points), array::begin(points));
+
+		btOptimizedBvh tree;
+		tree.build(&vertex_array
+			, true
+			, btVector3(aabb.min.x, aabb.min.y, aabb.min.z)
+			, btVector3(aabb.max.x, aabb.max.y, aabb.max.z)
+			);
+
+		const u32 size = tree.calculateSerializeBufferSize();
+		void* data = default_allocator().allocate(size, 16);
+		tree.serializeInPlace(data, size, false);
+		array::push(bvh, (const char*)data, size);
+		default_allocator().deallocate(data);
+	}
+
+	/// Reads the heights of a heightfield from @a collider_data and quantizes
+	/// them to 16 bits. Heights are stored relative to the middle of their
+	/// range, which is moved to the local pose of the collider, because
+	/// btHeightfieldTerrainShape is centered on its origin.
+	s32 compile_heightfield(ColliderDesc& cd, Array<s16>& heights, JsonObject& collider_data, CompileOptions& opts)
+	{
+		TempAllocator1024 ta;
+		const u32 width  = sjson::parse_int(collider_data["width"]);
+		const u32 length = sjson::parse_int(collider_data["length"]);
+		DATA_COMPILER_ASSERT(width >= 2 && length >= 2
+			, opts
+			, "Heightfield must have at least 2x2 samples"
+			);
+		const u32 num_samples = width*length;
+
+		Array<f32> samples(default_allocator());
+		array::resize(samples, num_samples);
+
+		if (json_object::has(collider_data, "heights"))
+		{
+			// Heights in meters.
+			JsonArray data(ta);
+			sjson::parse_array(data, collider_data["heights"]);
+			DATA_COMPILER_ASSERT(array::size(data) == num_samples
+				, opts
+				, "Heightfield must have %u heights, found %u"
+				, num_samples
+				, array::size(data)
+				);
+
+			for (u32 i = 0; i < num_samples; ++i)
+				samples[i] = sjson::parse_float(data[i]);
+		}
+		else
+		{
+			// Raw little-endian 16-bit heightmap, mapped to [height_min, height_max].
+			DynamicString heightmap(ta);
+			sjson::parse_string(heightmap, collider_data["heightmap"]);
+			DATA_COMPILER_ASSERT_FILE_EXISTS(heightmap.c_str(), opts);
+
+			Buffer data = opts.read(heightmap.c_str());
+			DATA_COMPILER_ASSERT(array::size(data) == num_samples*sizeof(u16)
+				, opts
+				, "Heightmap '%s' must have %ux%u 16-bit samples"
+				, heightmap.c_str()
+				, width
+				, length
+				);
+
+			const f32 height_min = sjson::parse_float(collider_data["height_min"]);
+			const f32 height_max = sjson::parse_float(collider_data["height_max"]);
+			const u8* raw = (const u8*)array::begin(data);
+			for (u32 i = 0; i < num_samples; ++i)
+			{
+				const u16 val = u16(raw[i*2 + 0] | raw[i*2 + 1] << 8);
+				samples[i] = height_min + (height_max - height_min)*(f32(val)/f32(UINT16_MAX));
+			}
+		}
+
+		f32 height_min =  FLT_MAX;
+		f32 height_max = -FLT_MAX;
+		for (u32 i = 0; i < num_samples; ++i)
+		{
+			height_min = min(height_min, samples[i]);
+			height_max = max(height_max, samples[i]);
+		}
+
+		const f32 middle = (height_min + height_max)*0.5f;
+		const f32 half   = (height_max - height_min)*0.5f;
+		const f32 scale  = half > 0.0f ? half/f32(INT16_MAX) : 1.0f;
+
+		array::resize(heights, num_samples);
+		for (u32 i = 0; i < num_samples; ++i)
+			heights[i] = s16(roundf((samples[i] - middle)/scale));
+
+		cd.heightfield.width        = width;
+		cd.heightfield.length       = length;
+		cd.heightfield.height_scale = scale;
+		cd.heightfield.height_min   = -half;
+		cd.heightfield.height_max   =  half;
+		cd.heightfield.cell_size    = json_object::has(collider_data, "cell_size")
+			? sjson::parse_float(collider_data["cell_size"])
+			: 1.0f
+			;
+		set_translation(cd.local_tm, translation(cd.local_tm) + y(cd.local_tm)*middle);
+		return 0;
+	}
+
 	const char* find_node_by_name(const JsonObject& nodes, const char* name)
 	{
 		auto cur = json_object::begin(nodes);
@@ -208,6 +520,11 @@ namespace physics_resource_internal
 
 		Array<Vector3> points(default_allocator());
 		Array<u16> point_indices(default_allocator());
+		Array<char> bvh(default_allocator());
+		Array<s16> heights(default_allocator());
+		AABB hull_aabb;
+		hull_aabb.min = VECTOR3_ZERO;
+		hull_aabb.max = VECTOR3_ZERO;
 
 		DynamicString source(ta);
 		if (json_object::has(obj, "source"))
@@ -278,10 +595,34 @@ namespace physics_resource_internal
 			case ColliderType::SPHERE:      compile_sphere(cd, points); break;
 			case ColliderType::CAPSULE:     compile_capsule(cd, points); break;
 			case ColliderType::BOX:         compile_box(cd, points); break;
-			case ColliderType::CONVEX_HULL: break;
-			case ColliderType::MESH:        break;
+			case ColliderType::CONVEX_HULL:
+				{
+					const u32 max_vertices = json_object::has(obj, "max_vertices")
+						? sjson::parse_int(obj["max_vertices"])
+						: 32
+						;
+					const f32 weld_distance = json_object::has(obj, "weld_distance")
+						? sjson::parse_float(obj["weld_distance"])
+						: 0.001f
+						;
+					DATA_COMPILER_ASSERT(max_vertices >= 4
+						, opts
+						, "Convex hulls need at least 4 vertices"
+						);
+					compile_convex_hull(points, max_vertices, weld_distance);
+					aabb::from_points(hull_aabb, array::size(points), array::begin(points));
+				}
+				break;
+			case ColliderType::MESH:
+				DATA_COMPILER_ASSERT(array::size(point_indices) >= 3
+					, opts
+					, "Geometry '%s' has no triangles"
+					, name.c_str()
+					);
+				compile_mesh_bvh(bvh, points, point_indices);
+				break;
 			case ColliderType::HEIGHTFIELD:
-				DATA_COMPILER_ASSERT(false, opts, "Not implemented yet");
+				DATA_COMPILER_ASSERT(false, opts, "Heightfields must be defined in collider_data");
 				break;
 			}
 		}
@@ -306,6 +647,9 @@ namespace physics_resource_internal
 			} else if (cd.type == ColliderType::CAPSULE) {
 				cd.capsule.radius = sjson::parse_float(collider_data["radius"]);
 				cd.capsule.height = sjson::parse_float(collider_data["height"]);
+			} else if (cd.type == ColliderType::HEIGHTFIELD) {
+				if (compile_heightfield(cd, heights, collider_data, opts) != 0)
+					return -1;
 			}
 		}
 
@@ -314,8 +658,19 @@ namespace physics_resource_internal
 		if (needs_points)
 		{
 			cd.size += sizeof(u32) + sizeof(Vector3)*array::size(points);
+			if (cd.type == ColliderType::CONVEX_HULL)
+				cd.size += sizeof(AABB);
 			if (cd.type == ColliderType::MESH)
+			{
 				cd.size += sizeof(u32) + sizeof(u16)*array::size(point_indices);
+				cd.size  = (cd.size + alignof(u32) - 1) & ~(alignof(u32) - 1);
+				cd.size += sizeof(u32) + sizeof(u32) + array::size(bvh);
+			}
+		}
+		else if (cd.type == ColliderType::HEIGHTFIELD)
+		{
+			cd.size += sizeof(s16)*array::size(heights);
+			cd.size  = (cd.size + alignof(u32) - 1) & ~(alignof(u32) - 1);
 		}
 
 		FileBuffer fb(output);
@@ -331,6 +686,7 @@ namespace physics_resource_internal
 		bw.write(cd.heightfield.height_scale);
 		bw.write(cd.heightfield.height_min);
 		bw.write(cd.heightfield.height_max);
+		bw.write(cd.heightfield.cell_size);
 		bw.write(cd.size);
 
 		if (needs_points)
@@ -339,13 +695,27 @@ namespace physics_resource_internal
 			for (u32 ii = 0; ii < array::size(points); ++ii)
 				bw.write(points[ii]);
 
+			if (cd.type == ColliderType::CONVEX_HULL)
+				bw.write(hull_aabb);
+
 			if (cd.type == ColliderType::MESH)
 			{
 				bw.write(array::size(point_indices));
 				for (u32 ii = 0; ii < array::size(point_indices); ++ii)
 					bw.write(point_indices[ii]);
+
+				bw.align(alignof(u32));
+				bw.write(physics_resource::bvh_layout());
+				bw.write(array::size(bvh));
+				bw.write(array::begin(bvh), array::size(bvh));
 			}
 		}
+		else if (cd.type == ColliderType::HEIGHTFIELD)
+		{
+			for (u32 ii = 0; ii < array::size(heights); ++ii)
+				bw.write(heights[ii]);
+			bw.align(alignof(u32));
+		}
 		return 0;
 	}
 
@@ -496,10 +866,11 @@ namespace physics_config_resource_internal
 				pa.angular_damping = sjson::parse_float(actor["angular_damping"]);
 
 			pa.flags = 0;
-			pa.flags |= (json_object::has(actor, "dynamic")         && sjson::parse_bool(actor["dynamic"])        ) ? PhysicsActor::DYNAMIC         : 0;
-			pa.flags |= (json_object::has(actor, "kinematic")       && sjson::parse_bool(actor["kinematic"])      ) ? PhysicsActor::KINEMATIC       : 0;
-			pa.flags |= (json_object::has(actor, "disable_gravity") && sjson::parse_bool(actor["disable_gravity"])) ? PhysicsActor::DISABLE_GRAVITY : 0;
-			pa.flags |= (json_object::has(actor, "trigger")         && sjson::parse_bool(actor["trigger"])        ) ? PhysicsActor::TRIGGER         : 0;
+			pa.flags |= (json_object::has(actor, "dynamic")          && sjson::parse_bool(actor["dynamic"])         ) ? PhysicsActor::DYNAMIC          : 0;
+			pa.flags |= (json_object::has(actor, "kinematic")        && sjson::parse_bool(actor["kinematic"])       ) ? PhysicsActor::KINEMATIC        : 0;
+			pa.flags |= (json_object::has(actor, "disable_gravity")  && sjson::parse_bool(actor["disable_gravity"]) ) ? PhysicsActor::DISABLE_GRAVITY  : 0;
+			pa.flags |= (json_object::has(actor, "trigger")          && sjson::parse_bool(actor["trigger"])         ) ? PhysicsActor::TRIGGER          : 0;
+			pa.flags |= (json_object::has(actor, "collision_events") && sjson::parse_bool(actor["collision_events"])) ? PhysicsActor::COLLISION_EVENTS : 0;
 
 			array::push_back(objects, pa);
 		}
@@ -15,6 +15,8 @@
 
 namespace crown
 {
+struct ColliderDesc;
+
 namespace physics_resource_internal
 {
 	s32 compile_collider(Buffer& output, const char* json, CompileOptions& opts);
@@ -53,10 +55,11 @@ struct PhysicsActor
 {
 	enum
 	{
-		DYNAMIC         = 1 << 0,
-		KINEMATIC       = 1 << 1,
-		DISABLE_GRAVITY = 1 << 2,
-		TRIGGER         = 1 << 3
+		DYNAMIC          = 1 << 0,
+		KINEMATIC        = 1 << 1,
+		DISABLE_GRAVITY  = 1 << 2,
+		TRIGGER          = 1 << 3,
+		COLLISION_EVENTS = 1 << 4
 	};
 
 	StringId32 name;
@@ -65,6 +68,29 @@ struct PhysicsActor
 	u32 flags;
 };
 
+/// Triangle mesh of a ColliderType::MESH collider.
+struct ColliderMesh
+{
+	u32 num_points;
+	const Vector3* points;
+	u32 num_indices;
+	const u16* indices;
+	u32 bvh_layout;    ///< Memory layout of bvh, see physics_resource::bvh_layout().
+	u32 bvh_size;
+	const char* bvh;   ///< Quantized btOptimizedBvh, serialized in place.
+};
+
+namespace physics_resource
+{
+	/// Returns the triangle mesh of the collider @a cd.
+	ColliderMesh collider_mesh(const ColliderDesc* cd);
+
+	/// Returns the layout of the BVHs serialized in place by this build:
+	/// pointer size, btScalar size and endianness.
+	u32 bvh_layout();
+
+} // namespace physics_resource
+
 namespace physics_config_resource_internal
 {
 	s32 compile(CompileOptions& opts);
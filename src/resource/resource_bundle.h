@@ -0,0 +1,41 @@
+/*
+ * Copyright (c) 2012-2021 Daniele Bartolini et al.
+ * License: https://github.com/dbartolini/crown/blob/master/LICENSE
+ */
+
+#pragma once
+
+#include "core/strings/string_id.h"
+#include "core/types.h"
+
+#define RESOURCE_BUNDLE_VERSION u32(1)
+#define RESOURCE_BUNDLE_ALIGN   u32(16)
+
+namespace crown
+{
+/// Header of a bundle file.
+///
+/// A bundle packs the compiled data of all the resources in a package into
+/// a single file. The header is followed by an array of num_resources
+/// ResourceBundleEntry, sorted by resource ID, and by the data of each
+/// resource, aligned to RESOURCE_BUNDLE_ALIGN bytes.
+///
+/// @ingroup Resource
+struct ResourceBundleHeader
+{
+	u32 version;
+	u32 num_resources;
+};
+
+/// Locates the data of a resource inside a bundle file.
+///
+/// @ingroup Resource
+struct ResourceBundleEntry
+{
+	StringId64 type;
+	StringId64 name;
+	u32 offset; ///< Offset from the beginning of the bundle.
+	u32 size;
+};
+
+} // namespace crown
@@ -0,0 +1,44 @@
+/*
+ * Copyright (c) 2012-2021 Daniele Bartolini et al.
+ * License: https://github.com/dbartolini/crown/blob/master/LICENSE
+ */
+
+#pragma once
+
+#include "core/types.h"
+
+#define RESOURCE_COMPRESSED_MAGIC u32(0x9C) //!< Never matches RESOURCE_HEADER()
+
+namespace crown
+{
+/// Enumerates the compression methods of compiled resources.
+///
+/// @ingroup Resource
+struct ResourceCompression
+{
+	enum Enum
+	{
+		NONE,
+		LZ4,
+
+		COUNT
+	};
+};
+
+/// Header of a compressed resource.
+///
+/// Compressed resources start with this header instead of the
+/// RESOURCE_HEADER() of their type. The header is followed by
+/// compressed_size bytes of data which decompress to the size bytes of the
+/// resource, including its own RESOURCE_HEADER().
+///
+/// @ingroup Resource
+struct ResourceCompressionHeader
+{
+	u32 magic;           ///< RESOURCE_COMPRESSED_MAGIC.
+	u32 compression;     ///< ResourceCompression::Enum.
+	u32 size;            ///< Size of the decompressed data.
+	u32 compressed_size; ///< Size of the data following the header.
+};
+
+} // namespace crown
@@ -26,4 +26,10 @@ void destination_path(DynamicString& path, ResourceId id)
 	path::join(path, CROWN_DATA_DIRECTORY, id_hex.c_str());
 }
 
+void bundle_path(DynamicString& path, ResourceId id)
+{
+	destination_path(path, id);
+	path += ".bundle";
+}
+
 } // namespace crown
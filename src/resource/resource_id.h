@@ -37,4 +37,7 @@ ResourceId resource_id(const char* path);
 /// Returns the destination @a path of the resource @a id.
 void destination_path(DynamicString& path, ResourceId id);
 
+/// Returns the @a path of the bundle of the package @a id.
+void bundle_path(DynamicString& path, ResourceId id);
+
 } // namespace crown
@@ -4,11 +4,14 @@
  */
 
 #include "config.h"
+#include "core/containers/array.inl"
 #include "core/containers/hash_map.inl"
 #include "core/containers/queue.inl"
 #include "core/filesystem/file.h"
+#include "core/filesystem/file_buffer.inl"
 #include "core/filesystem/filesystem.h"
 #include "core/filesystem/path.h"
+#include "core/lz4.h"
 #include "core/memory/globals.h"
 #include "core/memory/temp_allocator.inl"
 #include "core/os.h"
@@ -16,53 +19,251 @@
 #include "core/strings/string_id.inl"
 #include "core/thread/scoped_mutex.inl"
 #include "device/log.h"
+#include "device/profiler.h"
+#include "resource/resource_compression.h"
 #include "resource/resource_id.inl"
 #include "resource/resource_loader.h"
 #include "resource/types.h"
+#include <algorithm>
 
 LOG_SYSTEM(RESOURCE_LOADER, "resource_loader")
 
 namespace crown
 {
-ResourceLoader::ResourceLoader(Filesystem& data_filesystem)
+ResourceLoader::Bundle::Bundle(Allocator& a)
+	: references(0)
+	, views(0)
+	, readers(0)
+	, file(NULL)
+	, data(NULL)
+	, size(0)
+	, entries(a)
+{
+}
+
+/// Returns whether @a a should be served after @a b.
+static bool less_urgent(const ResourceRequest& a, const ResourceRequest& b)
+{
+	return a.priority != b.priority
+		? a.priority > b.priority
+		: a.sequence > b.sequence
+		;
+}
+
+static void push_request(Array<ResourceRequest>& heap, const ResourceRequest& rr)
+{
+	array::push_back(heap, rr);
+	std::push_heap(array::begin(heap), array::end(heap), less_urgent);
+}
+
+static ResourceRequest pop_request(Array<ResourceRequest>& heap)
+{
+	std::pop_heap(array::begin(heap), array::end(heap), less_urgent);
+	ResourceRequest rr = array::back(heap);
+	array::pop_back(heap);
+	return rr;
+}
+
+/// Returns the header of the resource @a data if it is compressed, otherwise
+/// returns NULL.
+static const ResourceCompressionHeader* compression_header(const void* data, u32 size)
+{
+	const ResourceCompressionHeader* header = (const ResourceCompressionHeader*)data;
+	return size >= sizeof(*header) && header->magic == RESOURCE_COMPRESSED_MAGIC
+		? header
+		: NULL
+		;
+}
+
+/// Reads @a size bytes of the resource @a rr from @a file. Data that has to
+/// be decoded is read into a buffer, the rest straight into the resource's
+/// own allocation.
+static void read_data(ResourceRequest& rr, File& file, u32 size)
+{
+	u32 magic = 0;
+	if (!rr.load_function && size >= sizeof(ResourceCompressionHeader))
+	{
+		const u32 position = file.position();
+		file.read(&magic, sizeof(magic));
+		file.seek(position);
+	}
+
+	if (rr.load_function || magic == RESOURCE_COMPRESSED_MAGIC)
+	{
+		rr.buffer = CE_NEW(default_allocator(), Buffer)(default_allocator());
+		array::resize(*rr.buffer, size);
+		file.read(array::begin(*rr.buffer), size);
+	}
+	else
+	{
+		rr.data = rr.allocator->allocate(size, 16);
+		file.read(rr.data, size);
+	}
+}
+
+static u32 find_request(const Array<ResourceRequest>& heap, StringId64 type, StringId64 name)
+{
+	for (u32 i = 0; i < array::size(heap); ++i)
+	{
+		if (heap[i].type == type && heap[i].name == name)
+			return i;
+	}
+
+	return UINT32_MAX;
+}
+
+ResourceLoader::ResourceLoader(Filesystem& data_filesystem, u32 num_threads)
 	: _data_filesystem(data_filesystem)
 	, _requests(default_allocator())
+	, _decodes(default_allocator())
 	, _loaded(default_allocator())
 	, _fallback(default_allocator())
+	, _num_pending(0)
+	, _sequence(0)
+	, _decode_threads(default_allocator())
+	, _bundles(default_allocator())
+	, _views(default_allocator())
 	, _exit(false)
 {
-	_thread.start([](void* thiz) { return ((ResourceLoader*)thiz)->run(); }, this);
+	CE_ENSURE(num_threads > 0);
+
+	_io_thread.start([](void* thiz) { return ((ResourceLoader*)thiz)->run_io(); }, this);
+
+	for (u32 i = 0; i < num_threads; ++i)
+	{
+		Thread* thread = CE_NEW(default_allocator(), Thread)();
+		thread->start([](void* thiz) { return ((ResourceLoader*)thiz)->run_decode(); }, this);
+		array::push_back(_decode_threads, thread);
+	}
 }
 
 ResourceLoader::~ResourceLoader()
 {
+	_mutex.lock();
 	_exit = true;
-	_requests_condition.signal(); // Spurious wake to exit thread
-	_thread.stop();
+	_mutex.unlock();
+	_requests_condition.broadcast();
+	_decodes_condition.broadcast();
+
+	_io_thread.stop();
+	for (u32 i = 0; i < array::size(_decode_threads); ++i)
+	{
+		_decode_threads[i]->stop();
+		CE_DELETE(default_allocator(), _decode_threads[i]);
+	}
+
+	for (u32 i = 0; i < array::size(_decodes); ++i)
+		CE_DELETE(default_allocator(), _decodes[i].buffer);
+
+	auto cur = hash_map::begin(_views);
+	auto end = hash_map::end(_views);
+	for (; cur != end; ++cur)
+	{
+		HASH_MAP_SKIP_HOLE(_views, cur);
+
+		if (cur->second.bundle == NULL)
+			_data_filesystem.unmap(cur->second.data, cur->second.size);
+	}
+
+	for (u32 i = 0; i < array::size(_bundles); ++i)
+	{
+		Bundle* bundle = _bundles[i];
+		if (bundle->file != NULL)
+			_data_filesystem.close(*bundle->file);
+		if (bundle->data != NULL)
+			_data_filesystem.unmap(bundle->data, bundle->size);
+		CE_DELETE(default_allocator(), bundle);
+	}
 }
 
 void ResourceLoader::add_request(const ResourceRequest& rr)
 {
 	ScopedMutex sm(_mutex);
-	queue::push_back(_requests, rr);
+
+	ResourceRequest req = rr;
+	req.sequence = _sequence++;
+	req.buffer = NULL;
+	req.size = 0;
+	req.mapped_size = 0;
+	push_request(_requests, req);
+	++_num_pending;
+
 	_requests_condition.signal();
 }
 
+bool ResourceLoader::cancel_request(StringId64 type, StringId64 name)
+{
+	ScopedMutex sm(_mutex);
+
+	u32 i = find_request(_requests, type, name);
+	if (i != UINT32_MAX)
+	{
+		_requests[i] = array::back(_requests);
+		array::pop_back(_requests);
+		std::make_heap(array::begin(_requests), array::end(_requests), less_urgent);
+		if (--_num_pending == 0)
+			_pending_condition.broadcast();
+		return true;
+	}
+
+	i = find_request(_decodes, type, name);
+	if (i != UINT32_MAX)
+	{
+		CE_DELETE(default_allocator(), _decodes[i].buffer);
+		_decodes[i] = array::back(_decodes);
+		array::pop_back(_decodes);
+		std::make_heap(array::begin(_decodes), array::end(_decodes), less_urgent);
+		if (--_num_pending == 0)
+			_pending_condition.broadcast();
+		return true;
+	}
+
+	return false;
+}
+
+void ResourceLoader::set_priority(StringId64 type, StringId64 name, ResourcePriority::Enum priority)
+{
+	ScopedMutex sm(_mutex);
+
+	u32 i = find_request(_requests, type, name);
+	if (i != UINT32_MAX)
+	{
+		_requests[i].priority = priority;
+		std::make_heap(array::begin(_requests), array::end(_requests), less_urgent);
+		return;
+	}
+
+	i = find_request(_decodes, type, name);
+	if (i != UINT32_MAX)
+	{
+		_decodes[i].priority = priority;
+		std::make_heap(array::begin(_decodes), array::end(_decodes), less_urgent);
+	}
+}
+
 void ResourceLoader::flush()
 {
-	while (num_requests()) {}
+	ScopedMutex sm(_mutex);
+	while (_num_pending != 0)
+		_pending_condition.wait(_mutex);
 }
 
 u32 ResourceLoader::num_requests()
 {
 	ScopedMutex sm(_mutex);
-	return queue::size(_requests);
+	return _num_pending;
 }
 
 void ResourceLoader::add_loaded(ResourceRequest rr)
 {
-	ScopedMutex sm(_loaded_mutex);
-	queue::push_back(_loaded, rr);
+	{
+		ScopedMutex sm(_loaded_mutex);
+		queue::push_back(_loaded, rr);
+	}
+
+	ScopedMutex sm(_mutex);
+	if (--_num_pending == 0)
+		_pending_condition.broadcast();
 }
 
 void ResourceLoader::get_loaded(Array<ResourceRequest>& loaded)
@@ -84,61 +285,375 @@ void ResourceLoader::register_fallback(StringId64 type, StringId64 name)
 	hash_map::set(_fallback, type, name);
 }
 
-s32 ResourceLoader::run()
+void ResourceLoader::mount_bundle(StringId64 name)
+{
+	ScopedMutex sm(_bundles_mutex);
+
+	for (u32 i = 0; i < array::size(_bundles); ++i)
+	{
+		if (_bundles[i]->package == name && _bundles[i]->references > 0)
+		{
+			++_bundles[i]->references;
+			return;
+		}
+	}
+
+	TempAllocator128 ta;
+	DynamicString path(ta);
+	bundle_path(path, resource_id(RESOURCE_TYPE_PACKAGE, name));
+
+	File* file = _data_filesystem.open(path.c_str(), FileOpenMode::READ);
+	if (!file->is_open())
+	{
+		_data_filesystem.close(*file);
+		return;
+	}
+
+	ResourceBundleHeader header;
+	file->read(&header, sizeof(header));
+	if (header.version != RESOURCE_HEADER(RESOURCE_BUNDLE_VERSION))
+	{
+		logw(RESOURCE_LOADER, "Wrong bundle version: %s", path.c_str());
+		_data_filesystem.close(*file);
+		return;
+	}
+
+	Bundle* bundle = CE_NEW(default_allocator(), Bundle)(default_allocator());
+	bundle->package = name;
+	bundle->references = 1;
+	bundle->file = file;
+	bundle->data = (const char*)_data_filesystem.map(path.c_str(), &bundle->size);
+
+	for (u32 i = 0; i < header.num_resources; ++i)
+	{
+		ResourceBundleEntry entry;
+		file->read(&entry, sizeof(entry));
+		hash_map::set(bundle->entries, resource_id(entry.type, entry.name), entry);
+	}
+
+	array::push_back(_bundles, bundle);
+}
+
+void ResourceLoader::unmount_bundle(StringId64 name)
+{
+	ScopedMutex sm(_bundles_mutex);
+
+	for (u32 i = 0; i < array::size(_bundles); ++i)
+	{
+		Bundle* bundle = _bundles[i];
+		if (bundle->package != name || bundle->references == 0)
+			continue;
+
+		if (--bundle->references == 0)
+			release_bundle(bundle);
+		return;
+	}
+}
+
+void ResourceLoader::release_bundle(Bundle* bundle)
+{
+	// Reads in progress keep the bundle open until they complete.
+	if (bundle->references != 0 || bundle->readers != 0)
+		return;
+
+	if (bundle->file != NULL)
+	{
+		_data_filesystem.close(*bundle->file);
+		bundle->file = NULL;
+	}
+
+	// Resources mapped from the bundle keep it alive until they are unloaded.
+	if (bundle->views != 0)
+		return;
+
+	if (bundle->data != NULL)
+		_data_filesystem.unmap(bundle->data, bundle->size);
+
+	for (u32 i = 0; i < array::size(_bundles); ++i)
+	{
+		if (_bundles[i] == bundle)
+		{
+			_bundles[i] = array::back(_bundles);
+			array::pop_back(_bundles);
+			break;
+		}
+	}
+
+	CE_DELETE(default_allocator(), bundle);
+}
+
+bool ResourceLoader::unmap(const void* data)
+{
+	ScopedMutex sm(_bundles_mutex);
+
+	MappedView view;
+	view.data = NULL;
+	view.size = 0;
+	view.bundle = NULL;
+	view.references = 0;
+	view = hash_map::get(_views, (u64)(uintptr_t)data, view);
+	if (view.data == NULL)
+		return false;
+
+	if (--view.references == 0)
+		hash_map::remove(_views, (u64)(uintptr_t)data);
+	else
+		hash_map::set(_views, (u64)(uintptr_t)data, view);
+
+	if (view.bundle != NULL)
+	{
+		--view.bundle->views;
+		release_bundle(view.bundle);
+	}
+	else
+	{
+		_data_filesystem.unmap(view.data, view.size);
+	}
+
+	return true;
+}
+
+bool ResourceLoader::read_mapped(ResourceRequest& rr, const char* path)
+{
+	u32 size = 0;
+	const void* data = _data_filesystem.map(path, &size);
+	if (data == NULL)
+		return false;
+
+	rr.size = size;
+
+	// Compressed resources are decompressed by the decode threads.
+	if (compression_header(data, size) != NULL)
+	{
+		rr.buffer = CE_NEW(default_allocator(), Buffer)(default_allocator());
+		array::push(*rr.buffer, (const char*)data, size);
+		_data_filesystem.unmap(data, size);
+		return true;
+	}
+
+	MappedView view;
+	view.data = data;
+	view.size = size;
+	view.bundle = NULL;
+	view.references = 1;
+
+	ScopedMutex sm(_bundles_mutex);
+	hash_map::set(_views, (u64)(uintptr_t)data, view);
+
+	rr.data = (void*)data;
+	rr.mapped_size = size;
+	return true;
+}
+
+bool ResourceLoader::read_from_bundle(ResourceRequest& rr, ResourceId id)
+{
+	ResourceBundleEntry entry;
+	entry.offset = 0;
+	entry.size = UINT32_MAX;
+
+	Bundle* bundle = NULL;
+	{
+		ScopedMutex sm(_bundles_mutex);
+
+		u32 i = 0;
+		for (; i < array::size(_bundles); ++i)
+		{
+			if (_bundles[i]->references == 0)
+				continue;
+
+			entry = hash_map::get(_bundles[i]->entries, id, entry);
+			if (entry.size != UINT32_MAX)
+				break;
+		}
+
+		if (i == array::size(_bundles))
+			return false;
+
+		bundle = _bundles[i];
+		rr.size = entry.size;
+
+		// Resources without a load function are used in-place, the others
+		// and the compressed ones are decoded from a copy of the mapped data.
+		if (bundle->data != NULL
+			&& !rr.load_function
+			&& compression_header(bundle->data + entry.offset, entry.size) == NULL
+			)
+		{
+			// The same resource can be requested again while a previous
+			// request is still being completed.
+			MappedView view;
+			view.data = bundle->data + entry.offset;
+			view.size = entry.size;
+			view.bundle = bundle;
+			view.references = 0;
+			view = hash_map::get(_views, (u64)(uintptr_t)view.data, view);
+			++view.references;
+			hash_map::set(_views, (u64)(uintptr_t)view.data, view);
+			++bundle->views;
+
+			rr.data = (void*)view.data;
+			rr.mapped_size = entry.size;
+			return true;
+		}
+
+		// Keep the bundle alive while its data is read without holding the
+		// lock, so that other threads can use the bundles in the meantime.
+		++bundle->readers;
+	}
+
+	if (bundle->data != NULL)
+	{
+		rr.buffer = CE_NEW(default_allocator(), Buffer)(default_allocator());
+		array::push(*rr.buffer, bundle->data + entry.offset, entry.size);
+	}
+	else
+	{
+		// Read the whole resource with a single seek and read.
+		bundle->file->seek(entry.offset);
+		read_data(rr, *bundle->file, entry.size);
+	}
+
+	ScopedMutex sm(_bundles_mutex);
+	--bundle->readers;
+	release_bundle(bundle);
+	return true;
+}
+
+void ResourceLoader::read(ResourceRequest& rr)
+{
+	ResourceId res_id = resource_id(rr.type, rr.name);
+
+	if (read_from_bundle(rr, res_id))
+		return;
+
+	TempAllocator128 ta;
+	DynamicString path(ta);
+	destination_path(path, res_id);
+
+	// Resources without a load function are used in-place from a
+	// read-only mapping of their file, if possible.
+	if (!rr.load_function && read_mapped(rr, path.c_str()))
+		return;
+
+	File* file = _data_filesystem.open(path.c_str(), FileOpenMode::READ);
+	if (!file->is_open())
+	{
+		logw(RESOURCE_LOADER, "Can't load resource: " RESOURCE_ID_FMT ". Falling back...", res_id._id);
+
+		StringId64 fallback_name;
+		fallback_name = hash_map::get(_fallback, rr.type, fallback_name);
+		CE_ENSURE(fallback_name._id != 0);
+
+		res_id = resource_id(rr.type, fallback_name);
+		destination_path(path, res_id);
+
+		_data_filesystem.close(*file);
+		file = _data_filesystem.open(path.c_str(), FileOpenMode::READ);
+	}
+	CE_ASSERT(file->is_open(), "Can't load fallback resource: " RESOURCE_ID_FMT, res_id._id);
+
+	rr.size = file->size();
+	read_data(rr, *file, rr.size);
+
+	_data_filesystem.close(*file);
+}
+
+s32 ResourceLoader::run_io()
 {
 	while (1)
 	{
 		_mutex.lock();
-		while (queue::empty(_requests) && !_exit)
+		while (array::size(_requests) == 0 && !_exit)
 			_requests_condition.wait(_mutex);
 
 		if (_exit)
 			break;
 
-		ResourceRequest rr = queue::front(_requests);
+		ResourceRequest rr = pop_request(_requests);
 		_mutex.unlock();
 
-		ResourceId res_id = resource_id(rr.type, rr.name);
+		ENTER_PROFILE_SCOPE("resource_loader.read");
+		read(rr);
+		LEAVE_PROFILE_SCOPE();
 
-		TempAllocator128 ta;
-		DynamicString path(ta);
-		destination_path(path, res_id);
-
-		File* file = _data_filesystem.open(path.c_str(), FileOpenMode::READ);
-		if (!file->is_open())
+		if (rr.buffer != NULL)
+		{
+			ScopedMutex sm(_mutex);
+			push_request(_decodes, rr);
+			_decodes_condition.signal();
+		}
+		else
 		{
-			logw(RESOURCE_LOADER, "Can't load resource: " RESOURCE_ID_FMT ". Falling back...", res_id._id);
+			CE_ASSERT(*(u32*)rr.data == RESOURCE_HEADER(rr.version), "Wrong version");
+			add_loaded(rr);
+		}
+	}
 
-			StringId64 fallback_name;
-			fallback_name = hash_map::get(_fallback, rr.type, fallback_name);
-			CE_ENSURE(fallback_name._id != 0);
+	_mutex.unlock();
+	return 0;
+}
 
-			res_id = resource_id(rr.type, fallback_name);
-			destination_path(path, res_id);
+s32 ResourceLoader::run_decode()
+{
+	while (1)
+	{
+		_mutex.lock();
+		while (array::size(_decodes) == 0 && !_exit)
+			_decodes_condition.wait(_mutex);
+
+		if (_exit)
+			break;
+
+		ResourceRequest rr = pop_request(_decodes);
+		_mutex.unlock();
 
-			_data_filesystem.close(*file);
-			file = _data_filesystem.open(path.c_str(), FileOpenMode::READ);
+		ENTER_PROFILE_SCOPE("resource_loader.decode");
+		Buffer* buffer = rr.buffer;
+		const ResourceCompressionHeader* header = compression_header(array::begin(*buffer), array::size(*buffer));
+		if (header != NULL)
+		{
+			// Resources without a load function are decompressed straight
+			// into their own allocation.
+			Buffer* decompressed = NULL;
+			void* dst;
+			if (rr.load_function)
+			{
+				decompressed = CE_NEW(default_allocator(), Buffer)(default_allocator());
+				array::resize(*decompressed, header->size);
+				dst = array::begin(*decompressed);
+			}
+			else
+			{
+				rr.data = rr.allocator->allocate(header->size, 16);
+				dst = rr.data;
+			}
+
+			const bool success = header->compression == ResourceCompression::LZ4
+				&& header->compressed_size <= array::size(*buffer) - sizeof(*header)
+				&& lz4_decompress(dst, header->size, header + 1, header->compressed_size)
+				;
+			CE_ASSERT(success, "Corrupted resource: " RESOURCE_ID_FMT, resource_id(rr.type, rr.name)._id);
+			CE_UNUSED(success);
+
+			CE_DELETE(default_allocator(), buffer);
+			buffer = decompressed;
 		}
-		CE_ASSERT(file->is_open(), "Can't load fallback resource: " RESOURCE_ID_FMT, res_id._id);
 
 		if (rr.load_function)
 		{
-			rr.data = rr.load_function(*file, *rr.allocator);
+			FileBuffer fb(*buffer);
+			rr.data = rr.load_function(fb, *rr.allocator);
 		}
 		else
 		{
-			const u32 size = file->size();
-			rr.data = rr.allocator->allocate(size, 16);
-			file->read(rr.data, size);
 			CE_ASSERT(*(u32*)rr.data == RESOURCE_HEADER(rr.version), "Wrong version");
 		}
 
-		_data_filesystem.close(*file);
+		CE_DELETE(default_allocator(), buffer);
+		rr.buffer = NULL;
+		LEAVE_PROFILE_SCOPE();
 
 		add_loaded(rr);
-		_mutex.lock();
-		queue::pop_front(_requests);
-		_mutex.unlock();
 	}
 
 	_mutex.unlock();
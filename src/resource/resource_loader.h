@@ -12,6 +12,9 @@
 #include "core/thread/mutex.h"
 #include "core/thread/thread.h"
 #include "core/types.h"
+#include "resource/resource_bundle.h"
+#include "resource/resource_id.h"
+#include "resource/types.h"
 
 namespace crown
 {
@@ -25,33 +28,82 @@ struct ResourceRequest
 	LoadFunction load_function;
 	Allocator* allocator;
 	void* data;
+	ResourcePriority::Enum priority;
+	u32 sequence; ///< Order of arrival among requests of the same priority.
+	Buffer* buffer;  ///< Data read from disk, waiting to be decoded.
+	u32 size;        ///< Size in bytes of the data read from disk.
+	u32 mapped_size; ///< Size in bytes of data if it is mapped from disk.
 };
 
-/// Loads resources in a background thread.
+/// Loads resources in background threads.
+///
+/// Requests are served in order of priority. A single thread reads data from
+/// disk while a pool of threads decompresses the data read and runs the load
+/// functions on it, so that decoding never stalls I/O and vice versa.
 ///
 /// @ingroup Resource
 struct ResourceLoader
 {
+	struct Bundle
+	{
+		StringId64 package;
+		u32 references; ///< Number of mount_bundle() calls.
+		u32 views;      ///< Number of resources mapped from data.
+		u32 readers;    ///< Number of reads in progress.
+		File* file;
+		const char* data; ///< Mapped bundle or NULL.
+		u32 size;
+		HashMap<ResourceId, ResourceBundleEntry> entries;
+
+		///
+		Bundle(Allocator& a);
+	};
+
+	struct MappedView
+	{
+		const void* data;
+		u32 size;
+		Bundle* bundle; ///< Bundle the view belongs to or NULL.
+		u32 references;
+	};
+
 	Filesystem& _data_filesystem;
 
-	Queue<ResourceRequest> _requests;
+	Array<ResourceRequest> _requests; ///< Heap of requests waiting for I/O.
+	Array<ResourceRequest> _decodes;  ///< Heap of requests waiting for load_function.
 	Queue<ResourceRequest> _loaded;
 	HashMap<StringId64, StringId64> _fallback;
+	u32 _num_pending;
+	u32 _sequence;
 
-	Thread _thread;
-	Mutex _mutex;
+	Thread _io_thread;
+	Array<Thread*> _decode_threads;
+	Mutex _mutex; // Protects _requests, _decodes, _num_pending and _sequence.
 	ConditionVariable _requests_condition;
+	ConditionVariable _decodes_condition;
+	ConditionVariable _pending_condition;
 	Mutex _loaded_mutex;
+	Array<Bundle*> _bundles;
+	HashMap<u64, MappedView> _views;
+	Mutex _bundles_mutex; // Protects _bundles and _views.
 	bool _exit;
 
 	u32 num_requests();
 	void add_loaded(ResourceRequest rr);
+	bool read_from_bundle(ResourceRequest& rr, ResourceId id);
+	bool read_mapped(ResourceRequest& rr, const char* path);
+	void read(ResourceRequest& rr);
+	void release_bundle(Bundle* bundle);
 
 	/// Do not call explicitly.
-	s32 run();
+	s32 run_io();
 
-	/// Read resources from @a data_filesystem.
-	ResourceLoader(Filesystem& data_filesystem);
+	/// Do not call explicitly.
+	s32 run_decode();
+
+	/// Reads resources from @a data_filesystem and runs load functions on
+	/// @a num_threads threads.
+	ResourceLoader(Filesystem& data_filesystem, u32 num_threads);
 
 	///
 	~ResourceLoader();
@@ -59,6 +111,15 @@ struct ResourceLoader
 	/// Adds a request for loading the resource described by @a rr.
 	void add_request(const ResourceRequest& rr);
 
+	/// Removes the request for loading the resource (@a type, @a name) and
+	/// returns true if it has not been started yet, otherwise returns false
+	/// and the request completes normally.
+	bool cancel_request(StringId64 type, StringId64 name);
+
+	/// Sets the @a priority of the request for loading the resource
+	/// (@a type, @a name) if it has not been started yet.
+	void set_priority(StringId64 type, StringId64 name, ResourcePriority::Enum priority);
+
 	/// Blocks until all pending requests have been processed.
 	void flush();
 
@@ -67,6 +128,18 @@ struct ResourceLoader
 
 	/// Registers a fallback resource @a name for the given resource @a type.
 	void register_fallback(StringId64 type, StringId64 name);
+
+	/// Makes the resources packed in the bundle of the package @a name
+	/// available to subsequent requests. Does nothing if the package has no
+	/// bundle.
+	void mount_bundle(StringId64 name);
+
+	/// Releases the bundle of the package @a name mounted with mount_bundle().
+	void unmount_bundle(StringId64 name);
+
+	/// Releases the resource @a data if it is a read-only view of a mapped
+	/// file and returns true, otherwise returns false.
+	bool unmap(const void* data);
 };
 
 } // namespace crown
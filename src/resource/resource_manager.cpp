@@ -8,9 +8,13 @@
 #include "core/memory/temp_allocator.inl"
 #include "core/strings/dynamic_string.inl"
 #include "core/strings/string_id.inl"
+#include "device/log.h"
 #include "resource/resource_id.inl"
 #include "resource/resource_loader.h"
 #include "resource/resource_manager.h"
+#include <algorithm>
+
+LOG_SYSTEM(RESOURCE_MANAGER, "resource_manager")
 
 namespace crown
 {
@@ -35,7 +39,7 @@ bool operator==(const ResourceManager::ResourceEntry& a, const ResourceManager::
 		;
 }
 
-const ResourceManager::ResourceEntry ResourceManager::ResourceEntry::NOT_FOUND = { 0xffffffffu, NULL };
+const ResourceManager::ResourceEntry ResourceManager::ResourceEntry::NOT_FOUND = { 0xffffffffu, NULL, 0u, 0u, 0u, 0u };
 
 template<>
 struct hash<ResourceManager::ResourcePair>
@@ -46,17 +50,74 @@ struct hash<ResourceManager::ResourcePair>
 	}
 };
 
+/// Returns the most urgent priority @a pe has been requested with, or
+/// ResourcePriority::COUNT if it has no references.
+static ResourcePriority::Enum most_urgent(const ResourceManager::PendingEntry& pe)
+{
+	for (u32 i = 0; i < ResourcePriority::COUNT; ++i)
+	{
+		if (pe.references[i] != 0)
+			return (ResourcePriority::Enum)i;
+	}
+
+	return ResourcePriority::COUNT;
+}
+
+/// Returns the size in bytes of all the memory used by the resources
+/// described by @a rtd.
+static u64 type_memory(const ResourceManager::ResourceTypeData& rtd)
+{
+	return u64(rtd.allocator->total_allocated()) + rtd.mapped_size + rtd.gpu_size;
+}
+
+static bool is_over(u64 memory, u64 budget)
+{
+	return budget != 0u && memory > budget;
+}
+
+ResourceManager::TypeAllocator::TypeAllocator(Allocator& a)
+	: _allocator(a)
+	, _allocated(0u)
+{
+}
+
+void* ResourceManager::TypeAllocator::allocate(u32 size, u32 align)
+{
+	void* p = _allocator.allocate(size, align);
+	const u32 allocated = _allocator.allocated_size(p);
+	_allocated += allocated != SIZE_NOT_TRACKED ? allocated : size;
+	return p;
+}
+
+void ResourceManager::TypeAllocator::deallocate(void* data)
+{
+	if (data == NULL)
+		return;
+
+	const u32 allocated = _allocator.allocated_size(data);
+	if (allocated != SIZE_NOT_TRACKED)
+		_allocated -= allocated;
+	_allocator.deallocate(data);
+}
+
 ResourceManager::ResourceManager(ResourceLoader& rl)
 	: _resource_heap(default_allocator(), "resource")
 	, _loader(&rl)
 	, _type_data(default_allocator())
 	, _rm(default_allocator())
+	, _pending(default_allocator())
 	, _autoload(false)
+	, _cache(false)
+	, _budget(0u)
+	, _clock(0u)
+	, _over_budget(false)
 {
 }
 
 ResourceManager::~ResourceManager()
 {
+	flush();
+
 	auto cur = hash_map::begin(_rm);
 	auto end = hash_map::end(_rm);
 	for (; cur != end; ++cur)
@@ -68,30 +129,56 @@ ResourceManager::~ResourceManager()
 		on_offline(type, name);
 		on_unload(type, cur->second.data);
 	}
+
+	auto type_cur = hash_map::begin(_type_data);
+	auto type_end = hash_map::end(_type_data);
+	for (; type_cur != type_end; ++type_cur)
+	{
+		HASH_MAP_SKIP_HOLE(_type_data, type_cur);
+
+		CE_DELETE(default_allocator(), type_cur->second.allocator);
+	}
 }
 
-void ResourceManager::load(StringId64 type, StringId64 name)
+void ResourceManager::load(StringId64 type, StringId64 name, ResourcePriority::Enum priority)
 {
 	ResourcePair id = { type, name };
 	ResourceEntry& entry = hash_map::get(_rm, id, ResourceEntry::NOT_FOUND);
 
 	if (entry == ResourceEntry::NOT_FOUND)
 	{
+		PendingEntry pe = hash_map::get(_pending, id, PendingEntry());
+		const ResourcePriority::Enum old_priority = most_urgent(pe);
+		++pe.references[priority];
+		hash_map::set(_pending, id, pe);
+
+		// Issue a single request per resource, however many times it is
+		// loaded before completing.
+		if (old_priority != ResourcePriority::COUNT)
+		{
+			if (priority < old_priority)
+				_loader->set_priority(type, name, priority);
+			return;
+		}
+
 		ResourceTypeData rtd;
 		rtd.version = UINT32_MAX;
 		rtd.load = NULL;
 		rtd.online = NULL;
 		rtd.offline = NULL;
 		rtd.unload = NULL;
+		rtd.allocator = NULL;
 		rtd = hash_map::get(_type_data, type, rtd);
+		CE_ASSERT(rtd.allocator != NULL, "Unknown resource type");
 
 		ResourceRequest rr;
 		rr.type = type;
 		rr.name = name;
 		rr.version = rtd.version;
 		rr.load_function = rtd.load;
-		rr.allocator = &_resource_heap;
+		rr.allocator = rtd.allocator;
 		rr.data = NULL;
+		rr.priority = priority;
 
 		_loader->add_request(rr);
 		return;
@@ -100,37 +187,91 @@ void ResourceManager::load(StringId64 type, StringId64 name)
 	entry.references++;
 }
 
-void ResourceManager::unload(StringId64 type, StringId64 name)
+void ResourceManager::unload(StringId64 type, StringId64 name, ResourcePriority::Enum priority)
 {
-	flush();
+	complete_requests();
 
 	ResourcePair id = { type, name };
+
+	if (hash_map::has(_pending, id))
+	{
+		PendingEntry pe = hash_map::get(_pending, id, PendingEntry());
+		const ResourcePriority::Enum old_priority = most_urgent(pe);
+
+		if (pe.references[priority] != 0)
+			--pe.references[priority];
+		else
+			--pe.references[old_priority];
+
+		const ResourcePriority::Enum new_priority = most_urgent(pe);
+		if (new_priority == ResourcePriority::COUNT)
+		{
+			// If the request has already been started, its data will be
+			// discarded as soon as it completes.
+			hash_map::remove(_pending, id);
+			_loader->cancel_request(type, name);
+		}
+		else
+		{
+			hash_map::set(_pending, id, pe);
+			if (new_priority != old_priority)
+				_loader->set_priority(type, name, new_priority);
+		}
+		return;
+	}
+
 	ResourceEntry& entry = hash_map::get(_rm, id, ResourceEntry::NOT_FOUND);
+	CE_ASSERT(entry.references > 0 && !(entry == ResourceEntry::NOT_FOUND), "Resource not loaded");
 
 	if (--entry.references == 0)
 	{
-		on_offline(type, name);
-		on_unload(type, entry.data);
-
-		hash_map::remove(_rm, id);
+		if (_cache)
+		{
+			entry.last_used = _clock++;
+			trim();
+		}
+		else
+		{
+			destroy(type, name);
+		}
 	}
 }
 
+void ResourceManager::set_priority(StringId64 type, StringId64 name, ResourcePriority::Enum from, ResourcePriority::Enum to)
+{
+	ResourcePair id = { type, name };
+
+	PendingEntry pe = hash_map::get(_pending, id, PendingEntry());
+	if (pe.references[from] == 0)
+		return;
+
+	const ResourcePriority::Enum old_priority = most_urgent(pe);
+	--pe.references[from];
+	++pe.references[to];
+	hash_map::set(_pending, id, pe);
+
+	const ResourcePriority::Enum new_priority = most_urgent(pe);
+	if (new_priority != old_priority)
+		_loader->set_priority(type, name, new_priority);
+}
+
 void ResourceManager::reload(StringId64 type, StringId64 name)
 {
 	const ResourcePair id = { type, name };
 	const ResourceEntry& entry = hash_map::get(_rm, id, ResourceEntry::NOT_FOUND);
 	const u32 old_refs = entry.references;
+	const u32 last_used = entry.last_used;
 
 	if (entry == ResourceEntry::NOT_FOUND)
 		return;
 
-	unload(type, name);
+	destroy(type, name);
 	load(type, name);
 	flush();
 
 	ResourceEntry& new_entry = hash_map::get(_rm, id, ResourceEntry::NOT_FOUND);
 	new_entry.references = old_refs;
+	new_entry.last_used = last_used;
 }
 
 bool ResourceManager::can_get(StringId64 type, StringId64 name)
@@ -157,6 +298,12 @@ const void* ResourceManager::get(StringId64 type, StringId64 name)
 	return entry.data;
 }
 
+u32 ResourceManager::data_size(StringId64 type, StringId64 name)
+{
+	const ResourcePair id = { type, name };
+	return hash_map::get(_rm, id, ResourceEntry::NOT_FOUND).size;
+}
+
 void ResourceManager::enable_autoload(bool enable)
 {
 	_autoload = enable;
@@ -175,34 +322,253 @@ void ResourceManager::complete_requests()
 	_loader->get_loaded(loaded);
 
 	for (u32 i = 0; i < array::size(loaded); ++i)
-		complete_request(loaded[i].type, loaded[i].name, loaded[i].data);
+		complete_request(loaded[i]);
+
+	if (array::size(loaded) != 0)
+		trim();
 }
 
-void ResourceManager::complete_request(StringId64 type, StringId64 name, void* data)
+void ResourceManager::complete_request(const ResourceRequest& rr)
 {
-	ResourceEntry entry;
-	entry.references = 1;
-	entry.data = data;
-
+	const StringId64 type = rr.type;
+	const StringId64 name = rr.name;
 	ResourcePair id = { type, name };
 
+	const PendingEntry pe = hash_map::get(_pending, id, PendingEntry());
+	u32 references = 0;
+	for (u32 i = 0; i < ResourcePriority::COUNT; ++i)
+		references += pe.references[i];
+
+	// The resource has been unloaded before its request could be cancelled.
+	if (references == 0)
+	{
+		on_unload(type, rr.data);
+		return;
+	}
+
+	hash_map::remove(_pending, id);
+
+	ResourceEntry entry;
+	entry.references = references;
+	entry.data = rr.data;
+	entry.size = rr.size;
+	entry.mapped_size = rr.mapped_size;
+	entry.gpu_size = 0u;
+	entry.last_used = 0u;
+
 	hash_map::set(_rm, id, entry);
 
+	ResourceTypeData& rtd = type_data(type);
+	rtd.mapped_size += rr.mapped_size;
+
 	on_online(type, name);
 }
 
+void ResourceManager::destroy(StringId64 type, StringId64 name)
+{
+	const ResourcePair id = { type, name };
+
+	// Online functions set the GPU size, offline functions may clear it.
+	on_offline(type, name);
+
+	const ResourceEntry& entry = hash_map::get(_rm, id, ResourceEntry::NOT_FOUND);
+	ResourceTypeData& rtd = type_data(type);
+	rtd.mapped_size -= entry.mapped_size;
+	rtd.gpu_size -= entry.gpu_size;
+
+	on_unload(type, entry.data);
+	hash_map::remove(_rm, id);
+}
+
+ResourceManager::ResourceTypeData& ResourceManager::type_data(StringId64 type)
+{
+	CE_ASSERT(hash_map::has(_type_data, type), "Unknown resource type");
+	return hash_map::get(_type_data, type, ResourceTypeData());
+}
+
+bool ResourceManager::is_over_budget(const ResourceTypeData& rtd, u64 total)
+{
+	return is_over(type_memory(rtd), rtd.budget) || is_over(total, _budget);
+}
+
+void ResourceManager::trim()
+{
+	u64 total = 0u;
+	bool over_budget = false;
+
+	auto type_cur = hash_map::begin(_type_data);
+	auto type_end = hash_map::end(_type_data);
+	for (; type_cur != type_end; ++type_cur)
+	{
+		HASH_MAP_SKIP_HOLE(_type_data, type_cur);
+
+		const u64 memory = type_memory(type_cur->second);
+		total += memory;
+		over_budget = over_budget || is_over(memory, type_cur->second.budget);
+	}
+
+	if (!over_budget && !is_over(total, _budget))
+	{
+		_over_budget = false;
+		return;
+	}
+
+	struct CachedResource
+	{
+		ResourcePair id;
+		u32 last_used;
+	};
+
+	TempAllocator1024 ta;
+	Array<CachedResource> cached(ta);
+
+	auto cur = hash_map::begin(_rm);
+	auto end = hash_map::end(_rm);
+	for (; cur != end; ++cur)
+	{
+		HASH_MAP_SKIP_HOLE(_rm, cur);
+
+		if (cur->second.references != 0)
+			continue;
+
+		CachedResource cr;
+		cr.id = cur->first;
+		cr.last_used = cur->second.last_used;
+		array::push_back(cached, cr);
+	}
+
+	std::sort(array::begin(cached), array::end(cached), [](const CachedResource& a, const CachedResource& b)
+		{
+			return a.last_used < b.last_used;
+		});
+
+	over_budget = false;
+	for (u32 i = 0; i < array::size(cached); ++i)
+	{
+		ResourceTypeData& rtd = type_data(cached[i].id.type);
+		if (!is_over_budget(rtd, total))
+			continue;
+
+		const u64 memory = type_memory(rtd);
+		destroy(cached[i].id.type, cached[i].id.name);
+		total -= memory - type_memory(rtd);
+	}
+
+	type_cur = hash_map::begin(_type_data);
+	type_end = hash_map::end(_type_data);
+	for (; type_cur != type_end; ++type_cur)
+	{
+		HASH_MAP_SKIP_HOLE(_type_data, type_cur);
+
+		over_budget = over_budget || is_over_budget(type_cur->second, total);
+	}
+
+	if (over_budget && !_over_budget)
+		logw(RESOURCE_MANAGER, "Memory budget exceeded: resources use %.1f MiB", f64(total)/(1024.0*1024.0));
+
+	_over_budget = over_budget;
+}
+
 void ResourceManager::register_type(StringId64 type, u32 version, LoadFunction load, UnloadFunction unload, OnlineFunction online, OfflineFunction offline)
 {
+	CE_ASSERT(!hash_map::has(_type_data, type), "Type already registered");
+
 	ResourceTypeData rtd;
 	rtd.version = version;
 	rtd.load = load;
 	rtd.online = online;
 	rtd.offline = offline;
 	rtd.unload = unload;
+	rtd.allocator = CE_NEW(default_allocator(), TypeAllocator)(_resource_heap);
+	rtd.mapped_size = 0u;
+	rtd.gpu_size = 0u;
+	rtd.budget = 0u;
 
 	hash_map::set(_type_data, type, rtd);
 }
 
+void ResourceManager::enable_cache(bool enable)
+{
+	_cache = enable;
+	if (_cache)
+		return;
+
+	TempAllocator1024 ta;
+	Array<ResourcePair> cached(ta);
+
+	auto cur = hash_map::begin(_rm);
+	auto end = hash_map::end(_rm);
+	for (; cur != end; ++cur)
+	{
+		HASH_MAP_SKIP_HOLE(_rm, cur);
+
+		if (cur->second.references == 0)
+			array::push_back(cached, cur->first);
+	}
+
+	for (u32 i = 0; i < array::size(cached); ++i)
+		destroy(cached[i].type, cached[i].name);
+}
+
+void ResourceManager::set_budget(StringId64 type, u64 size)
+{
+	if (!hash_map::has(_type_data, type))
+	{
+		char buf[STRING_ID64_BUF_LEN];
+		logw(RESOURCE_MANAGER, "Unknown resource type: %s", type.to_string(buf, sizeof(buf)));
+		return;
+	}
+
+	type_data(type).budget = size;
+	trim();
+}
+
+void ResourceManager::set_total_budget(u64 size)
+{
+	_budget = size;
+	trim();
+}
+
+void ResourceManager::set_gpu_size(StringId64 type, StringId64 name, u32 size)
+{
+	const ResourcePair id = { type, name };
+	ResourceEntry& entry = hash_map::get(_rm, id, ResourceEntry::NOT_FOUND);
+	CE_ASSERT(!(entry == ResourceEntry::NOT_FOUND), "Resource not loaded");
+
+	ResourceTypeData& rtd = type_data(type);
+	rtd.gpu_size -= entry.gpu_size;
+	rtd.gpu_size += size;
+	entry.gpu_size = size;
+}
+
+void ResourceManager::memory(StringId64 type, u64* memory, u64* gpu_memory)
+{
+	ResourceTypeData deffault;
+	deffault.allocator = NULL;
+	deffault.mapped_size = 0u;
+	deffault.gpu_size = 0u;
+	const ResourceTypeData& rtd = hash_map::get(_type_data, type, deffault);
+
+	*memory = rtd.allocator != NULL ? rtd.allocator->total_allocated() + rtd.mapped_size : 0u;
+	*gpu_memory = rtd.gpu_size;
+}
+
+void ResourceManager::total_memory(u64* memory, u64* gpu_memory)
+{
+	*memory = 0u;
+	*gpu_memory = 0u;
+
+	auto cur = hash_map::begin(_type_data);
+	auto end = hash_map::end(_type_data);
+	for (; cur != end; ++cur)
+	{
+		HASH_MAP_SKIP_HOLE(_type_data, cur);
+
+		*memory += cur->second.allocator->total_allocated() + cur->second.mapped_size;
+		*gpu_memory += cur->second.gpu_size;
+	}
+}
+
 void ResourceManager::on_online(StringId64 type, StringId64 name)
 {
 	OnlineFunction func = hash_map::get(_type_data, type, ResourceTypeData()).online;
@@ -221,12 +587,12 @@ void ResourceManager::on_offline(StringId64 type, StringId64 name)
 
 void ResourceManager::on_unload(StringId64 type, void* data)
 {
-	UnloadFunction func = hash_map::get(_type_data, type, ResourceTypeData()).unload;
+	const ResourceTypeData& rtd = hash_map::get(_type_data, type, ResourceTypeData());
 
-	if (func)
-		func(_resource_heap, data);
-	else
-		_resource_heap.deallocate(data);
+	if (rtd.unload)
+		rtd.unload(*rtd.allocator, data);
+	else if (!_loader->unmap(data))
+		rtd.allocator->deallocate(data);
 }
 
 } // namespace crown
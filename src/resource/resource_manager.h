@@ -13,11 +13,17 @@
 #include "resource/types.h"
 #include "core/json/types.h"
 #include "device/console_server.h"
+#include <atomic>
 
 namespace crown
 {
 /// Keeps track and manages resources loaded by ResourceLoader.
 ///
+/// The memory used by the resources of each type is accounted separately and
+/// can be limited by a budget. When the cache is enabled, resources are kept
+/// loaded after their last reference is released and evicted in
+/// least-recently-used order whenever any budget is exceeded.
+///
 /// @ingroup Resource
 struct ResourceManager
 {
@@ -36,10 +42,36 @@ struct ResourceManager
 	{
 		u32 references;
 		void* data;
+		u32 size;        ///< Size in bytes of the data read by the loader.
+		u32 mapped_size; ///< Size in bytes of data if it is mapped from disk.
+		u32 gpu_size;    ///< Size in bytes of the GPU memory used by the resource.
+		u32 last_used;   ///< Value of _clock when the last reference was released.
 
 		static const ResourceEntry NOT_FOUND;
 	};
 
+	/// Counts the bytes allocated by the resources of a type.
+	struct TypeAllocator : public Allocator
+	{
+		Allocator& _allocator;
+		std::atomic<u32> _allocated;
+
+		///
+		explicit TypeAllocator(Allocator& a);
+
+		/// @copydoc Allocator::allocate()
+		void* allocate(u32 size, u32 align = Allocator::DEFAULT_ALIGN);
+
+		/// @copydoc Allocator::deallocate()
+		void deallocate(void* data);
+
+		/// @copydoc Allocator::allocated_size()
+		u32 allocated_size(const void* ptr) { return _allocator.allocated_size(ptr); }
+
+		/// @copydoc Allocator::total_allocated()
+		u32 total_allocated() { return _allocated; }
+	};
+
 	struct ResourceTypeData
 	{
 		u32 version;
@@ -47,21 +79,44 @@ struct ResourceManager
 		OnlineFunction online;
 		OfflineFunction offline;
 		UnloadFunction unload;
+		TypeAllocator* allocator;
+		u64 mapped_size; ///< Size in bytes of the data mapped from disk.
+		u64 gpu_size;    ///< Size in bytes of the GPU memory used.
+		u64 budget;      ///< Maximum size in bytes of all the memory used, or 0.
+	};
+
+	/// Resource requested to the loader but not completed yet.
+	struct PendingEntry
+	{
+		u32 references[ResourcePriority::COUNT]; ///< References per priority.
 	};
 
 	typedef HashMap<StringId64, ResourceTypeData> TypeMap;
 	typedef HashMap<ResourcePair, ResourceEntry> ResourceMap;
+	typedef HashMap<ResourcePair, PendingEntry> PendingMap;
 
 	ProxyAllocator _resource_heap;
 	ResourceLoader* _loader;
 	TypeMap _type_data;
 	ResourceMap _rm;
+	PendingMap _pending;
 	bool _autoload;
+	bool _cache;
+	u64 _budget;
+	u32 _clock;
+	bool _over_budget;
 
 	void on_online(StringId64 type, StringId64 name);
 	void on_offline(StringId64 type, StringId64 name);
 	void on_unload(StringId64 type, void* data);
-	void complete_request(StringId64 type, StringId64 name, void* data);
+	void complete_request(const ResourceRequest& rr);
+	void destroy(StringId64 type, StringId64 name);
+	ResourceTypeData& type_data(StringId64 type);
+	bool is_over_budget(const ResourceTypeData& rtd, u64 total);
+
+	/// Evicts cached resources, least recently used first, until all the
+	/// budgets are met or the cache is empty.
+	void trim();
 
 	/// Uses @a rl to load resources.
 	ResourceManager(ResourceLoader& rl);
@@ -69,12 +124,20 @@ struct ResourceManager
 	///
 	~ResourceManager();
 
-	/// Loads the resource (@a type, @a name).
+	/// Loads the resource (@a type, @a name) with the given @a priority.
 	/// You can check whether the resource is available with can_get().
-	void load(StringId64 type, StringId64 name);
+	void load(StringId64 type, StringId64 name, ResourcePriority::Enum priority = ResourcePriority::NORMAL);
+
+	/// Unloads the resource @a type @a name previously loaded with the given
+	/// @a priority. If the resource is still being loaded and nobody else
+	/// requested it, its request is cancelled. When the cache is enabled,
+	/// the last unload() keeps the resource in the cache.
+	void unload(StringId64 type, StringId64 name, ResourcePriority::Enum priority = ResourcePriority::NORMAL);
 
-	/// Unloads the resource @a type @a name.
-	void unload(StringId64 type, StringId64 name);
+	/// Changes the priority of one request for the resource (@a type, @a name)
+	/// from @a from to @a to. Does nothing if the resource has already been
+	/// loaded.
+	void set_priority(StringId64 type, StringId64 name, ResourcePriority::Enum from, ResourcePriority::Enum to);
 
 	/// Reloads the resource (@a type, @a name).
 	/// @note The user has to manually update all the references to the old resource.
@@ -86,6 +149,10 @@ struct ResourceManager
 	/// Returns the data of the resource (@a type, @a name).
 	const void* get(StringId64 type, StringId64 name);
 
+	/// Returns the size in bytes of the data read from disk for the resource
+	/// (@a type, @a name), or 0 if the resource is not loaded.
+	u32 data_size(StringId64 type, StringId64 name);
+
 	/// Sets whether resources should be automatically loaded when accessed.
 	void enable_autoload(bool enable);
 
@@ -93,10 +160,36 @@ struct ResourceManager
 	void flush();
 
 	/// Completes all load() requests which have been loaded by ResourceLoader.
+	/// Never blocks.
 	void complete_requests();
 
 	/// Registers a new resource @a type into the resource manager.
 	void register_type(StringId64 type, u32 version, LoadFunction load, UnloadFunction unload, OnlineFunction online, OfflineFunction offline);
+
+	/// Sets whether resources should be kept loaded after their last
+	/// reference is released, so that loading them again is free.
+	/// Disabling the cache evicts all the cached resources.
+	void enable_cache(bool enable);
+
+	/// Sets the maximum @a size in bytes of the memory, including GPU
+	/// memory, used by the resources of the given @a type. 0 means no limit.
+	void set_budget(StringId64 type, u64 size);
+
+	/// Sets the maximum @a size in bytes of the memory, including GPU
+	/// memory, used by all the resources. 0 means no limit.
+	void set_total_budget(u64 size);
+
+	/// Sets the @a size in bytes of the GPU memory used by the resource
+	/// (@a type, @a name). Called by online functions.
+	void set_gpu_size(StringId64 type, StringId64 name, u32 size);
+
+	/// Returns the size in bytes of the @a memory and of the @a gpu_memory
+	/// used by the resources of the given @a type, cached ones included.
+	void memory(StringId64 type, u64* memory, u64* gpu_memory);
+
+	/// Returns the size in bytes of the @a memory and of the @a gpu_memory
+	/// used by all the resources, cached ones included.
+	void total_memory(u64* memory, u64* gpu_memory);
 };
 
 } // namespace crown
@@ -5,6 +5,7 @@
 
 #include "core/containers/array.inl"
 #include "resource/package_resource.h"
+#include "resource/resource_loader.h"
 #include "resource/resource_manager.h"
 #include "resource/resource_package.h"
 #include "world/types.h"
@@ -16,49 +17,159 @@ ResourcePackage::ResourcePackage(StringId64 id, ResourceManager& resman)
 	, _resource_manager(&resman)
 	, _package_id(id)
 	, _package(NULL)
+	, _priority(ResourcePriority::NORMAL)
+	, _state(State::UNLOADED)
+	, _package_requested(false)
+	, _num_loaded(0)
+	, _loaded_size(0)
+	, _loaded_function(NULL)
+	, _loaded_user_data(NULL)
 {
+	_node.next = NULL;
+	_node.prev = NULL;
 }
 
 ResourcePackage::~ResourcePackage()
 {
-	_resource_manager->unload(RESOURCE_TYPE_PACKAGE, _package_id);
+	if (_package_requested)
+		_resource_manager->unload(RESOURCE_TYPE_PACKAGE, _package_id, _priority);
 	_marker = 0;
 }
 
-void ResourcePackage::load()
+void ResourcePackage::load(LoadedFunction function, void* user_data)
 {
-	_resource_manager->load(RESOURCE_TYPE_PACKAGE, _package_id);
-	_resource_manager->flush();
-	_package = (const PackageResource*)_resource_manager->get(RESOURCE_TYPE_PACKAGE, _package_id);
+	if (_state != State::UNLOADED)
+		return;
 
-	for (u32 i = 0; i < array::size(_package->resources); ++i)
+	_loaded_function = function;
+	_loaded_user_data = user_data;
+	_num_loaded = 0;
+	_loaded_size = 0;
+	_state = State::LOADING_PACKAGE;
+
+	if (!_package_requested)
 	{
-		_resource_manager->load(_package->resources[i].type, _package->resources[i].name);
+		_resource_manager->load(RESOURCE_TYPE_PACKAGE, _package_id, _priority);
+		_package_requested = true;
 	}
+
+	update();
 }
 
 void ResourcePackage::unload()
 {
-	for (u32 i = 0; i < array::size(_package->resources); ++i)
+	if (_state == State::LOADING_RESOURCES || _state == State::LOADED)
 	{
-		_resource_manager->unload(_package->resources[i].type, _package->resources[i].name);
+		for (u32 i = 0; i < array::size(_package->resources); ++i)
+		{
+			_resource_manager->unload(_package->resources[i].type, _package->resources[i].name, _priority);
+		}
+
+		_resource_manager->_loader->unmount_bundle(_package_id);
 	}
+
+	_loaded_function = NULL;
+	_loaded_user_data = NULL;
+	_state = State::UNLOADED;
 }
 
-void ResourcePackage::flush()
+void ResourcePackage::set_priority(ResourcePriority::Enum priority)
 {
-	_resource_manager->flush();
+	if (_package_requested)
+		_resource_manager->set_priority(RESOURCE_TYPE_PACKAGE, _package_id, _priority, priority);
+
+	if (_state == State::LOADING_RESOURCES || _state == State::LOADED)
+	{
+		for (u32 i = 0; i < array::size(_package->resources); ++i)
+		{
+			_resource_manager->set_priority(_package->resources[i].type
+				, _package->resources[i].name
+				, _priority
+				, priority
+				);
+		}
+	}
+
+	_priority = priority;
 }
 
-bool ResourcePackage::has_loaded() const
+void ResourcePackage::update()
 {
-	for (u32 i = 0; i < array::size(_package->resources); ++i)
+	if (advance())
+		call_loaded_function();
+}
+
+bool ResourcePackage::advance()
+{
+	if (_state == State::LOADING_PACKAGE)
 	{
-		if (!_resource_manager->can_get(_package->resources[i].type, _package->resources[i].name))
+		if (!_resource_manager->can_get(RESOURCE_TYPE_PACKAGE, _package_id))
 			return false;
+
+		_package = (const PackageResource*)_resource_manager->get(RESOURCE_TYPE_PACKAGE, _package_id);
+
+		_resource_manager->_loader->mount_bundle(_package_id);
+
+		for (u32 i = 0; i < array::size(_package->resources); ++i)
+		{
+			_resource_manager->load(_package->resources[i].type, _package->resources[i].name, _priority);
+		}
+
+		_state = State::LOADING_RESOURCES;
+	}
+
+	if (_state == State::LOADING_RESOURCES)
+	{
+		// Resources are requested, and thus mostly completed, in order.
+		const u32 num = array::size(_package->resources);
+		for (; _num_loaded < num; ++_num_loaded)
+		{
+			const StringId64 type = _package->resources[_num_loaded].type;
+			const StringId64 name = _package->resources[_num_loaded].name;
+			if (!_resource_manager->can_get(type, name))
+				return false;
+
+			_loaded_size += _resource_manager->data_size(type, name);
+		}
+
+		_state = State::LOADED;
+		return true;
 	}
 
-	return true;
+	return false;
+}
+
+void ResourcePackage::call_loaded_function()
+{
+	// The function may destroy the package.
+	LoadedFunction function = _loaded_function;
+	_loaded_function = NULL;
+	if (function != NULL)
+		function(*this, _loaded_user_data);
+}
+
+void ResourcePackage::flush()
+{
+	while (_state == State::LOADING_PACKAGE || _state == State::LOADING_RESOURCES)
+	{
+		_resource_manager->flush();
+		update();
+	}
+}
+
+bool ResourcePackage::has_loaded() const
+{
+	return _state == State::LOADED;
+}
+
+void ResourcePackage::progress(u32* num_loaded, u32* num_resources, u32* loaded_size) const
+{
+	*num_loaded = _num_loaded;
+	*num_resources = _state == State::LOADING_RESOURCES || _state == State::LOADED
+		? array::size(_package->resources)
+		: 0
+		;
+	*loaded_size = _loaded_size;
 }
 
 } // namespace crown
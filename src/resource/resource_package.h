@@ -5,6 +5,7 @@
 
 #pragma once
 
+#include "core/list.h"
 #include "core/strings/string_id.h"
 #include "core/types.h"
 #include "resource/types.h"
@@ -14,10 +15,33 @@ namespace crown
 /// Collection of resources to load in a batch.
 struct ResourcePackage
 {
+	/// Enumerates the states of a package.
+	struct State
+	{
+		enum Enum
+		{
+			UNLOADED,
+			LOADING_PACKAGE,   ///< Waiting for the list of resources in the package.
+			LOADING_RESOURCES, ///< Waiting for the resources in the package.
+			LOADED
+		};
+	};
+
+	/// Called when all the resources in the @a package have been loaded.
+	typedef void (*LoadedFunction)(ResourcePackage& package, void* user_data);
+
 	u32 _marker;
 	ResourceManager* _resource_manager;
 	StringId64 _package_id;
 	const PackageResource* _package;
+	ResourcePriority::Enum _priority;
+	State::Enum _state;
+	bool _package_requested;
+	u32 _num_loaded;  ///< Number of resources in the package loaded so far.
+	u32 _loaded_size; ///< Size in bytes of the resources loaded so far.
+	LoadedFunction _loaded_function;
+	void* _loaded_user_data;
+	ListNode _node;
 
 	///
 	ResourcePackage(StringId64 id, ResourceManager& resman);
@@ -25,20 +49,46 @@ struct ResourcePackage
 	///
 	~ResourcePackage();
 
-	/// Loads all the resources in the package.
+	/// Loads all the resources in the package and calls @a function, if not
+	/// NULL, once they are all available.
 	/// @note
 	/// The resources are not immediately available after the call is made,
-	/// instead, you have to poll for completion with has_loaded()
-	void load();
+	/// instead, you have to poll for completion with has_loaded() or wait for
+	/// @a function to be called by update().
+	void load(LoadedFunction function = NULL, void* user_data = NULL);
 
 	/// Unloads all the resources in the package.
+	/// Resources that are still being loaded are cancelled.
 	void unload();
 
+	/// Sets the @a priority of the package's resources. Resources that are
+	/// still being loaded are reprioritized immediately.
+	void set_priority(ResourcePriority::Enum priority);
+
+	/// Advances the loading of the package and calls its LoadedFunction
+	/// once it has been loaded. Never blocks.
+	void update();
+
+	/// Advances the loading of the package without calling its
+	/// LoadedFunction. Returns true if the package has just been loaded, in
+	/// which case call_loaded_function() must be called. Never blocks.
+	bool advance();
+
+	/// Calls the LoadedFunction passed to load(), if any.
+	void call_loaded_function();
+
 	/// Waits until the package has been loaded.
 	void flush();
 
 	/// Returns whether the package has been loaded.
 	bool has_loaded() const;
+
+	/// Returns the number of resources in the package loaded so far in
+	/// @a num_loaded, the total number of resources in the package in
+	/// @a num_resources and the size in bytes of the resources loaded so far
+	/// in @a loaded_size. The total is 0 until the list of resources in the
+	/// package is available.
+	void progress(u32* num_loaded, u32* num_resources, u32* loaded_size) const;
 };
 
 } // namespace crown
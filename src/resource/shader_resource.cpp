@@ -617,6 +617,7 @@ namespace shader_resource_internal
 		DynamicString _fs_code;
 		DynamicString _varying;
 		DynamicString _vs_input_output;
+		DynamicString _vs_input_output_instanced;
 		DynamicString _fs_input_output;
 		HashMap<DynamicString, DynamicString> _samplers;
 
@@ -627,6 +628,7 @@ namespace shader_resource_internal
 			, _fs_code(a)
 			, _varying(a)
 			, _vs_input_output(a)
+			, _vs_input_output_instanced(a)
 			, _fs_input_output(a)
 			, _samplers(a)
 		{
@@ -675,6 +677,8 @@ namespace shader_resource_internal
 		DynamicString _varying_path;
 		DynamicString _vs_out_path;
 		DynamicString _fs_out_path;
+		DynamicString _vs_instanced_src_path;
+		DynamicString _vs_instanced_out_path;
 
 		explicit ShaderCompiler(CompileOptions& opts)
 			: _opts(opts)
@@ -688,12 +692,16 @@ namespace shader_resource_internal
 			, _varying_path(default_allocator())
 			, _vs_out_path(default_allocator())
 			, _fs_out_path(default_allocator())
+			, _vs_instanced_src_path(default_allocator())
+			, _vs_instanced_out_path(default_allocator())
 		{
 			_opts.temporary_path(_vs_src_path, "vs_src.sc");
 			_opts.temporary_path(_fs_src_path, "fs_src.sc");
 			_opts.temporary_path(_varying_path, "varying.sc");
 			_opts.temporary_path(_vs_out_path, "vs_out.bin");
 			_opts.temporary_path(_fs_out_path, "fs_out.bin");
+			_opts.temporary_path(_vs_instanced_src_path, "vs_instanced_src.sc");
+			_opts.temporary_path(_vs_instanced_out_path, "vs_instanced_out.bin");
 		}
 
 		s32 parse(const char* path)
@@ -1003,6 +1011,8 @@ namespace shader_resource_internal
 					sjson::parse_verbatim(bgfxshader._varying, shader["varying"]);
 				if (json_object::has(shader, "vs_input_output"))
 					sjson::parse_verbatim(bgfxshader._vs_input_output, shader["vs_input_output"]);
+				if (json_object::has(shader, "vs_input_output_instanced"))
+					sjson::parse_verbatim(bgfxshader._vs_input_output_instanced, shader["vs_input_output_instanced"]);
 				if (json_object::has(shader, "fs_input_output"))
 					sjson::parse_verbatim(bgfxshader._fs_input_output, shader["fs_input_output"]);
 				if (json_object::has(shader, "samplers"))
@@ -1129,6 +1139,8 @@ namespace shader_resource_internal
 			_opts.delete_file(_varying_path.c_str());
 			_opts.delete_file(_vs_out_path.c_str());
 			_opts.delete_file(_fs_out_path.c_str());
+			_opts.delete_file(_vs_instanced_src_path.c_str());
+			_opts.delete_file(_vs_instanced_out_path.c_str());
 		}
 
 		s32 compile()
@@ -1247,9 +1259,30 @@ namespace shader_resource_internal
 			fs_code << shader._code.c_str();
 			fs_code << shader._fs_code.c_str();
 
+			// Shaders declaring instanced inputs get an additional vertex
+			// shader, compiled with INSTANCED defined, that reads the
+			// model matrix from the instance data stream.
+			const bool instanced = !(shader._vs_input_output_instanced == "");
+
+			StringStream vs_instanced_code(default_allocator());
+			if (instanced)
+			{
+				vs_instanced_code << shader._vs_input_output_instanced.c_str();
+				vs_instanced_code << "#define INSTANCED\n";
+				for (u32 i = 0; i < vector::size(defines); ++i)
+				{
+					vs_instanced_code << "#define " << defines[i].c_str() << "\n";
+				}
+				vs_instanced_code << included_code.c_str();
+				vs_instanced_code << shader._code.c_str();
+				vs_instanced_code << shader._vs_code.c_str();
+			}
+
 			_opts.write_temporary(_vs_src_path.c_str(), vs_code);
 			_opts.write_temporary(_fs_src_path.c_str(), fs_code);
 			_opts.write_temporary(_varying_path.c_str(), shader._varying.c_str(), shader._varying.length());
+			if (instanced)
+				_opts.write_temporary(_vs_instanced_src_path.c_str(), vs_instanced_code);
 
 			const char* shaderc = _opts.exe_path(shaderc_paths, countof(shaderc_paths));
 			DATA_COMPILER_ASSERT(shaderc != NULL, _opts, "shaderc not found");
@@ -1295,17 +1328,44 @@ namespace shader_resource_internal
 					);
 			}
 
+			Process pr_vert_instanced;
+			if (instanced)
+			{
+				sc = run_external_compiler(pr_vert_instanced
+					, shaderc
+					, _vs_instanced_src_path.c_str()
+					, _vs_instanced_out_path.c_str()
+					, _varying_path.c_str()
+					, "vertex"
+					, _opts.platform()
+					);
+				if (sc != 0)
+				{
+					pr_vert.wait();
+					pr_frag.wait();
+					delete_temp_files();
+					DATA_COMPILER_ASSERT(sc == 0
+						, _opts
+						, "Failed to spawn `%s`"
+						, shaderc
+						);
+				}
+			}
+
 			// Check shaderc exit code
 			s32 ec;
 			TempAllocator4096 ta;
 			StringStream output_vert(ta);
 			StringStream output_frag(ta);
+			StringStream output_vert_instanced(ta);
 
 			_opts.read_output(output_vert, pr_vert);
 			ec = pr_vert.wait();
 			if (ec != 0)
 			{
 				pr_frag.wait();
+				if (instanced)
+					pr_vert_instanced.wait();
 				delete_temp_files();
 				DATA_COMPILER_ASSERT(false
 					, _opts
@@ -1319,6 +1379,8 @@ namespace shader_resource_internal
 			ec = pr_frag.wait();
 			if (ec != 0)
 			{
+				if (instanced)
+					pr_vert_instanced.wait();
 				delete_temp_files();
 				DATA_COMPILER_ASSERT(false
 					, _opts
@@ -1328,8 +1390,27 @@ namespace shader_resource_internal
 					);
 			}
 
+			if (instanced)
+			{
+				_opts.read_output(output_vert_instanced, pr_vert_instanced);
+				ec = pr_vert_instanced.wait();
+				if (ec != 0)
+				{
+					delete_temp_files();
+					DATA_COMPILER_ASSERT(false
+						, _opts
+						, "Failed to compile instanced vertex shader `%s`:\n%s"
+						, bgfx_shader
+						, string_stream::c_str(output_vert_instanced)
+						);
+				}
+			}
+
 			Buffer vs_data = _opts.read_temporary(_vs_out_path.c_str());
 			Buffer fs_data = _opts.read_temporary(_fs_out_path.c_str());
+			Buffer vs_instanced_data(default_allocator());
+			if (instanced)
+				vs_instanced_data = _opts.read_temporary(_vs_instanced_out_path.c_str());
 			delete_temp_files();
 
 			// Write
@@ -1337,6 +1418,8 @@ namespace shader_resource_internal
 			_opts.write(vs_data);
 			_opts.write(array::size(fs_data));
 			_opts.write(fs_data);
+			_opts.write(array::size(vs_instanced_data));
+			_opts.write(vs_instanced_data);
 
 			return 0;
 		}
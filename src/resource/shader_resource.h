@@ -36,6 +36,7 @@ struct ShaderResource
 		Sampler samplers[4];
 		const bgfx::Memory* vsmem;
 		const bgfx::Memory* fsmem;
+		const bgfx::Memory* vsmem_instanced; // NULL if the shader has no instanced variant.
 	};
 
 	Array<Data> _data;
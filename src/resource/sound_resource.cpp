@@ -13,6 +13,10 @@
 #include "core/strings/dynamic_string.inl"
 #include "resource/compile_options.inl"
 #include "resource/sound_resource.h"
+#define STB_VORBIS_HEADER_ONLY
+#define STB_VORBIS_NO_STDIO
+#define STB_VORBIS_NO_PUSHDATA_API
+#include <stb_vorbis.c>
 
 namespace crown
 {
@@ -56,21 +60,87 @@ namespace sound_resource_internal
 		DynamicString name(ta);
 		sjson::parse_string(name, obj["source"]);
 
+		const bool stream = json_object::has(obj, "stream")
+			? sjson::parse_bool(obj["stream"])
+			: false
+			;
+
 		Buffer sound = opts.read(name.c_str());
-		const WAVHeader* wav = (const WAVHeader*)array::begin(sound);
-		const char* wavdata = (const char*)&wav[1];
+		Buffer pcm(default_allocator());
+		const char* data;
 
-		// Write
 		SoundResource sr;
-		sr.version      = RESOURCE_HEADER(RESOURCE_VERSION_SOUND);
-		sr.size         = wav->data_size;
-		sr.sample_rate  = wav->fmt_sample_rate;
-		sr.avg_bytes_ps = wav->fmt_avarage;
-		sr.channels     = wav->fmt_channels;
-		sr.block_size   = wav->fmt_block_align;
-		sr.bits_ps      = wav->fmt_bits_ps;
-		sr.sound_type   = SoundType::WAV;
+		sr.version = RESOURCE_HEADER(RESOURCE_VERSION_SOUND);
+		sr.stream  = stream;
+
+		if (name.has_suffix(".ogg"))
+		{
+			int error;
+			stb_vorbis* vorbis = stb_vorbis_open_memory((const unsigned char*)array::begin(sound)
+				, array::size(sound)
+				, &error
+				, NULL
+				);
+			DATA_COMPILER_ASSERT(vorbis != NULL
+				, opts
+				, "Invalid Ogg Vorbis file: '%s'"
+				, name.c_str()
+				);
+
+			const stb_vorbis_info info = stb_vorbis_get_info(vorbis);
+			sr.sample_rate  = info.sample_rate;
+			sr.channels     = info.channels;
+			sr.bits_ps      = 16;
+			sr.block_size   = u16(info.channels*sizeof(s16));
+			sr.avg_bytes_ps = sr.sample_rate*sr.block_size;
+
+			if (stream)
+			{
+				// Decoded while playing.
+				sr.size        = array::size(sound);
+				sr.sound_type  = SoundType::OGG;
+				sr.num_samples = stb_vorbis_stream_length_in_samples(vorbis);
+				data = array::begin(sound);
+			}
+			else
+			{
+				const u32 num_samples = stb_vorbis_stream_length_in_samples(vorbis);
+				array::resize(pcm, num_samples*sr.block_size);
+				const s32 num_decoded = stb_vorbis_get_samples_short_interleaved(vorbis
+					, info.channels
+					, (short*)array::begin(pcm)
+					, num_samples*info.channels
+					);
 
+				sr.size        = num_decoded*sr.block_size;
+				sr.sound_type  = SoundType::WAV;
+				sr.num_samples = num_decoded;
+				data = array::begin(pcm);
+			}
+
+			stb_vorbis_close(vorbis);
+		}
+		else
+		{
+			const WAVHeader* wav = (const WAVHeader*)array::begin(sound);
+			sr.size         = wav->data_size;
+			sr.sample_rate  = wav->fmt_sample_rate;
+			sr.avg_bytes_ps = wav->fmt_avarage;
+			sr.channels     = wav->fmt_channels;
+			sr.block_size   = wav->fmt_block_align;
+			sr.bits_ps      = wav->fmt_bits_ps;
+			sr.sound_type   = SoundType::WAV;
+			sr.num_samples  = sr.size / sr.block_size;
+			data = (const char*)&wav[1];
+		}
+
+		DATA_COMPILER_ASSERT(sr.channels == 1 || sr.channels == 2
+			, opts
+			, "Unsupported number of channels: %u"
+			, sr.channels
+			);
+
+		// Write
 		opts.write(sr.version);
 		opts.write(sr.size);
 		opts.write(sr.sample_rate);
@@ -79,8 +149,10 @@ namespace sound_resource_internal
 		opts.write(sr.block_size);
 		opts.write(sr.bits_ps);
 		opts.write(sr.sound_type);
+		opts.write(sr.stream);
+		opts.write(sr.num_samples);
 
-		opts.write(wavdata, wav->data_size);
+		opts.write(data, sr.size);
 
 		return 0;
 	}
@@ -18,8 +18,8 @@ struct SoundType
 {
 	enum Enum
 	{
-		WAV,
-		OGG
+		WAV, ///< PCM data.
+		OGG  ///< Ogg Vorbis stream.
 	};
 };
 
@@ -33,11 +33,15 @@ struct SoundResource
 	u16 block_size;
 	u16 bits_ps;
 	u32 sound_type;
+	u32 stream;      ///< Whether the sound is decoded while it plays instead of being loaded in a buffer.
+	u32 num_samples; ///< Length of the sound in samples per channel.
 };
 
 namespace sound_resource_internal
 {
 	s32 compile(CompileOptions& opts);
+	void online(StringId64 id, ResourceManager& rm);
+	void offline(StringId64 id, ResourceManager& rm);
 
 } // namespace	sound_resource_internal
 
@@ -0,0 +1,11 @@
+/*
+ * Copyright (c) 2012-2021 Daniele Bartolini et al.
+ * License: https://github.com/dbartolini/crown/blob/master/LICENSE
+ */
+
+// Implementation of the Vorbis decoder used by the sound compiler and by the
+// streaming sounds. Other files include stb_vorbis.c with
+// STB_VORBIS_HEADER_ONLY.
+#define STB_VORBIS_NO_STDIO
+#define STB_VORBIS_NO_PUSHDATA_API
+#include <stb_vorbis.c>
@@ -44,7 +44,10 @@ namespace texture_resource_internal
 	void online(StringId64 id, ResourceManager& rm)
 	{
 		TextureResource* tr = (TextureResource*)rm.get(RESOURCE_TYPE_TEXTURE, id);
-		tr->handle = bgfx::createTexture(tr->mem);
+
+		bgfx::TextureInfo info;
+		tr->handle = bgfx::createTexture(tr->mem, BGFX_TEXTURE_NONE|BGFX_SAMPLER_NONE, 0, &info);
+		rm.set_gpu_size(RESOURCE_TYPE_TEXTURE, id, info.storageSize);
 	}
 
 	void offline(StringId64 id, ResourceManager& rm)
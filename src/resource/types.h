@@ -15,6 +15,7 @@ struct DataCompiler;
 struct ResourceLoader;
 struct ResourceManager;
 struct ResourcePackage;
+struct ResourceRequest;
 
 struct ActorResource;
 struct StateMachineResource;
@@ -35,6 +36,21 @@ struct SpriteResource;
 struct TextureResource;
 struct UnitResource;
 
+/// Enumerates the priorities of resource requests.
+///
+/// @ingroup Resource
+struct ResourcePriority
+{
+	enum Enum
+	{
+		HIGH,   ///< E.g. boot and UI resources.
+		NORMAL, ///< E.g. gameplay resources.
+		LOW,    ///< E.g. prefetched resources.
+
+		COUNT
+	};
+};
+
 } // namespace crown
 
 /// @addtogroup Resource
@@ -60,15 +76,15 @@ struct UnitResource;
 #define RESOURCE_VERSION_STATE_MACHINE    RESOURCE_VERSION(3)
 #define RESOURCE_VERSION_CONFIG           RESOURCE_VERSION(1)
 #define RESOURCE_VERSION_FONT             RESOURCE_VERSION(1)
-#define RESOURCE_VERSION_UNIT             RESOURCE_VERSION(8)
+#define RESOURCE_VERSION_UNIT             RESOURCE_VERSION(11)
 #define RESOURCE_VERSION_LEVEL            (RESOURCE_VERSION_UNIT + 4) //!< Level embeds UnitResource
 #define RESOURCE_VERSION_MATERIAL         RESOURCE_VERSION(2)
-#define RESOURCE_VERSION_MESH             RESOURCE_VERSION(4)
+#define RESOURCE_VERSION_MESH             RESOURCE_VERSION(6)
 #define RESOURCE_VERSION_PACKAGE          RESOURCE_VERSION(5)
-#define RESOURCE_VERSION_PHYSICS_CONFIG   RESOURCE_VERSION(1)
+#define RESOURCE_VERSION_PHYSICS_CONFIG   RESOURCE_VERSION(2)
 #define RESOURCE_VERSION_SCRIPT           RESOURCE_VERSION(2)
-#define RESOURCE_VERSION_SHADER           RESOURCE_VERSION(7)
-#define RESOURCE_VERSION_SOUND            RESOURCE_VERSION(1)
+#define RESOURCE_VERSION_SHADER           RESOURCE_VERSION(8)
+#define RESOURCE_VERSION_SOUND            RESOURCE_VERSION(3)
 #define RESOURCE_VERSION_SPRITE_ANIMATION RESOURCE_VERSION(1)
 #define RESOURCE_VERSION_SPRITE           RESOURCE_VERSION(2)
 #define RESOURCE_VERSION_TEXTURE          RESOURCE_VERSION(5)
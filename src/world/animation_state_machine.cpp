@@ -8,6 +8,8 @@
 #include "core/containers/types.h"
 #include "core/memory/globals.h"
 #include "core/strings/string_id.inl"
+#include "core/thread/job_system.h"
+#include "device/profiler.h"
 #include "resource/expression_language.h"
 #include "resource/resource_manager.h"
 #include "resource/sprite_resource.h"
@@ -67,6 +69,8 @@ StateMachineInstance AnimationStateMachine::create(UnitId unit, const AnimationS
 	anim.state_next    = NULL;
 	anim.state_machine = smr;
 	anim.variables     = (f32*)default_allocator().allocate(sizeof(*anim.variables)*smr->num_variables);
+	anim.name          = StringId64();
+	anim.speed         = 1.0f;
 
 	memcpy(anim.variables, state_machine::variables(smr), sizeof(*anim.variables)*smr->num_variables);
 
@@ -139,14 +143,19 @@ void AnimationStateMachine::trigger(StateMachineInstance state_machine, StringId
 		CE_FATAL("Unknown transition mode");
 }
 
-void AnimationStateMachine::update(float dt)
+/// Evaluates the weights and the speed of the animations in [begin; end).
+static void evaluate_animations(u32 begin, u32 end, void* user_data)
 {
+	ENTER_PROFILE_SCOPE("animation_state_machine.evaluate");
+
+	AnimationStateMachine::Animation* animations = (AnimationStateMachine::Animation*)user_data;
+
 	f32 stack_data[32];
 	skinny::expression_language::Stack stack(stack_data, countof(stack_data));
 
-	for (u32 ii = 0; ii < array::size(_animations); ++ii)
+	for (u32 ii = begin; ii < end; ++ii)
 	{
-		Animation& anim_i = _animations[ii];
+		AnimationStateMachine::Animation& anim_i = animations[ii];
 
 		const f32* variables = anim_i.variables;
 		const u32* byte_code = state_machine::byte_code(anim_i.state_machine);
@@ -154,7 +163,6 @@ void AnimationStateMachine::update(float dt)
 		// Evaluate animation weights
 		f32 max_v = 0.0f;
 		u32 max_i = UINT32_MAX;
-		StringId64 name;
 
 		const AnimationArray* aa = state_machine::state_animations(anim_i.state);
 		for (u32 jj = 0; jj < aa->num; ++jj)
@@ -168,14 +176,34 @@ void AnimationStateMachine::update(float dt)
 			{
 				max_v = cur;
 				max_i = jj;
-				name = animation->name;
+				anim_i.name = animation->name;
 			}
 		}
 
 		// Evaluate animation speed
 		stack.size = 0;
 		skinny::expression_language::run(&byte_code[anim_i.state->speed_bytecode], variables, stack);
-		const f32 speed = stack.size > 0 ? stack_data[stack.size-1] : 1.0f;
+		anim_i.speed = stack.size > 0 ? stack_data[stack.size-1] : 1.0f;
+	}
+
+	LEAVE_PROFILE_SCOPE();
+}
+
+void AnimationStateMachine::update(float dt)
+{
+	// Evaluating the state machines' expressions is the expensive part and
+	// it does not touch any shared state.
+	job_system::parallel_for(array::size(_animations)
+		, 64
+		, evaluate_animations
+		, array::begin(_animations)
+		);
+
+	for (u32 ii = 0; ii < array::size(_animations); ++ii)
+	{
+		Animation& anim_i = _animations[ii];
+		const StringId64 name = anim_i.name;
+		const f32 speed = anim_i.speed;
 
 		// Advance animation
 		const SpriteAnimationResource* sar = (SpriteAnimationResource*)_resource_manager->get(RESOURCE_TYPE_SPRITE_ANIMATION, name);
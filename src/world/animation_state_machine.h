@@ -33,6 +33,8 @@ struct AnimationStateMachine
 		const State* state_next;
 		const StateMachineResource* state_machine;
 		f32* variables;
+		StringId64 name; // Animation selected by the last update().
+		f32 speed;       // Speed evaluated by the last update().
 	};
 
 	u32 _marker;
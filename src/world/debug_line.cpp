@@ -3,6 +3,7 @@
  * License: https://github.com/dbartolini/crown/blob/master/LICENSE
  */
 
+#include "core/containers/array.inl"
 #include "core/math/color4.inl"
 #include "core/math/constants.h"
 #include "core/math/frustum.inl"
@@ -10,6 +11,7 @@
 #include "core/math/math.h"
 #include "core/math/matrix4x4.inl"
 #include "core/math/vector3.inl"
+#include "core/memory/globals.h"
 #include "core/strings/string_id.inl"
 #include "device/pipeline.h"
 #include "resource/mesh_resource.h"
@@ -190,7 +192,8 @@ void DebugLine::add_obb(const Matrix4x4& tm, const Vector3& half_extents, const
 	add_line(o - x + y - z, o - x + y + z, color);
 }
 
-void DebugLine::add_mesh(const Matrix4x4& tm, const void* vertices, u32 stride, const u16* indices, u32 num, const Color4& color)
+template <typename TIndex>
+static void add_mesh_internal(DebugLine& dl, const Matrix4x4& tm, const void* vertices, u32 stride, const TIndex* indices, u32 num, const Color4& color)
 {
 	for (u32 i = 0; i < num; i += 3)
 	{
@@ -202,12 +205,22 @@ void DebugLine::add_mesh(const Matrix4x4& tm, const void* vertices, u32 stride,
 		const Vector3& v1 = *(const Vector3*)((const char*)vertices + i1*stride) * tm;
 		const Vector3& v2 = *(const Vector3*)((const char*)vertices + i2*stride) * tm;
 
-		add_line(v0, v1, color);
-		add_line(v1, v2, color);
-		add_line(v2, v0, color);
+		dl.add_line(v0, v1, color);
+		dl.add_line(v1, v2, color);
+		dl.add_line(v2, v0, color);
 	}
 }
 
+void DebugLine::add_mesh(const Matrix4x4& tm, const void* vertices, u32 stride, const u16* indices, u32 num, const Color4& color)
+{
+	add_mesh_internal(*this, tm, vertices, stride, indices, num, color);
+}
+
+void DebugLine::add_mesh(const Matrix4x4& tm, const void* vertices, u32 stride, const u32* indices, u32 num, const Color4& color)
+{
+	add_mesh_internal(*this, tm, vertices, stride, indices, num, color);
+}
+
 void DebugLine::add_unit(ResourceManager& rm, const Matrix4x4& tm, StringId64 name, const Color4& color)
 {
 	const UnitResource& ur = *(const UnitResource*)rm.get(RESOURCE_TYPE_UNIT, name);
@@ -226,13 +239,37 @@ void DebugLine::add_unit(ResourceManager& rm, const Matrix4x4& tm, StringId64 na
 				const MeshResource* mr = (const MeshResource*)rm.get(RESOURCE_TYPE_MESH, mrd->mesh_resource);
 				const MeshGeometry* mg = mr->geometry(mrd->geometry_name);
 
-				add_mesh(tm
-					, mg->vertices.data
-					, mg->vertices.stride
-					, (u16*)mg->indices.data
-					, mg->indices.num
-					, color
-					);
+				const void* vertices = mg->vertices.data;
+				u32 stride = mg->vertices.stride;
+
+				Array<Vector3> positions(default_allocator());
+				if (mg->vertices.compression != VertexCompression::NONE)
+				{
+					mesh_resource::decode_positions(positions, *mg);
+					vertices = array::begin(positions);
+					stride = sizeof(Vector3);
+				}
+
+				if (mg->indices.stride == sizeof(u32))
+				{
+					add_mesh(tm
+						, vertices
+						, stride
+						, (u32*)mg->indices.data
+						, mg->indices.num
+						, color
+						);
+				}
+				else
+				{
+					add_mesh(tm
+						, vertices
+						, stride
+						, (u16*)mg->indices.data
+						, mg->indices.num
+						, color
+						);
+				}
 			}
 		}
 		else if (component->type == COMPONENT_TYPE_SPRITE_RENDERER)
@@ -69,13 +69,13 @@ void GuiBuffer::submit(u32 num_vertices, u32 num_indices, const Matrix4x4& world
 	_num_indices += num_indices;
 }
 
-void GuiBuffer::submit_with_material(u32 num_vertices, u32 num_indices, const Matrix4x4& world, ResourceManager& rm, Material* material)
+void GuiBuffer::submit_with_material(u32 num_vertices, u32 num_indices, const Matrix4x4& world, Material* material)
 {
 	bgfx::setVertexBuffer(0, &tvb, _num_vertices, num_vertices);
 	bgfx::setIndexBuffer(&tib, _num_indices, num_indices);
 	bgfx::setTransform(to_float_ptr(world));
 
-	material->bind(rm, *_shader_manager, VIEW_GUI);
+	material->bind(VIEW_GUI);
 
 	_num_vertices += num_vertices;
 	_num_indices += num_indices;
@@ -226,12 +226,10 @@ void Gui::image_uv_3d(const Vector3& pos, const Vector2& size, const Vector2& uv
 	inds[4] = 2;
 	inds[5] = 3;
 
-	_material_manager->create_material(material);
 	_buffer->submit_with_material(4
 		, 6
 		, _world
-		, *_resource_manager
-		, _material_manager->get(material)
+		, _material_manager->create_material(material)
 		);
 }
 
@@ -252,7 +250,7 @@ void Gui::image(const Vector2& pos, const Vector2& size, StringId64 material, co
 
 void Gui::text_3d(const Vector3& pos, u32 font_size, const char* str, StringId64 font, StringId64 material, const Color4& color)
 {
-	_material_manager->create_material(material);
+	Material* mat = _material_manager->create_material(material);
 
 	const FontResource* fr = (FontResource*)_resource_manager->get(RESOURCE_TYPE_FONT, font);
 	const f32 scale = (f32)font_size / (f32)fr->font_size;
@@ -356,8 +354,7 @@ void Gui::text_3d(const Vector3& pos, u32 font_size, const char* str, StringId64
 	_buffer->submit_with_material(num_vertices
 		, num_indices
 		, _world
-		, *_resource_manager
-		, _material_manager->get(material)
+		, mat
 		);
 }
 
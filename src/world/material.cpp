@@ -3,36 +3,31 @@
  * License: https://github.com/dbartolini/crown/blob/master/LICENSE
  */
 
+#include "core/error/error.inl"
 #include "resource/material_resource.h"
-#include "resource/resource_manager.h"
-#include "resource/texture_resource.h"
 #include "world/material.h"
-#include "world/shader_manager.h"
 #include <bgfx/bgfx.h>
 
 namespace crown
 {
-void Material::bind(ResourceManager& rm, ShaderManager& sm, u8 view, s32 depth) const
+void Material::bind(u8 view, s32 depth, bool instanced) const
 {
 	using namespace material_resource;
 
 	// Set samplers
 	for (u32 i = 0; i < _resource->num_textures; ++i)
 	{
-		const TextureData* td   = texture_data(_resource, i);
 		const TextureHandle* th = texture_handle(_resource, i, _data);
 
-		const TextureResource* teximg = (TextureResource*)rm.get(RESOURCE_TYPE_TEXTURE, td->id);
-
 		bgfx::UniformHandle sampler;
 		bgfx::TextureHandle texture;
 		sampler.idx = th->sampler_handle;
-		texture.idx = teximg->handle.idx;
+		texture.idx = th->texture_handle;
 
 		bgfx::setTexture(i
 			, sampler
 			, texture
-			, sm.sampler_state(_resource->shader, td->name)
+			, _sampler_flags[i]
 			);
 	}
 
@@ -46,7 +41,9 @@ void Material::bind(ResourceManager& rm, ShaderManager& sm, u8 view, s32 depth)
 		bgfx::setUniform(buh, (char*)uh + sizeof(uh->uniform_handle));
 	}
 
-	sm.submit(_resource->shader, view, depth);
+	CE_ASSERT(!instanced || bgfx::isValid(_program_instanced), "Shader has no instanced variant");
+	bgfx::setState(_state);
+	bgfx::submit(view, instanced ? _program_instanced : _program, depth);
 }
 
 void Material::set_float(StringId32 name, f32 value)
@@ -8,6 +8,7 @@
 #include "core/math/types.h"
 #include "resource/types.h"
 #include "world/types.h"
+#include <bgfx/bgfx.h>
 
 namespace crown
 {
@@ -18,9 +19,16 @@ struct Material
 {
 	const MaterialResource* _resource;
 	char* _data;
-
-	///
-	void bind(ResourceManager& rm, ShaderManager& sm, u8 view, s32 depth = 0) const;
+	u32* _sampler_flags; // One per texture.
+	u64 _state;
+	bgfx::ProgramHandle _program;
+	bgfx::ProgramHandle _program_instanced;
+	u16 _id;
+
+	/// Binds the material's textures and uniforms and submits a draw call
+	/// to @a view. If @a instanced is true, the instanced variant of the
+	/// shader is used.
+	void bind(u8 view, s32 depth = 0, bool instanced = false) const;
 
 	/// Sets the @a value of the variable @a name.
 	void set_float(StringId32 name, f32 value);
@@ -3,21 +3,28 @@
  * License: https://github.com/dbartolini/crown/blob/master/LICENSE
  */
 
+#include "core/containers/array.inl"
 #include "core/containers/hash_map.inl"
 #include "core/filesystem/file.h"
+#include "core/memory/memory.inl"
 #include "core/strings/string_id.inl"
 #include "resource/material_resource.h"
 #include "resource/resource_manager.h"
+#include "resource/texture_resource.h"
 #include "world/material_manager.h"
+#include "world/shader_manager.h"
 #include <bgfx/bgfx.h>
 #include <string.h> // memcpy
 
 namespace crown
 {
-MaterialManager::MaterialManager(Allocator& a, ResourceManager& rm)
+MaterialManager::MaterialManager(Allocator& a, ResourceManager& rm, ShaderManager& sm)
 	: _allocator(&a)
 	, _resource_manager(&rm)
+	, _shader_manager(&sm)
 	, _materials(a)
+	, _free_ids(a)
+	, _next_id(0)
 {
 }
 
@@ -95,27 +102,67 @@ void MaterialManager::unload(Allocator& a, void* res)
 	a.deallocate(res);
 }
 
-void MaterialManager::create_material(StringId64 id)
+Material* MaterialManager::create_material(StringId64 id)
 {
-	if (hash_map::has(_materials, id))
-		return;
+	using namespace material_resource;
+
+	Material* mat = hash_map::get(_materials, id, (Material*)NULL);
+	if (mat != NULL)
+		return mat;
 
 	const MaterialResource* mr = (MaterialResource*)_resource_manager->get(RESOURCE_TYPE_MATERIAL, id);
 
-	const u32 size = sizeof(Material) + mr->dynamic_data_size;
-	Material* mat  = (Material*)_allocator->allocate(size);
-	mat->_resource = mr;
-	mat->_data     = (char*)&mat[1];
+	const u32 size = sizeof(Material)
+		+ mr->dynamic_data_size
+		+ mr->num_textures*sizeof(u32) + alignof(u32)
+		;
+	mat = (Material*)_allocator->allocate(size);
+	mat->_resource      = mr;
+	mat->_data          = (char*)&mat[1];
+	mat->_sampler_flags = (u32*)memory::align_top(mat->_data + mr->dynamic_data_size, alignof(u32));
+
+	// Reuse the IDs of destroyed materials, so that IDs stay unique among
+	// the live materials and small enough to fit sort keys.
+	if (array::size(_free_ids) != 0)
+	{
+		mat->_id = array::back(_free_ids);
+		array::pop_back(_free_ids);
+	}
+	else
+	{
+		CE_ASSERT(_next_id != UINT16_MAX, "Too many materials");
+		mat->_id = _next_id++;
+	}
 
 	const char* data = (char*)mr + mr->dynamic_data_offset;
 	memcpy(mat->_data, data, mr->dynamic_data_size);
 
+	const ShaderManager::ShaderData sd = _shader_manager->shader(mr->shader);
+	mat->_state             = sd.state;
+	mat->_program           = sd.program;
+	mat->_program_instanced = sd.program_instanced;
+
+	for (u32 i = 0; i < mr->num_textures; ++i)
+	{
+		const TextureData* td = texture_data(mr, i);
+		TextureHandle* th     = texture_handle(mr, i, mat->_data);
+
+		const TextureResource* tr = (TextureResource*)_resource_manager->get(RESOURCE_TYPE_TEXTURE, td->id);
+		th->texture_handle        = tr->handle.idx;
+		mat->_sampler_flags[i]    = _shader_manager->sampler_state(mr->shader, td->name);
+	}
+
 	hash_map::set(_materials, id, mat);
+	return mat;
 }
 
 void MaterialManager::destroy_material(StringId64 id)
 {
 	Material* mat = hash_map::get(_materials, id, (Material*)NULL);
+	if (mat == NULL)
+		return;
+
+	array::push_back(_free_ids, mat->_id);
 	_allocator->deallocate(mat);
 
 	hash_map::remove(_materials, id);
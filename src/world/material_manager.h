@@ -18,10 +18,13 @@ struct MaterialManager
 {
 	Allocator* _allocator;
 	ResourceManager* _resource_manager;
+	ShaderManager* _shader_manager;
 	HashMap<StringId64, Material*> _materials;
+	Array<u16> _free_ids; ///< IDs of the destroyed materials.
+	u16 _next_id;
 
 	///
-	MaterialManager(Allocator& a, ResourceManager& rm);
+	MaterialManager(Allocator& a, ResourceManager& rm, ShaderManager& sm);
 
 	///
 	~MaterialManager();
@@ -38,8 +41,10 @@ struct MaterialManager
 	///
 	void unload(Allocator& a, void* res);
 
-	/// Creates the material @a id.
-	void create_material(StringId64 id);
+	/// Creates the material @a id and returns it. Texture and shader
+	/// handles are resolved once here so that binding the material does
+	/// no lookups.
+	Material* create_material(StringId64 id);
 
 	/// Destroys the material @a id.
 	void destroy_material(StringId64 id);
@@ -83,6 +83,12 @@ struct PhysicsWorld
 	/// Disables collision detection for the @a actor.
 	void actor_disable_collision(ActorInstance actor);
 
+	/// Enables collision events for the @a actor.
+	void actor_enable_collision_events(ActorInstance actor);
+
+	/// Disables collision events for the @a actor.
+	void actor_disable_collision_events(ActorInstance actor);
+
 	/// Sets the collision filter of the @a actor.
 	void actor_set_collision_filter(ActorInstance actor, StringId32 filter);
 
@@ -34,6 +34,8 @@
 #include <BulletCollision/CollisionShapes/btConvexHullShape.h>
 #include <BulletCollision/CollisionShapes/btConvexTriangleMeshShape.h>
 #include <BulletCollision/CollisionShapes/btHeightfieldTerrainShape.h>
+#include <BulletCollision/CollisionShapes/btOptimizedBvh.h>
+#include <BulletCollision/CollisionShapes/btScaledBvhTriangleMeshShape.h>
 #include <BulletCollision/CollisionShapes/btSphereShape.h>
 #include <BulletCollision/CollisionShapes/btStaticPlaneShape.h>
 #include <BulletCollision/CollisionShapes/btTriangleMesh.h>
@@ -58,17 +60,38 @@ namespace physics_globals
 	static btCollisionDispatcher* _bt_dispatcher;
 	static btBroadphaseInterface* _bt_interface;
 	static btSequentialImpulseConstraintSolver* _bt_solver;
+	static btGhostPairCallback* _bt_ghost_pair_callback;
+
+	/// Skips the narrowphase of the pairs involving a trigger: triggers only
+	/// need the pairs found by the broadphase.
+	static void near_callback(btBroadphasePair& pair, btCollisionDispatcher& dispatcher, const btDispatcherInfo& info)
+	{
+		const btCollisionObject* obj_a = (btCollisionObject*)pair.m_pProxy0->m_clientObject;
+		const btCollisionObject* obj_b = (btCollisionObject*)pair.m_pProxy1->m_clientObject;
+
+		if (obj_a->getInternalType() == btCollisionObject::CO_GHOST_OBJECT
+			|| obj_b->getInternalType() == btCollisionObject::CO_GHOST_OBJECT
+			)
+			return;
+
+		btCollisionDispatcher::defaultNearCallback(pair, dispatcher, info);
+	}
 
 	void init(Allocator& a)
 	{
-		_bt_configuration = CE_NEW(a, btDefaultCollisionConfiguration);
-		_bt_dispatcher    = CE_NEW(a, btCollisionDispatcher)(_bt_configuration);
-		_bt_interface     = CE_NEW(a, btDbvtBroadphase);
-		_bt_solver        = CE_NEW(a, btSequentialImpulseConstraintSolver);
+		_bt_configuration       = CE_NEW(a, btDefaultCollisionConfiguration);
+		_bt_dispatcher          = CE_NEW(a, btCollisionDispatcher)(_bt_configuration);
+		_bt_interface           = CE_NEW(a, btDbvtBroadphase);
+		_bt_solver              = CE_NEW(a, btSequentialImpulseConstraintSolver);
+		_bt_ghost_pair_callback = CE_NEW(a, btGhostPairCallback);
+
+		_bt_dispatcher->setNearCallback(near_callback);
+		_bt_interface->getOverlappingPairCache()->setInternalGhostPairCallback(_bt_ghost_pair_callback);
 	}
 
 	void shutdown(Allocator& a)
 	{
+		CE_DELETE(a, _bt_ghost_pair_callback);
 		CE_DELETE(a, _bt_solver);
 		CE_DELETE(a, _bt_interface);
 		CE_DELETE(a, _bt_dispatcher);
@@ -77,6 +100,15 @@ namespace physics_globals
 
 } // namespace physics_globals
 
+template <>
+struct hash<const ColliderDesc*>
+{
+	u32 operator()(const ColliderDesc* val) const
+	{
+		return u32(uintptr_t(val) >> 4);
+	}
+};
+
 static inline btVector3 to_btVector3(const Vector3& v)
 {
 	return btVector3(v.x, v.y, v.z);
@@ -183,6 +215,44 @@ struct MyDebugDrawer : public btIDebugDraw
 	}
 };
 
+/// Convex hull whose vertices and local AABB are computed by the data
+/// compiler.
+struct ConvexHullShape : public btConvexHullShape
+{
+	btVector3 _aabb_min; ///< Unscaled, without margin.
+	btVector3 _aabb_max; ///< Unscaled, without margin.
+
+	ConvexHullShape(const Vector3* points, u32 num, const AABB& aabb)
+		: _aabb_min(to_btVector3(aabb.min))
+		, _aabb_max(to_btVector3(aabb.max))
+	{
+		for (u32 i = 0; i < num; ++i)
+			addPoint(to_btVector3(points[i]), false);
+
+		update_aabb();
+	}
+
+	void setLocalScaling(const btVector3& scaling)
+	{
+		m_localScaling = scaling;
+		update_aabb();
+	}
+
+	/// Scales the compiled AABB instead of searching the support points.
+	void update_aabb()
+	{
+		const btVector3 a = _aabb_min*m_localScaling;
+		const btVector3 b = _aabb_max*m_localScaling;
+		const btVector3 margin(getMargin(), getMargin(), getMargin());
+
+		btVector3 aabb_min = a;
+		btVector3 aabb_max = a;
+		aabb_min.setMin(b);
+		aabb_max.setMax(b);
+		setCachedLocalAabb(aabb_min - margin, aabb_max + margin);
+	}
+};
+
 struct MyFilterCallback : public btOverlapFilterCallback
 {
 	bool needBroadphaseCollision(btBroadphaseProxy* proxy0, btBroadphaseProxy* proxy1) const
@@ -200,15 +270,47 @@ struct PhysicsWorldImpl
 	{
 		UnitId unit;
 		Matrix4x4 local_tm;
-		btTriangleIndexVertexArray* vertex_array;
+		const ColliderDesc* mesh; ///< Key of the shared mesh shape, or NULL.
 		btCollisionShape* shape;
 		ColliderInstance next;
 	};
 
+	/// Triangle mesh shape shared by all the instances of a mesh collider.
+	struct MeshShape
+	{
+		btTriangleIndexVertexArray* vertex_array;
+		btBvhTriangleMeshShape* shape;
+		btOptimizedBvh* bvh;
+		void* bvh_data;
+		u32 references;
+	};
+
 	struct ActorInstanceData
 	{
 		UnitId unit;
-		btRigidBody* body;
+		btCollisionObject* object; ///< Either body or the ghost object of a trigger.
+		btRigidBody* body;         ///< NULL if the actor is a trigger.
+		bool collision_events;     ///< Whether the actor posts collision events.
+	};
+
+	/// Contacts between two actors, aggregated over a frame.
+	struct ContactPair
+	{
+		UnitId units[2];  ///< Sorted by ID.
+		Vector3 position; ///< Deepest contact point.
+		Vector3 normal;   ///< Sum of the contact normals, pointing towards units[0].
+		f32 distance;     ///< Deepest separation.
+		f32 impulse;      ///< Total impulse.
+		u32 frame;        ///< Last frame the actors touched.
+		bool began;       ///< Whether TOUCH_BEGIN has been posted.
+	};
+
+	/// Actor overlapping a trigger.
+	struct TriggerPair
+	{
+		UnitId trigger;
+		UnitId other;
+		u32 frame; ///< Last frame the actors overlapped.
 	};
 
 	Allocator* _allocator;
@@ -216,9 +318,15 @@ struct PhysicsWorldImpl
 
 	HashMap<UnitId, u32> _collider_map;
 	HashMap<UnitId, u32> _actor_map;
+	HashMap<const ColliderDesc*, MeshShape*> _mesh_shapes;
 	Array<ColliderInstanceData> _collider;
 	Array<ActorInstanceData> _actor;
 	Array<btTypedConstraint*> _joints;
+	HashMap<u64, u32> _pair_map;
+	Array<ContactPair> _pairs;
+	HashMap<u64, u32> _trigger_pair_map;
+	Array<TriggerPair> _trigger_pairs;
+	u32 _frame;
 
 	MyFilterCallback _filter_callback;
 	btDiscreteDynamicsWorld* _dynamics_world;
@@ -235,9 +343,15 @@ struct PhysicsWorldImpl
 		, _unit_manager(&um)
 		, _collider_map(a)
 		, _actor_map(a)
+		, _mesh_shapes(a)
 		, _collider(a)
 		, _actor(a)
 		, _joints(a)
+		, _pair_map(a)
+		, _pairs(a)
+		, _trigger_pair_map(a)
+		, _trigger_pairs(a)
+		, _frame(0)
 		, _dynamics_world(NULL)
 		, _debug_drawer(dl)
 		, _events(a)
@@ -267,27 +381,90 @@ struct PhysicsWorldImpl
 		_unit_manager->unregister_destroy_callback(&_unit_destroy_callback);
 
 		for (u32 i = 0; i < array::size(_actor); ++i)
-		{
-			btRigidBody* body = _actor[i].body;
-
-			_dynamics_world->removeRigidBody(body);
-			CE_DELETE(*_allocator, body->getMotionState());
-			CE_DELETE(*_allocator, body->getCollisionShape());
-			CE_DELETE(*_allocator, body);
-		}
+			actor_object_destroy(_actor[i]);
 
 		for (u32 i = 0; i < array::size(_collider); ++i)
 		{
-			CE_DELETE(*_allocator, _collider[i].vertex_array);
 			CE_DELETE(*_allocator, _collider[i].shape);
+			if (_collider[i].mesh != NULL)
+				mesh_shape_release(_collider[i].mesh);
 		}
 
 		CE_DELETE(*_allocator, _dynamics_world);
 	}
 
+	/// Returns the mesh shape of the collider @a sd, creating it from the
+	/// compiled BVH the first time it is requested.
+	btBvhTriangleMeshShape* mesh_shape_acquire(const ColliderDesc* sd)
+	{
+		MeshShape* ms = hash_map::get(_mesh_shapes, sd, (MeshShape*)NULL);
+		if (ms != NULL)
+		{
+			++ms->references;
+			return ms->shape;
+		}
+
+		const ColliderMesh cm = physics_resource::collider_mesh(sd);
+
+		btIndexedMesh part;
+		part.m_vertexBase          = (const unsigned char*)cm.points;
+		part.m_vertexStride        = sizeof(Vector3);
+		part.m_numVertices         = cm.num_points;
+		part.m_triangleIndexBase   = (const unsigned char*)cm.indices;
+		part.m_triangleIndexStride = sizeof(u16)*3;
+		part.m_numTriangles        = cm.num_indices/3;
+		part.m_indexType           = PHY_SHORT;
+
+		ms = CE_NEW(*_allocator, MeshShape)();
+		ms->vertex_array = CE_NEW(*_allocator, btTriangleIndexVertexArray)();
+		ms->vertex_array->addIndexedMesh(part, PHY_SHORT);
+
+		if (cm.bvh_layout == physics_resource::bvh_layout())
+		{
+			// The BVH is fixed up in place, so it needs a copy of its own.
+			ms->bvh_data = _allocator->allocate(cm.bvh_size, 16);
+			memcpy(ms->bvh_data, cm.bvh, cm.bvh_size);
+			ms->bvh = btOptimizedBvh::deSerializeInPlace(ms->bvh_data, cm.bvh_size, false);
+			CE_ASSERT(ms->bvh != NULL, "Invalid BVH data");
+
+			ms->shape = CE_NEW(*_allocator, btBvhTriangleMeshShape)(ms->vertex_array, true, false);
+			ms->shape->setOptimizedBvh(ms->bvh);
+		}
+		else
+		{
+			// The BVH was baked for a different platform: build a new one.
+			ms->bvh_data = NULL;
+			ms->bvh = NULL;
+			ms->shape = CE_NEW(*_allocator, btBvhTriangleMeshShape)(ms->vertex_array, true, true);
+		}
+		ms->references = 1;
+
+		hash_map::set(_mesh_shapes, sd, ms);
+		return ms->shape;
+	}
+
+	void mesh_shape_release(const ColliderDesc* sd)
+	{
+		MeshShape* ms = hash_map::get(_mesh_shapes, sd, (MeshShape*)NULL);
+		CE_ENSURE(ms != NULL);
+
+		if (--ms->references > 0)
+			return;
+
+		CE_DELETE(*_allocator, ms->shape);
+		if (ms->bvh != NULL)
+		{
+			ms->bvh->~btOptimizedBvh();
+			_allocator->deallocate(ms->bvh_data);
+		}
+		CE_DELETE(*_allocator, ms->vertex_array);
+		CE_DELETE(*_allocator, ms);
+		hash_map::remove(_mesh_shapes, sd);
+	}
+
 	ColliderInstance collider_create(UnitId unit, const ColliderDesc* sd, const Vector3& scale)
 	{
-		btTriangleIndexVertexArray* vertex_array = NULL;
+		const ColliderDesc* mesh = NULL;
 		btCollisionShape* child_shape = NULL;
 
 		switch(sd->type)
@@ -306,42 +483,35 @@ struct PhysicsWorldImpl
 
 		case ColliderType::CONVEX_HULL:
 			{
-				const char* data       = (char*)&sd[1];
-				const u32 num          = *(u32*)data;
-				const btScalar* points = (btScalar*)(data + sizeof(u32));
+				const char* data      = (char*)&sd[1];
+				const u32 num         = *(u32*)data;
+				const Vector3* points = (Vector3*)(data + sizeof(u32));
+				const AABB* aabb      = (AABB*)(points + num);
 
-				child_shape = CE_NEW(*_allocator, btConvexHullShape)(points, (int)num, sizeof(Vector3));
+				child_shape = CE_NEW(*_allocator, ConvexHullShape)(points, num, *aabb);
 			}
 			break;
 
 		case ColliderType::MESH:
-			{
-				const char* data      = (char*)&sd[1];
-				const u32 num_points  = *(u32*)data;
-				const char* points    = data + sizeof(u32);
-				const u32 num_indices = *(u32*)(points + num_points*sizeof(Vector3));
-				const char* indices   = points + sizeof(u32) + num_points*sizeof(Vector3);
-
-				btIndexedMesh part;
-				part.m_vertexBase          = (const unsigned char*)points;
-				part.m_vertexStride        = sizeof(Vector3);
-				part.m_numVertices         = num_points;
-				part.m_triangleIndexBase   = (const unsigned char*)indices;
-				part.m_triangleIndexStride = sizeof(u16)*3;
-				part.m_numTriangles        = num_indices/3;
-				part.m_indexType           = PHY_SHORT;
-
-				vertex_array = CE_NEW(*_allocator, btTriangleIndexVertexArray)();
-				vertex_array->addIndexedMesh(part, PHY_SHORT);
-
-				const btVector3 aabb_min(-1000.0f,-1000.0f,-1000.0f);
-				const btVector3 aabb_max(1000.0f,1000.0f,1000.0f);
-				child_shape = CE_NEW(*_allocator, btBvhTriangleMeshShape)(vertex_array, false, aabb_min, aabb_max);
-			}
+			// Instances share the mesh and its BVH and only own their scale.
+			mesh = sd;
+			child_shape = CE_NEW(*_allocator, btScaledBvhTriangleMeshShape)(mesh_shape_acquire(sd), to_btVector3(scale));
 			break;
 
 		case ColliderType::HEIGHTFIELD:
-			CE_FATAL("Not implemented");
+			// Heights are read straight from the resource.
+			child_shape = CE_NEW(*_allocator, btHeightfieldTerrainShape)(sd->heightfield.width
+				, sd->heightfield.length
+				, (const void*)&sd[1]
+				, sd->heightfield.height_scale
+				, sd->heightfield.height_min
+				, sd->heightfield.height_max
+				, 1
+				, PHY_SHORT
+				, false
+				);
+			// Skips the chunks of the grid a ray cannot hit.
+			((btHeightfieldTerrainShape*)child_shape)->buildAccelerator();
 			break;
 
 		default:
@@ -349,14 +519,22 @@ struct PhysicsWorldImpl
 			break;
 		}
 
-		child_shape->setLocalScaling(to_btVector3(scale));
+		if (sd->type == ColliderType::HEIGHTFIELD)
+		{
+			const f32 cs = sd->heightfield.cell_size;
+			child_shape->setLocalScaling(to_btVector3(vector3(scale.x*cs, scale.y, scale.z*cs)));
+		}
+		else
+		{
+			child_shape->setLocalScaling(to_btVector3(scale));
+		}
 
 		const u32 last = array::size(_collider);
 
 		ColliderInstanceData cid;
 		cid.unit         = unit;
 		cid.local_tm     = sd->local_tm;
-		cid.vertex_array = vertex_array;
+		cid.mesh         = mesh;
 		cid.shape        = child_shape;
 		cid.next.i       = UINT32_MAX;
 
@@ -385,8 +563,9 @@ struct PhysicsWorldImpl
 		collider_swap_node(last_i, collider);
 		collider_remove_node(first_i, collider);
 
-		CE_DELETE(*_allocator, _collider[collider.i].vertex_array);
 		CE_DELETE(*_allocator, _collider[collider.i].shape);
+		if (_collider[collider.i].mesh != NULL)
+			mesh_shape_release(_collider[collider.i].mesh);
 
 		_collider[collider.i] = _collider[last];
 
@@ -484,62 +663,85 @@ struct PhysicsWorldImpl
 			ci = collider_next(ci);
 		}
 
-		// Create motion state
 		const btTransform tr = to_btTransform(tm);
-		btDefaultMotionState* ms = is_static
-			? NULL
-			: CE_NEW(*_allocator, btDefaultMotionState)(tr)
-			;
-
-		// If dynamic, calculate inertia
-		btVector3 inertia;
-		if (mass != 0.0f) // Actor is dynamic iff mass != 0
-			shape->calculateLocalInertia(mass, inertia);
-
-		btRigidBody::btRigidBodyConstructionInfo rbinfo(mass, ms, shape, inertia);
-		rbinfo.m_startWorldTransform      = tr;
-		rbinfo.m_linearDamping            = actor_class->linear_damping;
-		rbinfo.m_angularDamping           = actor_class->angular_damping;
-		rbinfo.m_restitution              = material->restitution;
-		rbinfo.m_friction                 = material->friction;
-		rbinfo.m_rollingFriction          = material->rolling_friction;
-		rbinfo.m_linearSleepingThreshold  = 0.5f; // FIXME
-		rbinfo.m_angularSleepingThreshold = 0.7f; // FIXME
-
-		// Create rigid body
-		btRigidBody* body = CE_NEW(*_allocator, btRigidBody)(rbinfo);
-
-		int cflags = body->getCollisionFlags();
-		cflags |= is_kinematic ? btCollisionObject::CF_KINEMATIC_OBJECT    : 0;
-		cflags |= is_static    ? btCollisionObject::CF_STATIC_OBJECT       : 0;
-		cflags |= is_trigger   ? btCollisionObject::CF_NO_CONTACT_RESPONSE : 0;
-		body->setCollisionFlags(cflags);
-		if (is_kinematic)
-			body->setActivationState(DISABLE_DEACTIVATION);
-
-		body->setLinearFactor(btVector3(
-			(ar->flags & ActorFlags::LOCK_TRANSLATION_X) ? 0.0f : 1.0f,
-			(ar->flags & ActorFlags::LOCK_TRANSLATION_Y) ? 0.0f : 1.0f,
-			(ar->flags & ActorFlags::LOCK_TRANSLATION_Z) ? 0.0f : 1.0f)
-		);
-		body->setAngularFactor(btVector3(
-			(ar->flags & ActorFlags::LOCK_ROTATION_X) ? 0.0f : 1.0f,
-			(ar->flags & ActorFlags::LOCK_ROTATION_Y) ? 0.0f : 1.0f,
-			(ar->flags & ActorFlags::LOCK_ROTATION_Z) ? 0.0f : 1.0f)
-		);
-
 		const u32 last = array::size(_actor);
-		body->setUserPointer((void*)(uintptr_t)last);
 
-		// Set collision filters
+		// Collision filters
 		const u32 me   = physics_config_resource::filter(_config_resource, ar->collision_filter)->me;
 		const u32 mask = physics_config_resource::filter(_config_resource, ar->collision_filter)->mask;
 
-		_dynamics_world->addRigidBody(body, me, mask);
-
 		ActorInstanceData aid;
 		aid.unit = unit;
-		aid.body = body;
+		aid.collision_events = (actor_class->flags & PhysicsActor::COLLISION_EVENTS) != 0;
+
+		if (is_trigger)
+		{
+			// Triggers are never simulated: they only report the actors
+			// overlapping their bounds.
+			btGhostObject* ghost = CE_NEW(*_allocator, btGhostObject)();
+			ghost->setCollisionShape(shape);
+			ghost->setWorldTransform(tr);
+			ghost->setCollisionFlags(btCollisionObject::CF_NO_CONTACT_RESPONSE
+				| (is_static ? btCollisionObject::CF_STATIC_OBJECT : btCollisionObject::CF_KINEMATIC_OBJECT)
+				);
+			ghost->setUserPointer((void*)(uintptr_t)last);
+
+			_dynamics_world->addCollisionObject(ghost, me, mask);
+
+			aid.object = ghost;
+			aid.body = NULL;
+		}
+		else
+		{
+			// Create motion state
+			btDefaultMotionState* ms = is_static
+				? NULL
+				: CE_NEW(*_allocator, btDefaultMotionState)(tr)
+				;
+
+			// If dynamic, calculate inertia
+			btVector3 inertia;
+			if (mass != 0.0f) // Actor is dynamic iff mass != 0
+				shape->calculateLocalInertia(mass, inertia);
+
+			btRigidBody::btRigidBodyConstructionInfo rbinfo(mass, ms, shape, inertia);
+			rbinfo.m_startWorldTransform      = tr;
+			rbinfo.m_linearDamping            = actor_class->linear_damping;
+			rbinfo.m_angularDamping           = actor_class->angular_damping;
+			rbinfo.m_restitution              = material->restitution;
+			rbinfo.m_friction                 = material->friction;
+			rbinfo.m_rollingFriction          = material->rolling_friction;
+			rbinfo.m_linearSleepingThreshold  = 0.5f; // FIXME
+			rbinfo.m_angularSleepingThreshold = 0.7f; // FIXME
+
+			// Create rigid body
+			btRigidBody* body = CE_NEW(*_allocator, btRigidBody)(rbinfo);
+
+			int cflags = body->getCollisionFlags();
+			cflags |= is_kinematic ? btCollisionObject::CF_KINEMATIC_OBJECT : 0;
+			cflags |= is_static    ? btCollisionObject::CF_STATIC_OBJECT    : 0;
+			body->setCollisionFlags(cflags);
+			if (is_kinematic)
+				body->setActivationState(DISABLE_DEACTIVATION);
+
+			body->setLinearFactor(btVector3(
+				(ar->flags & ActorFlags::LOCK_TRANSLATION_X) ? 0.0f : 1.0f,
+				(ar->flags & ActorFlags::LOCK_TRANSLATION_Y) ? 0.0f : 1.0f,
+				(ar->flags & ActorFlags::LOCK_TRANSLATION_Z) ? 0.0f : 1.0f)
+			);
+			body->setAngularFactor(btVector3(
+				(ar->flags & ActorFlags::LOCK_ROTATION_X) ? 0.0f : 1.0f,
+				(ar->flags & ActorFlags::LOCK_ROTATION_Y) ? 0.0f : 1.0f,
+				(ar->flags & ActorFlags::LOCK_ROTATION_Z) ? 0.0f : 1.0f)
+			);
+
+			body->setUserPointer((void*)(uintptr_t)last);
+
+			_dynamics_world->addRigidBody(body, me, mask);
+
+			aid.object = body;
+			aid.body = body;
+		}
 
 		array::push_back(_actor, aid);
 		hash_map::set(_actor_map, unit, last);
@@ -553,18 +755,82 @@ struct PhysicsWorldImpl
 		const UnitId u      = _actor[actor.i].unit;
 		const UnitId last_u = _actor[last].unit;
 
-		_dynamics_world->removeRigidBody(_actor[actor.i].body);
-		CE_DELETE(*_allocator, _actor[actor.i].body->getMotionState());
-		CE_DELETE(*_allocator, _actor[actor.i].body->getCollisionShape());
-		CE_DELETE(*_allocator, _actor[actor.i].body);
+		actor_object_destroy(_actor[actor.i]);
 
 		_actor[actor.i] = _actor[last];
-		_actor[actor.i].body->setUserPointer((void*)(uintptr_t)actor.i);
+		_actor[actor.i].object->setUserPointer((void*)(uintptr_t)actor.i);
 
 		array::pop_back(_actor);
 
 		hash_map::set(_actor_map, last_u, actor.i);
 		hash_map::remove(_actor_map, u);
+
+		// End the contacts of the actor.
+		for (u32 i = 0; i < array::size(_pairs);)
+		{
+			if (_pairs[i].units[0] == u || _pairs[i].units[1] == u)
+			{
+				post_collision_event(_pairs[i], PhysicsCollisionEvent::TOUCH_END);
+				contact_pair_remove(i);
+				continue;
+			}
+
+			++i;
+		}
+
+		// End the overlaps of the actor.
+		for (u32 i = 0; i < array::size(_trigger_pairs);)
+		{
+			if (_trigger_pairs[i].trigger == u || _trigger_pairs[i].other == u)
+			{
+				post_trigger_event(_trigger_pairs[i], PhysicsTriggerEvent::TOUCH_END);
+				trigger_pair_remove(i);
+				continue;
+			}
+
+			++i;
+		}
+	}
+
+	void actor_object_destroy(const ActorInstanceData& aid)
+	{
+		if (aid.body != NULL)
+		{
+			_dynamics_world->removeRigidBody(aid.body);
+			CE_DELETE(*_allocator, aid.body->getMotionState());
+		}
+		else
+		{
+			_dynamics_world->removeCollisionObject(aid.object);
+		}
+
+		CE_DELETE(*_allocator, aid.object->getCollisionShape());
+		CE_DELETE(*_allocator, aid.object);
+	}
+
+	/// Returns the rigid body of @a actor.
+	btRigidBody* actor_body(ActorInstance actor) const
+	{
+		CE_ASSERT(_actor[actor.i].body != NULL, "Triggers have no rigid body");
+		return _actor[actor.i].body;
+	}
+
+	void actor_set_world_transform(ActorInstance actor, const btTransform& pose)
+	{
+		btRigidBody* body = _actor[actor.i].body;
+
+		if (body != NULL)
+		{
+			body->setCenterOfMassTransform(pose);
+
+			btMotionState* ms = body->getMotionState();
+			if (ms != NULL)
+				ms->setWorldTransform(pose);
+		}
+		else
+		{
+			_actor[actor.i].object->setWorldTransform(pose);
+		}
 	}
 
 	ActorInstance actor(UnitId unit)
@@ -574,31 +840,31 @@ struct PhysicsWorldImpl
 
 	Vector3 actor_world_position(ActorInstance actor) const
 	{
-		return to_vector3(_actor[actor.i].body->getCenterOfMassPosition());
+		return to_vector3(_actor[actor.i].object->getWorldTransform().getOrigin());
 	}
 
 	Quaternion actor_world_rotation(ActorInstance actor) const
 	{
-		return to_quaternion(_actor[actor.i].body->getOrientation());
+		return to_quaternion(_actor[actor.i].object->getWorldTransform().getRotation());
 	}
 
 	Matrix4x4 actor_world_pose(ActorInstance actor) const
 	{
-		return to_matrix4x4(_actor[actor.i].body->getCenterOfMassTransform());
+		return to_matrix4x4(_actor[actor.i].object->getWorldTransform());
 	}
 
 	void actor_teleport_world_position(ActorInstance actor, const Vector3& p)
 	{
-		btTransform pose = _actor[actor.i].body->getCenterOfMassTransform();
+		btTransform pose = _actor[actor.i].object->getWorldTransform();
 		pose.setOrigin(to_btVector3(p));
-		_actor[actor.i].body->setCenterOfMassTransform(pose);
+		actor_set_world_transform(actor, pose);
 	}
 
 	void actor_teleport_world_rotation(ActorInstance actor, const Quaternion& r)
 	{
-		btTransform pose = _actor[actor.i].body->getCenterOfMassTransform();
+		btTransform pose = _actor[actor.i].object->getWorldTransform();
 		pose.setRotation(to_btQuaternion(r));
-		_actor[actor.i].body->setCenterOfMassTransform(pose);
+		actor_set_world_transform(actor, pose);
 	}
 
 	void actor_teleport_world_pose(ActorInstance actor, const Matrix4x4& m)
@@ -606,27 +872,27 @@ struct PhysicsWorldImpl
 		const Quaternion rot = rotation(m);
 		const Vector3 pos = translation(m);
 
-		btTransform pose = _actor[actor.i].body->getCenterOfMassTransform();
+		btTransform pose = _actor[actor.i].object->getWorldTransform();
 		pose.setRotation(to_btQuaternion(rot));
 		pose.setOrigin(to_btVector3(pos));
-		_actor[actor.i].body->setCenterOfMassTransform(pose);
+		actor_set_world_transform(actor, pose);
 	}
 
 	Vector3 actor_center_of_mass(ActorInstance actor) const
 	{
-		return to_vector3(_actor[actor.i].body->getCenterOfMassTransform().getOrigin());
+		return to_vector3(_actor[actor.i].object->getWorldTransform().getOrigin());
 	}
 
 	void actor_enable_gravity(ActorInstance actor)
 	{
-		btRigidBody* body = _actor[actor.i].body;
+		btRigidBody* body = actor_body(actor);
 		body->setFlags(body->getFlags() & ~BT_DISABLE_WORLD_GRAVITY);
 		body->setGravity(_dynamics_world->getGravity());
 	}
 
 	void actor_disable_gravity(ActorInstance actor)
 	{
-		btRigidBody* body = _actor[actor.i].body;
+		btRigidBody* body = actor_body(actor);
 		body->setFlags(body->getFlags() | BT_DISABLE_WORLD_GRAVITY);
 		body->setGravity(btVector3(0.0f, 0.0f, 0.0f));
 	}
@@ -641,6 +907,16 @@ struct PhysicsWorldImpl
 		CE_FATAL("Not implemented yet");
 	}
 
+	void actor_enable_collision_events(ActorInstance actor)
+	{
+		_actor[actor.i].collision_events = true;
+	}
+
+	void actor_disable_collision_events(ActorInstance actor)
+	{
+		_actor[actor.i].collision_events = false;
+	}
+
 	void actor_set_collision_filter(ActorInstance /*i*/, StringId32 /*filter*/)
 	{
 		CE_FATAL("Not implemented yet");
@@ -648,7 +924,7 @@ struct PhysicsWorldImpl
 
 	void actor_set_kinematic(ActorInstance actor, bool kinematic)
 	{
-		btRigidBody* body = _actor[actor.i].body;
+		btCollisionObject* body = _actor[actor.i].object;
 		int flags = body->getCollisionFlags();
 
 		if (kinematic)
@@ -665,12 +941,12 @@ struct PhysicsWorldImpl
 
 	bool actor_is_static(ActorInstance actor) const
 	{
-		return _actor[actor.i].body->getCollisionFlags() & btCollisionObject::CF_STATIC_OBJECT;
+		return _actor[actor.i].object->getCollisionFlags() & btCollisionObject::CF_STATIC_OBJECT;
 	}
 
 	bool actor_is_dynamic(ActorInstance actor) const
 	{
-		const int flags = _actor[actor.i].body->getCollisionFlags();
+		const int flags = _actor[actor.i].object->getCollisionFlags();
 		return !(flags & btCollisionObject::CF_STATIC_OBJECT)
 			&& !(flags & btCollisionObject::CF_KINEMATIC_OBJECT)
 			;
@@ -678,7 +954,7 @@ struct PhysicsWorldImpl
 
 	bool actor_is_kinematic(ActorInstance actor) const
 	{
-		const int flags = _actor[actor.i].body->getCollisionFlags();
+		const int flags = _actor[actor.i].object->getCollisionFlags();
 		return (flags & btCollisionObject::CF_KINEMATIC_OBJECT) != 0;
 	}
 
@@ -689,93 +965,93 @@ struct PhysicsWorldImpl
 
 	f32 actor_linear_damping(ActorInstance actor) const
 	{
-		return _actor[actor.i].body->getLinearDamping();
+		return actor_body(actor)->getLinearDamping();
 	}
 
 	void actor_set_linear_damping(ActorInstance actor, f32 rate)
 	{
-		_actor[actor.i].body->setDamping(rate, _actor[actor.i].body->getAngularDamping());
+		actor_body(actor)->setDamping(rate, actor_body(actor)->getAngularDamping());
 	}
 
 	f32 actor_angular_damping(ActorInstance actor) const
 	{
-		return _actor[actor.i].body->getAngularDamping();
+		return actor_body(actor)->getAngularDamping();
 	}
 
 	void actor_set_angular_damping(ActorInstance actor, f32 rate)
 	{
-		_actor[actor.i].body->setDamping(_actor[actor.i].body->getLinearDamping(), rate);
+		actor_body(actor)->setDamping(actor_body(actor)->getLinearDamping(), rate);
 	}
 
 	Vector3 actor_linear_velocity(ActorInstance actor) const
 	{
-		btVector3 v = _actor[actor.i].body->getLinearVelocity();
+		btVector3 v = actor_body(actor)->getLinearVelocity();
 		return to_vector3(v);
 	}
 
 	void actor_set_linear_velocity(ActorInstance actor, const Vector3& vel)
 	{
-		_actor[actor.i].body->activate();
-		_actor[actor.i].body->setLinearVelocity(to_btVector3(vel));
+		actor_body(actor)->activate();
+		actor_body(actor)->setLinearVelocity(to_btVector3(vel));
 	}
 
 	Vector3 actor_angular_velocity(ActorInstance actor) const
 	{
-		btVector3 v = _actor[actor.i].body->getAngularVelocity();
+		btVector3 v = actor_body(actor)->getAngularVelocity();
 		return to_vector3(v);
 	}
 
 	void actor_set_angular_velocity(ActorInstance actor, const Vector3& vel)
 	{
-		_actor[actor.i].body->activate();
-		_actor[actor.i].body->setAngularVelocity(to_btVector3(vel));
+		actor_body(actor)->activate();
+		actor_body(actor)->setAngularVelocity(to_btVector3(vel));
 	}
 
 	void actor_add_impulse(ActorInstance actor, const Vector3& impulse)
 	{
-		_actor[actor.i].body->activate();
-		_actor[actor.i].body->applyCentralImpulse(to_btVector3(impulse));
+		actor_body(actor)->activate();
+		actor_body(actor)->applyCentralImpulse(to_btVector3(impulse));
 	}
 
 	void actor_add_impulse_at(ActorInstance actor, const Vector3& impulse, const Vector3& pos)
 	{
-		_actor[actor.i].body->activate();
-		_actor[actor.i].body->applyImpulse(to_btVector3(impulse), to_btVector3(pos));
+		actor_body(actor)->activate();
+		actor_body(actor)->applyImpulse(to_btVector3(impulse), to_btVector3(pos));
 	}
 
 	void actor_add_torque_impulse(ActorInstance actor, const Vector3& imp)
 	{
-		_actor[actor.i].body->applyTorqueImpulse(to_btVector3(imp));
+		actor_body(actor)->applyTorqueImpulse(to_btVector3(imp));
 	}
 
 	void actor_push(ActorInstance actor, const Vector3& vel, f32 mass)
 	{
 		const Vector3 f = vel * mass;
-		_actor[actor.i].body->applyCentralForce(to_btVector3(f));
+		actor_body(actor)->applyCentralForce(to_btVector3(f));
 	}
 
 	void actor_push_at(ActorInstance actor, const Vector3& vel, f32 mass, const Vector3& pos)
 	{
 		const Vector3 f = vel * mass;
-		_actor[actor.i].body->applyForce(to_btVector3(f), to_btVector3(pos));
+		actor_body(actor)->applyForce(to_btVector3(f), to_btVector3(pos));
 	}
 
 	bool actor_is_sleeping(ActorInstance actor)
 	{
-		return !_actor[actor.i].body->isActive();
+		return !_actor[actor.i].object->isActive();
 	}
 
 	void actor_wake_up(ActorInstance actor)
 	{
-		_actor[actor.i].body->activate(true);
+		_actor[actor.i].object->activate(true);
 	}
 
 	JointInstance joint_create(ActorInstance a0, ActorInstance a1, const JointDesc& jd)
 	{
 		const btVector3 anchor_0 = to_btVector3(jd.anchor_0);
 		const btVector3 anchor_1 = to_btVector3(jd.anchor_1);
-		btRigidBody* body_0 = _actor[a0.i].body;
-		btRigidBody* body_1 = is_valid(a1) ? _actor[a1.i].body : NULL;
+		btRigidBody* body_0 = actor_body(a0);
+		btRigidBody* body_1 = is_valid(a1) ? actor_body(a1) : NULL;
 
 		btTypedConstraint* joint = NULL;
 		switch(jd.type)
@@ -854,7 +1130,7 @@ struct PhysicsWorldImpl
 
 		if (cb.hasHit())
 		{
-			const u32 actor_i = (u32)(uintptr_t)btRigidBody::upcast(cb.m_collisionObject)->getUserPointer();
+			const u32 actor_i = (u32)(uintptr_t)cb.m_collisionObject->getUserPointer();
 
 			hit.position = to_vector3(cb.m_hitPointWorld);
 			hit.normal   = to_vector3(cb.m_hitNormalWorld);
@@ -886,7 +1162,7 @@ struct PhysicsWorldImpl
 
 			for (int i = 0; i < num; ++i)
 			{
-				const u32 actor_i = (u32)(uintptr_t)btRigidBody::upcast(cb.m_collisionObjects[i])->getUserPointer();
+				const u32 actor_i = (u32)(uintptr_t)cb.m_collisionObjects[i]->getUserPointer();
 
 				hits[i].position = to_vector3(cb.m_hitPointWorld[i]);
 				hits[i].normal   = to_vector3(cb.m_hitNormalWorld[i]);
@@ -914,7 +1190,7 @@ struct PhysicsWorldImpl
 
 		if (cb.hasHit())
 		{
-			const u32 actor_i = (u32)(uintptr_t)btRigidBody::upcast(cb.m_hitCollisionObject)->getUserPointer();
+			const u32 actor_i = (u32)(uintptr_t)cb.m_hitCollisionObject->getUserPointer();
 
 			hit.position = to_vector3(cb.m_hitPointWorld);
 			hit.normal   = to_vector3(cb.m_hitNormalWorld);
@@ -959,17 +1235,34 @@ struct PhysicsWorldImpl
 
 			const Quaternion rot = rotation(*begin_world);
 			const Vector3 pos = translation(*begin_world);
+			const btTransform tr(to_btQuaternion(rot), to_btVector3(pos));
+
+			if (_actor[ai].body == NULL)
+			{
+				// Triggers follow their units.
+				_actor[ai].object->setWorldTransform(tr);
+				continue;
+			}
+
 			// http://www.bulletphysics.org/mediawiki-1.5.8/index.php/MotionStates
 			btMotionState* ms = _actor[ai].body->getMotionState();
 			if (ms)
-				ms->setWorldTransform(btTransform(to_btQuaternion(rot), to_btVector3(pos)));
+				ms->setWorldTransform(tr);
 		}
 	}
 
 	void update(f32 dt)
 	{
 		// 12Hz to 120Hz
-		_dynamics_world->stepSimulation(dt, 7, 1.0f/60.0f);
+		const int num_steps = _dynamics_world->stepSimulation(dt, 7, 1.0f/60.0f);
+
+		// Contacts and overlaps are only known after a simulation step.
+		if (num_steps > 0)
+		{
+			post_collision_events();
+			post_trigger_events();
+			++_frame;
+		}
 
 		const int num = _dynamics_world->getNumCollisionObjects();
 		const btCollisionObjectArray& collision_array = _dynamics_world->getCollisionObjectArray();
@@ -1026,7 +1319,9 @@ struct PhysicsWorldImpl
 		// Limit bodies velocity
 		for (u32 i = 0; i < array::size(_actor); ++i)
 		{
-			CE_ENSURE(NULL != _actor[i].body);
+			if (_actor[i].body == NULL)
+				continue;
+
 			const btVector3 velocity = _actor[i].body->getLinearVelocity();
 			const btScalar speed = velocity.length();
 
@@ -1034,7 +1329,7 @@ struct PhysicsWorldImpl
 				_actor[i].body->setLinearVelocity(velocity * 100.0f / speed);
 		}
 
-		// Check collisions
+		// Aggregate the contacts of each pair of actors over the substeps
 		int num_manifolds = world->getDispatcher()->getNumManifolds();
 		for (int i = 0; i < num_manifolds; ++i)
 		{
@@ -1044,28 +1339,196 @@ struct PhysicsWorldImpl
 			const btCollisionObject* obj_b = manifold->getBody1();
 			const ActorInstance a0 = make_actor_instance((u32)(uintptr_t)obj_a->getUserPointer());
 			const ActorInstance a1 = make_actor_instance((u32)(uintptr_t)obj_b->getUserPointer());
+			if (!_actor[a0.i].collision_events && !_actor[a1.i].collision_events)
+				continue;
+
 			const UnitId u0 = _actor[a0.i].unit;
 			const UnitId u1 = _actor[a1.i].unit;
 
+			ContactPair* cp = NULL;
 			int num_contacts = manifold->getNumContacts();
 			for (int j = 0; j < num_contacts; ++j)
 			{
 				const btManifoldPoint& pt = manifold->getContactPoint(j);
-				if (pt.m_distance1 < 0.0f)
+				if (pt.m_distance1 >= 0.0f)
+					continue;
+
+				if (cp == NULL)
+					cp = &contact_pair(u0, u1);
+
+				// Normals point from B to A.
+				const Vector3 normal = to_vector3(pt.m_normalWorldOnB);
+				cp->normal += cp->units[0] == u0 ? normal : -normal;
+				cp->impulse += pt.m_appliedImpulse;
+				if (pt.m_distance1 < cp->distance)
+				{
+					cp->position = to_vector3(pt.m_positionWorldOnB);
+					cp->distance = pt.m_distance1;
+				}
+			}
+		}
+	}
+
+	/// Returns the contacts between @a a and @a b in the current frame.
+	ContactPair& contact_pair(UnitId a, UnitId b)
+	{
+		const UnitId u0 = a._idx < b._idx ? a : b;
+		const UnitId u1 = a._idx < b._idx ? b : a;
+		const u64 key = u64(u0._idx) << 32 | u1._idx;
+
+		u32 i = hash_map::get(_pair_map, key, UINT32_MAX);
+		if (i == UINT32_MAX)
+		{
+			ContactPair cp;
+			cp.units[0] = u0;
+			cp.units[1] = u1;
+			cp.frame = _frame - 1;
+			cp.began = false;
+
+			i = array::push_back(_pairs, cp);
+			hash_map::set(_pair_map, key, i);
+		}
+
+		ContactPair& cp = _pairs[i];
+		if (cp.frame != _frame)
+		{
+			cp.position = VECTOR3_ZERO;
+			cp.normal   = VECTOR3_ZERO;
+			cp.distance = 0.0f;
+			cp.impulse  = 0.0f;
+			cp.frame    = _frame;
+		}
+
+		return cp;
+	}
+
+	void contact_pair_remove(u32 i)
+	{
+		const ContactPair& cp = _pairs[i];
+		hash_map::remove(_pair_map, u64(cp.units[0]._idx) << 32 | cp.units[1]._idx);
+
+		const u32 last = array::size(_pairs) - 1;
+		if (i != last)
+		{
+			const ContactPair& lp = _pairs[last];
+			hash_map::set(_pair_map, u64(lp.units[0]._idx) << 32 | lp.units[1]._idx, i);
+			_pairs[i] = lp;
+		}
+
+		array::pop_back(_pairs);
+	}
+
+	void post_collision_event(const ContactPair& cp, PhysicsCollisionEvent::Type type)
+	{
+		PhysicsCollisionEvent ev;
+		ev.type = type;
+		ev.units[0] = cp.units[0];
+		ev.units[1] = cp.units[1];
+		ev.actors[0] = actor(cp.units[0]);
+		ev.actors[1] = actor(cp.units[1]);
+		ev.position = cp.position;
+		ev.normal = cp.normal;
+		if (length_squared(ev.normal) > 0.0f)
+			normalize(ev.normal);
+		ev.distance = cp.distance;
+		ev.impulse = cp.impulse;
+		event_stream::write(_events, EventType::PHYSICS_COLLISION, ev);
+	}
+
+	/// Posts one event for each pair of actors: TOUCH_BEGIN the first
+	/// frame they touch, TOUCHING the following frames and TOUCH_END the
+	/// first frame they do not.
+	void post_collision_events()
+	{
+		for (u32 i = 0; i < array::size(_pairs);)
+		{
+			ContactPair& cp = _pairs[i];
+
+			if (cp.frame != _frame)
+			{
+				post_collision_event(cp, PhysicsCollisionEvent::TOUCH_END);
+				contact_pair_remove(i);
+				continue;
+			}
+
+			post_collision_event(cp, cp.began ? PhysicsCollisionEvent::TOUCHING : PhysicsCollisionEvent::TOUCH_BEGIN);
+			cp.began = true;
+			++i;
+		}
+	}
+
+	void trigger_pair_remove(u32 i)
+	{
+		const TriggerPair& tp = _trigger_pairs[i];
+		hash_map::remove(_trigger_pair_map, u64(tp.trigger._idx) << 32 | tp.other._idx);
+
+		const u32 last = array::size(_trigger_pairs) - 1;
+		if (i != last)
+		{
+			const TriggerPair& lp = _trigger_pairs[last];
+			hash_map::set(_trigger_pair_map, u64(lp.trigger._idx) << 32 | lp.other._idx, i);
+			_trigger_pairs[i] = lp;
+		}
+
+		array::pop_back(_trigger_pairs);
+	}
+
+	void post_trigger_event(const TriggerPair& tp, PhysicsTriggerEvent::Type type)
+	{
+		PhysicsTriggerEvent ev;
+		ev.type = type;
+		ev.trigger_unit = tp.trigger;
+		ev.other_unit = tp.other;
+		ev.trigger = actor(tp.trigger);
+		ev.other = actor(tp.other);
+		event_stream::write(_events, EventType::PHYSICS_TRIGGER, ev);
+	}
+
+	/// Posts TOUCH_BEGIN the first frame an actor overlaps a trigger and
+	/// TOUCH_END the first frame it does not.
+	void post_trigger_events()
+	{
+		for (u32 i = 0; i < array::size(_actor); ++i)
+		{
+			if (_actor[i].body != NULL)
+				continue;
+
+			const btGhostObject* ghost = (btGhostObject*)_actor[i].object;
+			const UnitId trigger = _actor[i].unit;
+
+			for (int j = 0; j < ghost->getNumOverlappingObjects(); ++j)
+			{
+				const u32 other_i = (u32)(uintptr_t)ghost->getOverlappingObject(j)->getUserPointer();
+				const UnitId other = _actor[other_i].unit;
+				const u64 key = u64(trigger._idx) << 32 | other._idx;
+
+				const u32 tp_i = hash_map::get(_trigger_pair_map, key, UINT32_MAX);
+				if (tp_i != UINT32_MAX)
 				{
-					// Post collision event
-					PhysicsCollisionEvent ev;
-					ev.type = pt.m_lifeTime == 1 ? PhysicsCollisionEvent::TOUCH_BEGIN : PhysicsCollisionEvent::TOUCHING;
-					ev.units[0] = u0;
-					ev.units[1] = u1;
-					ev.actors[0] = a0;
-					ev.actors[1] = a1;
-					ev.position = to_vector3(pt.m_positionWorldOnB);
-					ev.normal = to_vector3(pt.m_normalWorldOnB);
-					ev.distance = pt.m_distance1;
-					event_stream::write(_events, EventType::PHYSICS_COLLISION, ev);
+					_trigger_pairs[tp_i].frame = _frame;
+					continue;
 				}
+
+				TriggerPair tp;
+				tp.trigger = trigger;
+				tp.other = other;
+				tp.frame = _frame;
+
+				hash_map::set(_trigger_pair_map, key, array::push_back(_trigger_pairs, tp));
+				post_trigger_event(tp, PhysicsTriggerEvent::TOUCH_BEGIN);
+			}
+		}
+
+		for (u32 i = 0; i < array::size(_trigger_pairs);)
+		{
+			if (_trigger_pairs[i].frame != _frame)
+			{
+				post_trigger_event(_trigger_pairs[i], PhysicsTriggerEvent::TOUCH_END);
+				trigger_pair_remove(i);
+				continue;
 			}
+
+			++i;
 		}
 	}
 
@@ -1210,6 +1673,16 @@ void PhysicsWorld::actor_disable_collision(ActorInstance actor)
 	_impl->actor_disable_collision(actor);
 }
 
+void PhysicsWorld::actor_enable_collision_events(ActorInstance actor)
+{
+	_impl->actor_enable_collision_events(actor);
+}
+
+void PhysicsWorld::actor_disable_collision_events(ActorInstance actor)
+{
+	_impl->actor_disable_collision_events(actor);
+}
+
 void PhysicsWorld::actor_set_collision_filter(ActorInstance actor, StringId32 filter)
 {
 	_impl->actor_set_collision_filter(actor, filter);
@@ -120,6 +120,14 @@ struct PhysicsWorldImpl
 	{
 	}
 
+	void actor_enable_collision_events(ActorInstance /*actor*/)
+	{
+	}
+
+	void actor_disable_collision_events(ActorInstance /*actor*/)
+	{
+	}
+
 	void actor_set_collision_filter(ActorInstance /*actor*/, StringId32 /*filter*/)
 	{
 	}
@@ -381,6 +389,16 @@ void PhysicsWorld::actor_disable_collision(ActorInstance actor)
 	_impl->actor_disable_collision(actor);
 }
 
+void PhysicsWorld::actor_enable_collision_events(ActorInstance actor)
+{
+	_impl->actor_enable_collision_events(actor);
+}
+
+void PhysicsWorld::actor_disable_collision_events(ActorInstance actor)
+{
+	_impl->actor_disable_collision_events(actor);
+}
+
 void PhysicsWorld::actor_set_collision_filter(ActorInstance actor, StringId32 filter)
 {
 	_impl->actor_set_collision_filter(actor, filter);
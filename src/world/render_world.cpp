@@ -6,12 +6,20 @@
 #include "core/containers/array.inl"
 #include "core/containers/hash_map.inl"
 #include "core/list.inl"
-#include "core/math/aabb.h"
+#include "core/math/aabb.inl"
 #include "core/math/color4.inl"
 #include "core/math/constants.h"
+#include "core/math/frustum.inl"
 #include "core/math/intersection.h"
+#include "core/math/math.h"
 #include "core/math/matrix4x4.inl"
+#include "core/math/vector3.inl"
+#include "core/memory/temp_allocator.inl"
+#include "core/strings/string_id.inl"
+#include "core/thread/job_system.h"
 #include "device/pipeline.h"
+#include "device/profiler.h"
+#include "resource/material_resource.h"
 #include "resource/mesh_resource.h"
 #include "resource/resource_manager.h"
 #include "resource/sprite_resource.h"
@@ -19,8 +27,11 @@
 #include "world/material.h"
 #include "world/material_manager.h"
 #include "world/render_world.h"
+#include "world/shader_manager.h"
 #include "world/unit_manager.h"
+#include <algorithm>
 #include <bgfx/bgfx.h>
+#include <float.h> // FLT_MAX
 
 namespace crown
 {
@@ -29,6 +40,34 @@ static void unit_destroyed_callback_bridge(UnitId unit, void* user_ptr)
 	((RenderWorld*)user_ptr)->unit_destroyed_callback(unit);
 }
 
+/// Returns the sort key of a draw call. From the most to the least
+/// significant bits: view (8), program (9), material (16), vertex buffer
+/// (12), index buffer (12) and depth (7).
+static u64 render_key(u8 view
+	, bgfx::ProgramHandle program
+	, u16 material
+	, bgfx::VertexBufferHandle vbh
+	, bgfx::IndexBufferHandle ibh
+	, u32 depth
+	)
+{
+	return (u64(view)                 << 56)
+		| (u64(program.idx & 0x1ff)   << 47)
+		| (u64(material)              << 31)
+		| (u64(vbh.idx & 0xfff)       << 19)
+		| (u64(ibh.idx & 0xfff)       <<  7)
+		| (u64(min(depth, 0x7fu)))
+		;
+}
+
+static AABB world_box(const OBB& obb, const Matrix4x4& world)
+{
+	AABB box;
+	box.min = -obb.half_extents;
+	box.max = obb.half_extents;
+	return aabb::transformed(box, obb.tm * world);
+}
+
 RenderWorld::RenderWorld(Allocator& a, ResourceManager& rm, ShaderManager& sm, MaterialManager& mm, UnitManager& um)
 	: _marker(RENDER_WORLD_MARKER)
 	, _allocator(&a)
@@ -37,9 +76,14 @@ RenderWorld::RenderWorld(Allocator& a, ResourceManager& rm, ShaderManager& sm, M
 	, _material_manager(&mm)
 	, _unit_manager(&um)
 	, _debug_drawing(false)
+	, _instancing(false)
 	, _mesh_manager(a)
 	, _sprite_manager(a)
 	, _light_manager(a)
+	, _visible_meshes(a)
+	, _visible_sprites(a)
+	, _mesh_keys(a)
+	, _mesh_batches(a)
 {
 	_unit_destroy_callback.destroy = unit_destroyed_callback_bridge;
 	_unit_destroy_callback.user_data = this;
@@ -47,22 +91,18 @@ RenderWorld::RenderWorld(Allocator& a, ResourceManager& rm, ShaderManager& sm, M
 	_unit_destroy_callback.node.prev = NULL;
 	um.register_destroy_callback(&_unit_destroy_callback);
 
-	_u_light_position  = bgfx::createUniform("u_light_position", bgfx::UniformType::Vec4);
-	_u_light_direction = bgfx::createUniform("u_light_direction", bgfx::UniformType::Vec4);
-	_u_light_color     = bgfx::createUniform("u_light_color", bgfx::UniformType::Vec4);
-	_u_light_range     = bgfx::createUniform("u_light_range", bgfx::UniformType::Vec4);
-	_u_light_intensity = bgfx::createUniform("u_light_intensity", bgfx::UniformType::Vec4);
+	_u_lights     = bgfx::createUniform("u_lights", bgfx::UniformType::Vec4, 3*CROWN_MAX_LIGHTS);
+	_u_lights_num = bgfx::createUniform("u_lights_num", bgfx::UniformType::Vec4);
+	_u_mesh_decode = bgfx::createUniform("u_mesh_decode", bgfx::UniformType::Vec4, 2);
 }
 
 RenderWorld::~RenderWorld()
 {
 	_unit_manager->unregister_destroy_callback(&_unit_destroy_callback);
 
-	bgfx::destroy(_u_light_intensity);
-	bgfx::destroy(_u_light_range);
-	bgfx::destroy(_u_light_color);
-	bgfx::destroy(_u_light_direction);
-	bgfx::destroy(_u_light_position);
+	bgfx::destroy(_u_mesh_decode);
+	bgfx::destroy(_u_lights_num);
+	bgfx::destroy(_u_lights);
 
 	_mesh_manager.destroy();
 	_sprite_manager.destroy();
@@ -74,8 +114,8 @@ RenderWorld::~RenderWorld()
 MeshInstance RenderWorld::mesh_create(UnitId unit, const MeshRendererDesc& mrd, const Matrix4x4& tr)
 {
 	const MeshResource* mr = (const MeshResource*)_resource_manager->get(RESOURCE_TYPE_MESH, mrd.mesh_resource);
-	_material_manager->create_material(mrd.material_resource);
-	return _mesh_manager.create(unit, mr, mrd, tr);
+	Material* mat = _material_manager->create_material(mrd.material_resource);
+	return _mesh_manager.create(unit, mr, mat, mrd, tr);
 }
 
 void RenderWorld::mesh_destroy(MeshInstance mesh)
@@ -92,14 +132,13 @@ MeshInstance RenderWorld::mesh_instance(UnitId unit)
 Material* RenderWorld::mesh_material(MeshInstance mesh)
 {
 	CE_ASSERT(mesh.i < _mesh_manager._data.size, "Index out of bounds");
-	return _material_manager->get(_mesh_manager._data.material[mesh.i]);
+	return _mesh_manager._data.material[mesh.i];
 }
 
 void RenderWorld::mesh_set_material(MeshInstance mesh, StringId64 id)
 {
 	CE_ASSERT(mesh.i < _mesh_manager._data.size, "Index out of bounds");
-	_material_manager->create_material(id);
-	_mesh_manager._data.material[mesh.i] = id;
+	_mesh_manager._data.material[mesh.i] = _material_manager->create_material(id);
 }
 
 void RenderWorld::mesh_set_visible(MeshInstance mesh, bool visible)
@@ -126,11 +165,35 @@ f32 RenderWorld::mesh_cast_ray(MeshInstance mesh, const Vector3& from, const Vec
 {
 	CE_ASSERT(mesh.i < _mesh_manager._data.size, "Index out of bounds");
 	const MeshGeometry* mg = _mesh_manager._data.geometry[mesh.i];
+
+	const void* vertices = mg->vertices.data;
+	u32 stride = mg->vertices.stride;
+
+	Array<Vector3> positions(default_allocator());
+	if (mg->vertices.compression != VertexCompression::NONE)
+	{
+		mesh_resource::decode_positions(positions, *mg);
+		vertices = array::begin(positions);
+		stride = sizeof(Vector3);
+	}
+
+	if (mg->indices.stride == sizeof(u32))
+	{
+		return ray_mesh_intersection(from
+			, dir
+			, _mesh_manager._data.world[mesh.i]
+			, vertices
+			, stride
+			, (u32*)mg->indices.data
+			, mg->indices.num
+			);
+	}
+
 	return ray_mesh_intersection(from
 		, dir
 		, _mesh_manager._data.world[mesh.i]
-		, mg->vertices.data
-		, mg->vertices.stride
+		, vertices
+		, stride
 		, (u16*)mg->indices.data
 		, mg->indices.num
 		);
@@ -139,8 +202,8 @@ f32 RenderWorld::mesh_cast_ray(MeshInstance mesh, const Vector3& from, const Vec
 SpriteInstance RenderWorld::sprite_create(UnitId unit, const SpriteRendererDesc& srd, const Matrix4x4& tr)
 {
 	const SpriteResource* sr = (const SpriteResource*)_resource_manager->get(RESOURCE_TYPE_SPRITE, srd.sprite_resource);
-	_material_manager->create_material(srd.material_resource);
-	return _sprite_manager.create(unit, sr, srd, tr);
+	Material* mat = _material_manager->create_material(srd.material_resource);
+	return _sprite_manager.create(unit, sr, mat, srd, tr);
 }
 
 void RenderWorld::sprite_destroy(SpriteInstance sprite)
@@ -157,14 +220,13 @@ SpriteInstance RenderWorld::sprite_instance(UnitId unit)
 Material* RenderWorld::sprite_material(SpriteInstance sprite)
 {
 	CE_ASSERT(sprite.i < _sprite_manager._data.size, "Index out of bounds");
-	return _material_manager->get(_sprite_manager._data.material[sprite.i]);
+	return _sprite_manager._data.material[sprite.i];
 }
 
 void RenderWorld::sprite_set_material(SpriteInstance sprite, StringId64 id)
 {
 	CE_ASSERT(sprite.i < _sprite_manager._data.size, "Index out of bounds");
-	_material_manager->create_material(id);
-	_sprite_manager._data.material[sprite.i] = id;
+	_sprite_manager._data.material[sprite.i] = _material_manager->create_material(id);
 }
 
 void RenderWorld::sprite_set_frame(SpriteInstance sprite, u32 index)
@@ -333,65 +395,166 @@ void RenderWorld::light_debug_draw(LightInstance light, DebugLine& dl)
 	_light_manager.debug_draw(light.i, 1, dl);
 }
 
-void RenderWorld::update_transforms(const UnitId* begin, const UnitId* end, const Matrix4x4* world)
+struct UpdateTransformsData
 {
-	MeshManager::MeshInstanceData& mid = _mesh_manager._data;
-	SpriteManager::SpriteInstanceData& sid = _sprite_manager._data;
-	LightManager::LightInstanceData& lid = _light_manager._data;
+	RenderWorld* render_world;
+	const UnitId* begin;
+	const UnitId* end;
+	const Matrix4x4* world;
+};
+
+static void update_mesh_transforms(void* user_data)
+{
+	ENTER_PROFILE_SCOPE("render_world.update_mesh_transforms");
 
-	for (; begin != end; ++begin, ++world)
+	UpdateTransformsData* utd = (UpdateTransformsData*)user_data;
+	RenderWorld::MeshManager& mm = utd->render_world->_mesh_manager;
+
+	const Matrix4x4* world = utd->world;
+	for (const UnitId* cur = utd->begin; cur != utd->end; ++cur, ++world)
 	{
-		if (_mesh_manager.has(*begin))
+		const u32 mesh = mm._map.get(*cur);
+		if (mesh != UINT32_MAX)
 		{
-			MeshInstance mesh = _mesh_manager.mesh(*begin);
-			mid.world[mesh.i] = *world;
+			mm._data.world[mesh] = *world;
+			mm.update_proxy(mesh);
 		}
+	}
 
-		if (_sprite_manager.has(*begin))
-		{
-			SpriteInstance sprite = _sprite_manager.sprite(*begin);
-			sid.world[sprite.i] = *world;
-		}
+	LEAVE_PROFILE_SCOPE();
+}
 
-		if (_light_manager.has(*begin))
+static void update_sprite_transforms(void* user_data)
+{
+	ENTER_PROFILE_SCOPE("render_world.update_sprite_transforms");
+
+	UpdateTransformsData* utd = (UpdateTransformsData*)user_data;
+	RenderWorld::SpriteManager& sm = utd->render_world->_sprite_manager;
+
+	const Matrix4x4* world = utd->world;
+	for (const UnitId* cur = utd->begin; cur != utd->end; ++cur, ++world)
+	{
+		const u32 sprite = sm._map.get(*cur);
+		if (sprite != UINT32_MAX)
 		{
-			LightInstance light = _light_manager.light(*begin);
-			lid.world[light.i] = *world;
+			sm._data.world[sprite] = *world;
+			sm.update_proxy(sprite);
 		}
 	}
+
+	LEAVE_PROFILE_SCOPE();
+}
+
+static void update_light_transforms(void* user_data)
+{
+	ENTER_PROFILE_SCOPE("render_world.update_light_transforms");
+
+	UpdateTransformsData* utd = (UpdateTransformsData*)user_data;
+	RenderWorld::LightManager& lm = utd->render_world->_light_manager;
+
+	const Matrix4x4* world = utd->world;
+	for (const UnitId* cur = utd->begin; cur != utd->end; ++cur, ++world)
+	{
+		const u32 light = lm._map.get(*cur);
+		if (light != UINT32_MAX)
+			lm._data.world[light] = *world;
+	}
+
+	LEAVE_PROFILE_SCOPE();
+}
+
+void RenderWorld::update_transforms(const UnitId* begin, const UnitId* end, const Matrix4x4* world)
+{
+	// Each manager only touches its own data, so they can be synced in parallel.
+	UpdateTransformsData utd;
+	utd.render_world = this;
+	utd.begin = begin;
+	utd.end = end;
+	utd.world = world;
+
+	const Job jobs[] =
+	{
+		{ update_mesh_transforms,   &utd },
+		{ update_sprite_transforms, &utd },
+		{ update_light_transforms,  &utd }
+	};
+
+	JobCounter counter;
+	job_system::run(jobs, countof(jobs), counter);
+	job_system::wait(counter);
 }
 
-void RenderWorld::render(const Matrix4x4& view)
+void RenderWorld::render(const Matrix4x4& view, const Matrix4x4& proj)
 {
 	MeshManager::MeshInstanceData& mid = _mesh_manager._data;
 	SpriteManager::SpriteInstanceData& sid = _sprite_manager._data;
-	LightManager::LightInstanceData& lid = _light_manager._data;
 
-	for (u32 ll = 0; ll < lid.size; ++ll)
-	{
-		const Vector4 ldir = normalize(lid.world[ll].z) * view;
-		const Vector3 lpos = translation(lid.world[ll]);
+	Frustum f;
+	frustum::from_matrix(f, view * proj);
+
+	array::clear(_visible_meshes);
+	array::clear(_visible_sprites);
+	_mesh_manager._culling_grid.cull(_visible_meshes, f, mid.first_hidden);
+	_sprite_manager._culling_grid.cull(_visible_sprites, f, sid.first_hidden);
+
+	const u32 num_meshes = array::size(_visible_meshes);
+	const u32 num_sprites = array::size(_visible_sprites);
+	RECORD_FLOAT("render_world.meshes_submitted", f32(num_meshes));
+	RECORD_FLOAT("render_world.meshes_culled", f32(mid.first_hidden - num_meshes));
+	RECORD_FLOAT("render_world.sprites_submitted", f32(num_sprites));
+	RECORD_FLOAT("render_world.sprites_culled", f32(sid.first_hidden - num_sprites));
+
+	const bool instancing = _instancing && (bgfx::getCaps()->supported & BGFX_CAPS_INSTANCING) != 0;
+	batch_meshes(view, instancing);
 
-		bgfx::setUniform(_u_light_position, to_float_ptr(lpos));
-		bgfx::setUniform(_u_light_direction, to_float_ptr(ldir));
-		bgfx::setUniform(_u_light_color, to_float_ptr(lid.color[ll]));
-		bgfx::setUniform(_u_light_range, &lid.range[ll]);
-		bgfx::setUniform(_u_light_intensity, &lid.intensity[ll]);
+	const u32 num_batches = array::size(_mesh_batches);
+	RECORD_FLOAT("render_world.mesh_batches", f32(num_batches));
 
-		// Render meshes
-		for (u32 i = 0; i < mid.first_hidden; ++i)
+	const u32 num_lights = pack_lights(view, f);
+	RECORD_FLOAT("render_world.lights_submitted", f32(num_lights));
+
+	const Vector4 lights_num = { f32(num_lights), 0.0f, 0.0f, 0.0f };
+	if (num_lights > 0)
+		bgfx::setUniform(_u_lights, _lights_data, 3*num_lights);
+	bgfx::setUniform(_u_lights_num, to_float_ptr(lights_num));
+
+	// Render meshes
+	for (u32 bb = 0; bb < num_batches; ++bb)
+	{
+		const MeshBatch& batch = _mesh_batches[bb];
+		const u32 i = _visible_meshes[batch.first];
+		const VertexData& vd = mid.geometry[i]->vertices;
+
+		// Must match the decoding in the mesh shaders.
+		const Vector4 mesh_decode[] =
 		{
+			{ vd.position_scale.x, vd.position_scale.y, vd.position_scale.z, f32(vd.compression) },
+			{ vd.position_offset.x, vd.position_offset.y, vd.position_offset.z, 0.0f }
+		};
+		bgfx::setUniform(_u_mesh_decode, mesh_decode, countof(mesh_decode));
+
+		bgfx::setVertexBuffer(0, mid.mesh[i].vbh);
+		bgfx::setIndexBuffer(mid.mesh[i].ibh);
+
+		if (batch.num > 1)
+			bgfx::setInstanceDataBuffer(&batch.idb);
+		else
 			bgfx::setTransform(to_float_ptr(mid.world[i]));
-			bgfx::setVertexBuffer(0, mid.mesh[i].vbh);
-			bgfx::setIndexBuffer(mid.mesh[i].ibh);
 
-			_material_manager->get(mid.material[i])->bind(*_resource_manager, *_shader_manager, VIEW_MESH);
-		}
+		mid.material[i]->bind(VIEW_MESH, 0, batch.num > 1);
 	}
 
 	// Render sprites
-	if (sid.first_hidden)
+	if (num_sprites)
 	{
+		// Sprites use the fallback shader when their material is missing.
+		const Vector4 mesh_decode_none[] =
+		{
+			{ 1.0f, 1.0f, 1.0f, 0.0f },
+			{ 0.0f, 0.0f, 0.0f, 0.0f }
+		};
+		bgfx::setUniform(_u_mesh_decode, mesh_decode_none, countof(mesh_decode_none));
+
 		bgfx::VertexLayout layout;
 		layout.begin()
 			.add(bgfx::Attrib::Position,  3, bgfx::AttribType::Float)
@@ -399,16 +562,17 @@ void RenderWorld::render(const Matrix4x4& view)
 			.end()
 			;
 		bgfx::TransientVertexBuffer tvb;
-		bgfx::allocTransientVertexBuffer(&tvb, 4*sid.first_hidden, layout);
+		bgfx::allocTransientVertexBuffer(&tvb, 4*num_sprites, layout);
 		bgfx::TransientIndexBuffer tib;
-		bgfx::allocTransientIndexBuffer(&tib, 6*sid.first_hidden);
+		bgfx::allocTransientIndexBuffer(&tib, 6*num_sprites);
 
 		f32* vdata = (f32*)tvb.data;
 		u16* idata = (u16*)tib.data;
 
 		// Render sprites
-		for (u32 i = 0; i < sid.first_hidden; ++i)
+		for (u32 ss = 0; ss < num_sprites; ++ss)
 		{
+			const u32 i = _visible_sprites[ss];
 			const f32* frame = sprite_resource::frame_data(sid.resource[i], sid.frame[i] % sid.resource[i]->num_frames);
 
 			f32 u0 = frame[ 3]; // u
@@ -463,24 +627,175 @@ void RenderWorld::render(const Matrix4x4& view)
 
 			vdata += 20;
 
-			*idata++ = i*4+0;
-			*idata++ = i*4+1;
-			*idata++ = i*4+2;
-			*idata++ = i*4+0;
-			*idata++ = i*4+2;
-			*idata++ = i*4+3;
+			*idata++ = ss*4+0;
+			*idata++ = ss*4+1;
+			*idata++ = ss*4+2;
+			*idata++ = ss*4+0;
+			*idata++ = ss*4+2;
+			*idata++ = ss*4+3;
 
 			bgfx::setTransform(to_float_ptr(sid.world[i]));
 			bgfx::setVertexBuffer(0, &tvb);
-			bgfx::setIndexBuffer(&tib, i*6, 6);
+			bgfx::setIndexBuffer(&tib, ss*6, 6);
+
+			sid.material[i]->bind(sid.layer[i] + VIEW_SPRITE_0, sid.depth[i]);
+		}
+	}
+}
+
+void RenderWorld::batch_meshes(const Matrix4x4& view, bool instancing)
+{
+	MeshManager::MeshInstanceData& mid = _mesh_manager._data;
+	const u32 num_meshes = array::size(_visible_meshes);
+
+	array::clear(_mesh_batches);
+
+	// Sort the draw calls to minimize state changes and to make meshes
+	// sharing the same geometry and material adjacent.
+	array::resize(_mesh_keys, num_meshes);
+	for (u32 mm = 0; mm < num_meshes; ++mm)
+	{
+		const u32 i = _visible_meshes[mm];
+		const f32 z = (translation(mid.world[i]) * view).z;
+
+		_mesh_keys[mm].key = render_key(VIEW_MESH
+			, mid.material[i]->_program
+			, mid.material[i]->_id
+			, mid.mesh[i].vbh
+			, mid.mesh[i].ibh
+			, u32(fsqrt(max(z, 0.0f)))
+			);
+		_mesh_keys[mm].index = i;
+	}
+
+	std::sort(array::begin(_mesh_keys), array::end(_mesh_keys));
+
+	for (u32 mm = 0; mm < num_meshes; ++mm)
+		_visible_meshes[mm] = _mesh_keys[mm].index;
+
+	for (u32 mm = 0; mm < num_meshes;)
+	{
+		const u32 i = _visible_meshes[mm];
+
+		// Find the meshes sharing the same geometry and material.
+		u32 num = 1;
+		while (instancing
+			&& mm + num < num_meshes
+			&& mid.mesh[_visible_meshes[mm + num]].vbh.idx == mid.mesh[i].vbh.idx
+			&& mid.mesh[_visible_meshes[mm + num]].ibh.idx == mid.mesh[i].ibh.idx
+			&& mid.material[_visible_meshes[mm + num]] == mid.material[i]
+			)
+		{
+			++num;
+		}
+
+		const u16 stride = sizeof(Matrix4x4);
+
+		if (num > 1
+			&& bgfx::isValid(mid.material[i]->_program_instanced)
+			&& bgfx::getAvailInstanceDataBuffer(num, stride) == num
+			)
+		{
+			MeshBatch batch;
+			batch.first = mm;
+			batch.num = num;
+			bgfx::allocInstanceDataBuffer(&batch.idb, num, stride);
+
+			Matrix4x4* data = (Matrix4x4*)batch.idb.data;
+			for (u32 ii = 0; ii < num; ++ii)
+				data[ii] = mid.world[_visible_meshes[mm + ii]];
+
+			array::push_back(_mesh_batches, batch);
+		}
+		else
+		{
+			for (u32 ii = 0; ii < num; ++ii)
+			{
+				MeshBatch batch;
+				batch.first = mm + ii;
+				batch.num = 1;
+				array::push_back(_mesh_batches, batch);
+			}
+		}
+
+		mm += num;
+	}
+}
+
+struct LightSortKey
+{
+	f32 key;
+	u32 index;
+
+	bool operator<(const LightSortKey& other) const
+	{
+		return key < other.key;
+	}
+};
+
+u32 RenderWorld::pack_lights(const Matrix4x4& view, const Frustum& f)
+{
+	LightManager::LightInstanceData& lid = _light_manager._data;
+
+	// Gather the lights that can affect something in the frustum. Directional
+	// lights always do and sort first; local lights are ranked by how close
+	// their volume gets to the camera.
+	TempAllocator4096 ta;
+	Array<LightSortKey> lights(ta);
+	for (u32 ll = 0; ll < lid.size; ++ll)
+	{
+		LightSortKey lsk;
+		lsk.index = ll;
+
+		if (lid.type[ll] == LightType::DIRECTIONAL)
+		{
+			lsk.key = -FLT_MAX;
+		}
+		else
+		{
+			Sphere s;
+			s.c = translation(lid.world[ll]);
+			s.r = lid.range[ll];
+			if (s.r <= 0.0f || !frustum_sphere_intersection(f, s))
+				continue;
 
-			_material_manager->get(sid.material[i])->bind(*_resource_manager
-				, *_shader_manager
-				, sid.layer[i] + VIEW_SPRITE_0
-				, sid.depth[i]
-				);
+			lsk.key = length(s.c * view) - s.r;
 		}
+
+		array::push_back(lights, lsk);
+	}
+
+	u32 num_lights = array::size(lights);
+	if (num_lights > CROWN_MAX_LIGHTS)
+	{
+		std::sort(array::begin(lights), array::end(lights));
+		num_lights = CROWN_MAX_LIGHTS;
+	}
+
+	for (u32 nn = 0; nn < num_lights; ++nn)
+	{
+		const u32 ll = lights[nn].index;
+		const LightType::Enum type = (LightType::Enum)lid.type[ll];
+		const Vector3 pos = translation(lid.world[ll]) * view;
+		const Vector4 dir = normalize(lid.world[ll].z) * view;
+		const Color4 col = lid.color[ll];
+
+		Vector4* data = &_lights_data[3*nn];
+		data[0].x = pos.x;
+		data[0].y = pos.y;
+		data[0].z = pos.z;
+		data[0].w = type == LightType::DIRECTIONAL ? 0.0f : lid.range[ll];
+		data[1].x = dir.x;
+		data[1].y = dir.y;
+		data[1].z = dir.z;
+		data[1].w = type == LightType::SPOT ? fcos(lid.spot_angle[ll]) : -1.0f;
+		data[2].x = col.x;
+		data[2].y = col.y;
+		data[2].z = col.z;
+		data[2].w = lid.intensity[ll];
 	}
+
+	return num_lights;
 }
 
 void RenderWorld::debug_draw(DebugLine& dl)
@@ -505,6 +820,11 @@ void RenderWorld::enable_debug_drawing(bool enable)
 	_debug_drawing = enable;
 }
 
+void RenderWorld::enable_instancing(bool enable)
+{
+	_instancing = enable;
+}
+
 void RenderWorld::unit_destroyed_callback(UnitId unit)
 {
 	{
@@ -529,6 +849,208 @@ void RenderWorld::unit_destroyed_callback(UnitId unit)
 	}
 }
 
+RenderWorld::UnitIndexMap::UnitIndexMap(Allocator& a)
+	: _index(a)
+{
+}
+
+u32 RenderWorld::UnitIndexMap::get(UnitId unit) const
+{
+	const u32 idx = unit.index();
+	if (idx < array::size(_index) && _index[idx].unit == unit)
+		return _index[idx].i;
+
+	return UINT32_MAX;
+}
+
+void RenderWorld::UnitIndexMap::set(UnitId unit, u32 i)
+{
+	const u32 idx = unit.index();
+	const u32 size = array::size(_index);
+
+	if (idx >= size)
+	{
+		array::resize(_index, idx + 1);
+		for (u32 ii = size; ii < idx; ++ii)
+		{
+			_index[ii].unit._idx = UINT32_MAX;
+			_index[ii].i = UINT32_MAX;
+		}
+	}
+
+	_index[idx].unit = unit;
+	_index[idx].i = i;
+}
+
+void RenderWorld::UnitIndexMap::remove(UnitId unit)
+{
+	const u32 idx = unit.index();
+	if (idx < array::size(_index) && _index[idx].unit == unit)
+	{
+		_index[idx].unit._idx = UINT32_MAX;
+		_index[idx].i = UINT32_MAX;
+	}
+}
+
+RenderWorld::CullingGrid::CullingGrid(Allocator& a, f32 cell_size)
+	: _cell_size(cell_size)
+	, _free_proxy(UINT32_MAX)
+	, _proxies(a)
+	, _cells(a)
+	, _cell_map(a)
+{
+	// Cell 0 holds the boxes too big to fit any other cell.
+	Cell c;
+	aabb::reset(c.bounds);
+	c.first = UINT32_MAX;
+	c.num = 0;
+	array::push_back(_cells, c);
+}
+
+u32 RenderWorld::CullingGrid::create(u32 owner, const AABB& box)
+{
+	u32 proxy = _free_proxy;
+
+	if (proxy != UINT32_MAX)
+	{
+		_free_proxy = _proxies[proxy].next;
+	}
+	else
+	{
+		Proxy p;
+		aabb::reset(p.box);
+		p.owner = UINT32_MAX;
+		p.cell = UINT32_MAX;
+		p.prev = UINT32_MAX;
+		p.next = UINT32_MAX;
+		proxy = array::push_back(_proxies, p);
+	}
+
+	_proxies[proxy].box   = box;
+	_proxies[proxy].owner = owner;
+	link(proxy, cell(box));
+	return proxy;
+}
+
+void RenderWorld::CullingGrid::destroy(u32 proxy)
+{
+	unlink(proxy);
+	_proxies[proxy].cell = UINT32_MAX;
+	_proxies[proxy].next = _free_proxy;
+	_free_proxy = proxy;
+}
+
+void RenderWorld::CullingGrid::move(u32 proxy, const AABB& box)
+{
+	const u32 c = cell(box);
+
+	_proxies[proxy].box = box;
+
+	if (c != _proxies[proxy].cell)
+	{
+		unlink(proxy);
+		link(proxy, c);
+	}
+}
+
+void RenderWorld::CullingGrid::set_owner(u32 proxy, u32 owner)
+{
+	_proxies[proxy].owner = owner;
+}
+
+void RenderWorld::CullingGrid::cull(Array<u32>& owners, const Frustum& f, u32 num_owners)
+{
+	for (u32 cc = 0; cc < array::size(_cells); ++cc)
+	{
+		const Cell& c = _cells[cc];
+
+		if (c.num == 0)
+			continue;
+
+		if (cc != 0 && !frustum_box_intersection(f, c.bounds))
+			continue;
+
+		for (u32 pp = c.first; pp != UINT32_MAX; pp = _proxies[pp].next)
+		{
+			const Proxy& p = _proxies[pp];
+
+			if (p.owner < num_owners && frustum_box_intersection(f, p.box))
+				array::push_back(owners, p.owner);
+		}
+	}
+}
+
+u32 RenderWorld::CullingGrid::cell(const AABB& box)
+{
+	const Vector3 center = aabb::center(box);
+	const Vector3 half_extents = box.max - center;
+	const f32 half_size = _cell_size * 0.5f;
+
+	if (half_extents.x > half_size || half_extents.y > half_size || half_extents.z > half_size)
+		return 0;
+
+	const s32 x = (s32)ffloor(center.x / _cell_size);
+	const s32 y = (s32)ffloor(center.y / _cell_size);
+	const s32 z = (s32)ffloor(center.z / _cell_size);
+
+	const u64 key = 0
+		| (u64(u32(x) & 0x1fffff) << 42)
+		| (u64(u32(y) & 0x1fffff) << 21)
+		| (u64(u32(z) & 0x1fffff) <<  0)
+		;
+
+	u32 c = hash_map::get(_cell_map, key, UINT32_MAX);
+	if (c == UINT32_MAX)
+	{
+		Cell cell;
+		cell.bounds.min.x = f32(x + 0)*_cell_size - half_size;
+		cell.bounds.min.y = f32(y + 0)*_cell_size - half_size;
+		cell.bounds.min.z = f32(z + 0)*_cell_size - half_size;
+		cell.bounds.max.x = f32(x + 1)*_cell_size + half_size;
+		cell.bounds.max.y = f32(y + 1)*_cell_size + half_size;
+		cell.bounds.max.z = f32(z + 1)*_cell_size + half_size;
+		cell.first = UINT32_MAX;
+		cell.num = 0;
+
+		c = array::push_back(_cells, cell);
+		hash_map::set(_cell_map, key, c);
+	}
+
+	return c;
+}
+
+void RenderWorld::CullingGrid::link(u32 proxy, u32 cell)
+{
+	Cell& c = _cells[cell];
+	Proxy& p = _proxies[proxy];
+
+	p.cell = cell;
+	p.prev = UINT32_MAX;
+	p.next = c.first;
+
+	if (c.first != UINT32_MAX)
+		_proxies[c.first].prev = proxy;
+
+	c.first = proxy;
+	++c.num;
+}
+
+void RenderWorld::CullingGrid::unlink(u32 proxy)
+{
+	Proxy& p = _proxies[proxy];
+	Cell& c = _cells[p.cell];
+
+	if (p.prev != UINT32_MAX)
+		_proxies[p.prev].next = p.next;
+	else
+		c.first = p.next;
+
+	if (p.next != UINT32_MAX)
+		_proxies[p.next].prev = p.prev;
+
+	--c.num;
+}
+
 void RenderWorld::MeshManager::allocate(u32 num)
 {
 	CE_ENSURE(num > _data.size);
@@ -538,9 +1060,10 @@ void RenderWorld::MeshManager::allocate(u32 num)
 		+ num*sizeof(MeshResource*) + alignof(MeshResource*)
 		+ num*sizeof(MeshGeometry*) + alignof(MeshGeometry*)
 		+ num*sizeof(MeshData) + alignof(MeshData)
-		+ num*sizeof(StringId64) + alignof(StringId64)
+		+ num*sizeof(Material*) + alignof(Material*)
 		+ num*sizeof(Matrix4x4) + alignof(Matrix4x4)
 		+ num*sizeof(OBB) + alignof(OBB)
+		+ num*sizeof(u32) + alignof(u32)
 		;
 
 	MeshInstanceData new_data;
@@ -553,17 +1076,19 @@ void RenderWorld::MeshManager::allocate(u32 num)
 	new_data.resource      = (const MeshResource**)memory::align_top(new_data.unit + num,     alignof(MeshResource*));
 	new_data.geometry      = (const MeshGeometry**)memory::align_top(new_data.resource + num, alignof(MeshGeometry*));
 	new_data.mesh          = (MeshData*           )memory::align_top(new_data.geometry + num, alignof(MeshData     ));
-	new_data.material      = (StringId64*         )memory::align_top(new_data.mesh + num,     alignof(StringId64   ));
+	new_data.material      = (Material**          )memory::align_top(new_data.mesh + num,     alignof(Material*    ));
 	new_data.world         = (Matrix4x4*          )memory::align_top(new_data.material + num, alignof(Matrix4x4    ));
 	new_data.obb           = (OBB*                )memory::align_top(new_data.world + num,    alignof(OBB          ));
+	new_data.proxy         = (u32*                )memory::align_top(new_data.obb + num,      alignof(u32          ));
 
 	memcpy(new_data.unit, _data.unit, _data.size * sizeof(UnitId));
 	memcpy(new_data.resource, _data.resource, _data.size * sizeof(MeshResource*));
 	memcpy(new_data.geometry, _data.geometry, _data.size * sizeof(MeshGeometry*));
 	memcpy(new_data.mesh, _data.mesh, _data.size * sizeof(MeshData));
-	memcpy(new_data.material, _data.material, _data.size * sizeof(StringId64));
+	memcpy(new_data.material, _data.material, _data.size * sizeof(Material*));
 	memcpy(new_data.world, _data.world, _data.size * sizeof(Matrix4x4));
 	memcpy(new_data.obb, _data.obb, _data.size * sizeof(OBB));
+	memcpy(new_data.proxy, _data.proxy, _data.size * sizeof(u32));
 
 	_allocator->deallocate(_data.buffer);
 	_data = new_data;
@@ -574,9 +1099,9 @@ void RenderWorld::MeshManager::grow()
 	allocate(_data.capacity * 2 + 1);
 }
 
-MeshInstance RenderWorld::MeshManager::create(UnitId unit, const MeshResource* mr, const MeshRendererDesc& mrd, const Matrix4x4& tr)
+MeshInstance RenderWorld::MeshManager::create(UnitId unit, const MeshResource* mr, Material* mat, const MeshRendererDesc& mrd, const Matrix4x4& tr)
 {
-	CE_ASSERT(!hash_map::has(_map, unit), "Unit already has a mesh component");
+	CE_ASSERT(_map.get(unit) == UINT32_MAX, "Unit already has a mesh component");
 
 	if (_data.size == _data.capacity)
 		grow();
@@ -590,11 +1115,12 @@ MeshInstance RenderWorld::MeshManager::create(UnitId unit, const MeshResource* m
 	_data.geometry[last] = mg;
 	_data.mesh[last].vbh = mg->vertex_buffer;
 	_data.mesh[last].ibh = mg->index_buffer;
-	_data.material[last] = mrd.material_resource;
+	_data.material[last] = mat;
 	_data.world[last]    = tr;
 	_data.obb[last]      = mg->obb;
+	_data.proxy[last]    = _culling_grid.create(last, world_box(mg->obb, tr));
 
-	hash_map::set(_map, unit, last);
+	_map.set(unit, last);
 	++_data.size;
 
 	if (mrd.visible)
@@ -621,6 +1147,9 @@ void RenderWorld::MeshManager::destroy(MeshInstance inst)
 	const UnitId u      = _data.unit[inst.i];
 	const UnitId last_u = _data.unit[last];
 
+	_culling_grid.destroy(_data.proxy[inst.i]);
+	_culling_grid.set_owner(_data.proxy[last], inst.i);
+
 	_data.unit[inst.i]     = _data.unit[last];
 	_data.resource[inst.i] = _data.resource[last];
 	_data.geometry[inst.i] = _data.geometry[last];
@@ -629,9 +1158,10 @@ void RenderWorld::MeshManager::destroy(MeshInstance inst)
 	_data.material[inst.i] = _data.material[last];
 	_data.world[inst.i]    = _data.world[last];
 	_data.obb[inst.i]      = _data.obb[last];
+	_data.proxy[inst.i]    = _data.proxy[last];
 
-	hash_map::set(_map, last_u, inst.i);
-	hash_map::remove(_map, u);
+	_map.set(last_u, inst.i);
+	_map.remove(u);
 	--_data.size;
 
 	// If item was hidden.
@@ -660,9 +1190,18 @@ void RenderWorld::MeshManager::swap(u32 inst_a, u32 inst_b)
 	exchange(_data.material[inst_a], _data.material[inst_b]);
 	exchange(_data.world[inst_a],    _data.world[inst_b]);
 	exchange(_data.obb[inst_a],      _data.obb[inst_b]);
+	exchange(_data.proxy[inst_a],    _data.proxy[inst_b]);
+
+	_culling_grid.set_owner(_data.proxy[inst_a], inst_a);
+	_culling_grid.set_owner(_data.proxy[inst_b], inst_b);
 
-	hash_map::set(_map, unit_a, inst_b);
-	hash_map::set(_map, unit_b, inst_a);
+	_map.set(unit_a, inst_b);
+	_map.set(unit_b, inst_a);
+}
+
+void RenderWorld::MeshManager::update_proxy(u32 i)
+{
+	_culling_grid.move(_data.proxy[i], world_box(_data.obb[i], _data.world[i]));
 }
 
 bool RenderWorld::MeshManager::has(UnitId unit)
@@ -692,7 +1231,7 @@ void RenderWorld::MeshManager::set_visible(MeshInstance inst, bool visible)
 
 MeshInstance RenderWorld::MeshManager::mesh(UnitId unit)
 {
-	return make_instance(hash_map::get(_map, unit, UINT32_MAX));
+	return make_instance(_map.get(unit));
 }
 
 void RenderWorld::MeshManager::destroy()
@@ -707,7 +1246,7 @@ void RenderWorld::SpriteManager::allocate(u32 num)
 	const u32 bytes = 0
 		+ num*sizeof(UnitId) + alignof(UnitId)
 		+ num*sizeof(SpriteResource**) + alignof(SpriteResource*)
-		+ num*sizeof(StringId64) + alignof(StringId64)
+		+ num*sizeof(Material*) + alignof(Material*)
 		+ num*sizeof(u32) + alignof(u32)
 		+ num*sizeof(Matrix4x4) + alignof(Matrix4x4)
 		+ num*sizeof(AABB) + alignof(AABB)
@@ -715,6 +1254,7 @@ void RenderWorld::SpriteManager::allocate(u32 num)
 		+ num*sizeof(bool) + alignof(bool)
 		+ num*sizeof(u32) + alignof(u32)
 		+ num*sizeof(u32) + alignof(u32)
+		+ num*sizeof(u32) + alignof(u32)
 		;
 
 	SpriteInstanceData new_data;
@@ -725,7 +1265,7 @@ void RenderWorld::SpriteManager::allocate(u32 num)
 
 	new_data.unit     = (UnitId*               )memory::align_top(new_data.buffer,         alignof(UnitId         ));
 	new_data.resource = (const SpriteResource**)memory::align_top(new_data.unit + num,     alignof(SpriteResource*));
-	new_data.material = (StringId64*           )memory::align_top(new_data.resource + num, alignof(StringId64     ));
+	new_data.material = (Material**            )memory::align_top(new_data.resource + num, alignof(Material*      ));
 	new_data.frame    = (u32*                  )memory::align_top(new_data.material + num, alignof(u32            ));
 	new_data.world    = (Matrix4x4*            )memory::align_top(new_data.frame + num,    alignof(Matrix4x4      ));
 	new_data.aabb     = (AABB*                 )memory::align_top(new_data.world + num,    alignof(AABB           ));
@@ -733,10 +1273,11 @@ void RenderWorld::SpriteManager::allocate(u32 num)
 	new_data.flip_y   = (bool*                 )memory::align_top(new_data.flip_x + num,   alignof(bool           ));
 	new_data.layer    = (u32*                  )memory::align_top(new_data.flip_y + num,   alignof(u32            ));
 	new_data.depth    = (u32*                  )memory::align_top(new_data.layer + num,    alignof(u32            ));
+	new_data.proxy    = (u32*                  )memory::align_top(new_data.depth + num,    alignof(u32            ));
 
 	memcpy(new_data.unit, _data.unit, _data.size * sizeof(UnitId));
 	memcpy(new_data.resource, _data.resource, _data.size * sizeof(SpriteResource**));
-	memcpy(new_data.material, _data.material, _data.size * sizeof(StringId64));
+	memcpy(new_data.material, _data.material, _data.size * sizeof(Material*));
 	memcpy(new_data.frame, _data.frame, _data.size * sizeof(u32));
 	memcpy(new_data.world, _data.world, _data.size * sizeof(Matrix4x4));
 	memcpy(new_data.aabb, _data.aabb, _data.size * sizeof(AABB));
@@ -744,6 +1285,7 @@ void RenderWorld::SpriteManager::allocate(u32 num)
 	memcpy(new_data.flip_y, _data.flip_y, _data.size * sizeof(bool));
 	memcpy(new_data.layer, _data.layer, _data.size * sizeof(u32));
 	memcpy(new_data.depth, _data.depth, _data.size * sizeof(u32));
+	memcpy(new_data.proxy, _data.proxy, _data.size * sizeof(u32));
 
 	_allocator->deallocate(_data.buffer);
 	_data = new_data;
@@ -754,9 +1296,9 @@ void RenderWorld::SpriteManager::grow()
 	allocate(_data.capacity * 2 + 1);
 }
 
-SpriteInstance RenderWorld::SpriteManager::create(UnitId unit, const SpriteResource* sr, const SpriteRendererDesc& srd, const Matrix4x4& tr)
+SpriteInstance RenderWorld::SpriteManager::create(UnitId unit, const SpriteResource* sr, Material* mat, const SpriteRendererDesc& srd, const Matrix4x4& tr)
 {
-	CE_ASSERT(!hash_map::has(_map, unit), "Unit already has a sprite component");
+	CE_ASSERT(_map.get(unit) == UINT32_MAX, "Unit already has a sprite component");
 
 	if (_data.size == _data.capacity)
 		grow();
@@ -765,7 +1307,7 @@ SpriteInstance RenderWorld::SpriteManager::create(UnitId unit, const SpriteResou
 
 	_data.unit[last]     = unit;
 	_data.resource[last] = sr;
-	_data.material[last] = srd.material_resource;
+	_data.material[last] = mat;
 	_data.frame[last]    = 0;
 	_data.world[last]    = tr;
 	_data.aabb[last]     = AABB();
@@ -773,8 +1315,9 @@ SpriteInstance RenderWorld::SpriteManager::create(UnitId unit, const SpriteResou
 	_data.flip_y[last]   = false;
 	_data.layer[last]    = srd.layer;
 	_data.depth[last]    = srd.depth;
+	_data.proxy[last]    = _culling_grid.create(last, world_box(sr->obb, tr));
 
-	hash_map::set(_map, unit, last);
+	_map.set(unit, last);
 	++_data.size;
 
 	if (srd.visible)
@@ -801,6 +1344,9 @@ void RenderWorld::SpriteManager::destroy(SpriteInstance inst)
 	const UnitId u      = _data.unit[inst.i];
 	const UnitId last_u = _data.unit[last];
 
+	_culling_grid.destroy(_data.proxy[inst.i]);
+	_culling_grid.set_owner(_data.proxy[last], inst.i);
+
 	_data.unit[inst.i]     = _data.unit[last];
 	_data.resource[inst.i] = _data.resource[last];
 	_data.material[inst.i] = _data.material[last];
@@ -811,9 +1357,10 @@ void RenderWorld::SpriteManager::destroy(SpriteInstance inst)
 	_data.flip_y[inst.i]   = _data.flip_y[last];
 	_data.layer[inst.i]    = _data.layer[last];
 	_data.depth[inst.i]    = _data.depth[last];
+	_data.proxy[inst.i]    = _data.proxy[last];
 
-	hash_map::set(_map, last_u, inst.i);
-	hash_map::remove(_map, u);
+	_map.set(last_u, inst.i);
+	_map.remove(u);
 	--_data.size;
 
 	// If item was hidden.
@@ -845,9 +1392,18 @@ void RenderWorld::SpriteManager::swap(u32 inst_a, u32 inst_b)
 	exchange(_data.flip_y[inst_a],   _data.flip_y[inst_b]);
 	exchange(_data.layer[inst_a],    _data.layer[inst_b]);
 	exchange(_data.depth[inst_a],    _data.depth[inst_b]);
+	exchange(_data.proxy[inst_a],    _data.proxy[inst_b]);
+
+	_culling_grid.set_owner(_data.proxy[inst_a], inst_a);
+	_culling_grid.set_owner(_data.proxy[inst_b], inst_b);
 
-	hash_map::set(_map, unit_a, inst_b);
-	hash_map::set(_map, unit_b, inst_a);
+	_map.set(unit_a, inst_b);
+	_map.set(unit_b, inst_a);
+}
+
+void RenderWorld::SpriteManager::update_proxy(u32 i)
+{
+	_culling_grid.move(_data.proxy[i], world_box(_data.resource[i]->obb, _data.world[i]));
 }
 
 bool RenderWorld::SpriteManager::has(UnitId unit)
@@ -877,7 +1433,7 @@ void RenderWorld::SpriteManager::set_visible(SpriteInstance inst, bool visible)
 
 SpriteInstance RenderWorld::SpriteManager::sprite(UnitId unit)
 {
-	return make_instance(hash_map::get(_map, unit, UINT32_MAX));
+	return make_instance(_map.get(unit));
 }
 
 void RenderWorld::SpriteManager::destroy()
@@ -931,7 +1487,7 @@ void RenderWorld::LightManager::grow()
 
 LightInstance RenderWorld::LightManager::create(UnitId unit, const LightDesc& ld, const Matrix4x4& tr)
 {
-	CE_ASSERT(!hash_map::has(_map, unit), "Unit already has a light component");
+	CE_ASSERT(_map.get(unit) == UINT32_MAX, "Unit already has a light component");
 
 	if (_data.size == _data.capacity)
 		grow();
@@ -948,7 +1504,7 @@ LightInstance RenderWorld::LightManager::create(UnitId unit, const LightDesc& ld
 
 	++_data.size;
 
-	hash_map::set(_map, unit, last);
+	_map.set(unit, last);
 	return make_instance(last);
 }
 
@@ -970,8 +1526,8 @@ void RenderWorld::LightManager::destroy(LightInstance light)
 
 	--_data.size;
 
-	hash_map::set(_map, last_u, light.i);
-	hash_map::remove(_map, u);
+	_map.set(last_u, light.i);
+	_map.remove(u);
 }
 
 bool RenderWorld::LightManager::has(UnitId unit)
@@ -981,7 +1537,7 @@ bool RenderWorld::LightManager::has(UnitId unit)
 
 LightInstance RenderWorld::LightManager::light(UnitId unit)
 {
-	return make_instance(hash_map::get(_map, unit, UINT32_MAX));
+	return make_instance(_map.get(unit));
 }
 
 void RenderWorld::LightManager::destroy()
@@ -5,6 +5,7 @@
 
 #pragma once
 
+#include "config.h"
 #include "core/containers/types.h"
 #include "core/math/types.h"
 #include "core/strings/string_id.h"
@@ -137,16 +138,117 @@ struct RenderWorld
 
 	void update_transforms(const UnitId* begin, const UnitId* end, const Matrix4x4* world);
 
-	void render(const Matrix4x4& view);
+	/// Renders the objects visible from the camera defined by @a view and @a proj.
+	void render(const Matrix4x4& view, const Matrix4x4& proj);
 
 	/// Sets whether to @a enable debug drawing
 	void enable_debug_drawing(bool enable);
 
+	/// Sets whether to @a enable instanced drawing of meshes sharing
+	/// the same geometry and material.
+	void enable_instancing(bool enable);
+
 	/// Fills @a dl with debug lines
 	void debug_draw(DebugLine& dl);
 
 	void unit_destroyed_callback(UnitId unit);
 
+	/// Loose grid of world-space boxes used for frustum culling.
+	/// Each box is stored in the cell containing its center; the
+	/// bounds of a cell are inflated by half the cell size so that
+	/// boxes up to that size never straddle it. Bigger boxes are
+	/// kept in a separate, always-tested, cell.
+	struct CullingGrid
+	{
+		struct Proxy
+		{
+			AABB box;
+			u32 owner;
+			u32 cell;
+			u32 prev;
+			u32 next;
+		};
+
+		struct Cell
+		{
+			AABB bounds;
+			u32 first;
+			u32 num;
+		};
+
+		f32 _cell_size;
+		u32 _free_proxy;
+		Array<Proxy> _proxies;
+		Array<Cell> _cells;
+		HashMap<u64, u32> _cell_map;
+
+		CullingGrid(Allocator& a, f32 cell_size);
+
+		/// Adds the @a box owned by the instance @a owner and returns its proxy.
+		u32 create(u32 owner, const AABB& box);
+
+		/// Removes the @a proxy from the grid.
+		void destroy(u32 proxy);
+
+		/// Moves the @a proxy to the new @a box.
+		void move(u32 proxy, const AABB& box);
+
+		/// Sets the instance @a owner of the @a proxy.
+		void set_owner(u32 proxy, u32 owner);
+
+		/// Appends to @a owners the owners less than @a num_owners whose
+		/// boxes intersect the frustum @a f.
+		void cull(Array<u32>& owners, const Frustum& f, u32 num_owners);
+
+		u32 cell(const AABB& box);
+		void link(u32 proxy, u32 cell);
+		void unlink(u32 proxy);
+	};
+
+	/// Maps a UnitId to the index of its component instance through a dense
+	/// table addressed by the index bits of the UnitId.
+	struct UnitIndexMap
+	{
+		struct Entry
+		{
+			UnitId unit;
+			u32 i;
+		};
+
+		Array<Entry> _index;
+
+		UnitIndexMap(Allocator& a);
+
+		/// Returns the instance index of the @a unit or UINT32_MAX.
+		u32 get(UnitId unit) const;
+
+		/// Sets the instance index @a i of the @a unit.
+		void set(UnitId unit, u32 i);
+
+		/// Removes the @a unit from the map.
+		void remove(UnitId unit);
+	};
+
+	/// Sort key of a draw call paired with the instance it draws.
+	struct RenderKey
+	{
+		u64 key;
+		u32 index;
+
+		bool operator<(const RenderKey& other) const
+		{
+			return key < other.key;
+		}
+	};
+
+	/// Range of visible meshes drawn with a single draw call.
+	struct MeshBatch
+	{
+		u32 first;
+		u32 num;
+		bgfx::InstanceDataBuffer idb;
+	};
+
 	struct MeshManager
 	{
 		struct MeshData
@@ -167,31 +269,35 @@ struct RenderWorld
 			const MeshResource** resource;
 			const MeshGeometry** geometry;
 			MeshData* mesh;
-			StringId64* material;
+			Material** material;
 			Matrix4x4* world;
 			OBB* obb;
+			u32* proxy;
 		};
 
 		Allocator* _allocator;
-		HashMap<UnitId, u32> _map;
+		UnitIndexMap _map;
 		MeshInstanceData _data;
+		CullingGrid _culling_grid;
 
 		MeshManager(Allocator& a)
 			: _allocator(&a)
 			, _map(a)
+			, _culling_grid(a, CROWN_CULLING_GRID_CELL_SIZE)
 		{
 			memset(&_data, 0, sizeof(_data));
 		}
 
 		void allocate(u32 num);
 		void grow();
-		MeshInstance create(UnitId unit, const MeshResource* mr, const MeshRendererDesc& mrd, const Matrix4x4& tr);
+		MeshInstance create(UnitId unit, const MeshResource* mr, Material* mat, const MeshRendererDesc& mrd, const Matrix4x4& tr);
 		void destroy(MeshInstance mesh);
 		bool has(UnitId unit);
 		void set_visible(MeshInstance mesh, bool visible);
 		MeshInstance mesh(UnitId unit);
 		void destroy();
 		void swap(u32 inst_a, u32 inst_b);
+		void update_proxy(u32 i);
 
 		MeshInstance make_instance(u32 i) { MeshInstance inst = { i }; return inst; }
 	};
@@ -208,7 +314,7 @@ struct RenderWorld
 
 			UnitId* unit;
 			const SpriteResource** resource;
-			StringId64* material;
+			Material** material;
 			u32* frame;
 			Matrix4x4* world;
 			AABB* aabb;
@@ -216,20 +322,23 @@ struct RenderWorld
 			bool* flip_y;
 			u32* layer;
 			u32* depth;
+			u32* proxy;
 		};
 
 		Allocator* _allocator;
-		HashMap<UnitId, u32> _map;
+		UnitIndexMap _map;
 		SpriteInstanceData _data;
+		CullingGrid _culling_grid;
 
 		SpriteManager(Allocator& a)
 			: _allocator(&a)
 			, _map(a)
+			, _culling_grid(a, CROWN_CULLING_GRID_CELL_SIZE)
 		{
 			memset(&_data, 0, sizeof(_data));
 		}
 
-		SpriteInstance create(UnitId unit, const SpriteResource* sr, const SpriteRendererDesc& srd, const Matrix4x4& tr);
+		SpriteInstance create(UnitId unit, const SpriteResource* sr, Material* mat, const SpriteRendererDesc& srd, const Matrix4x4& tr);
 		void destroy(SpriteInstance sprite);
 		bool has(UnitId unit);
 		void set_visible(SpriteInstance sprite, bool visible);
@@ -238,6 +347,7 @@ struct RenderWorld
 		void grow();
 		void destroy();
 		void swap(u32 inst_a, u32 inst_b);
+		void update_proxy(u32 i);
 
 		SpriteInstance make_instance(u32 i) { SpriteInstance inst = { i }; return inst; }
 	};
@@ -260,7 +370,7 @@ struct RenderWorld
 		};
 
 		Allocator* _allocator;
-		HashMap<UnitId, u32> _map;
+		UnitIndexMap _map;
 		LightInstanceData _data;
 
 		LightManager(Allocator& a)
@@ -290,16 +400,23 @@ struct RenderWorld
 	MaterialManager* _material_manager;
 	UnitManager* _unit_manager;
 
-	bgfx::UniformHandle _u_light_position;
-	bgfx::UniformHandle _u_light_direction;
-	bgfx::UniformHandle _u_light_color;
-	bgfx::UniformHandle _u_light_range;
-	bgfx::UniformHandle _u_light_intensity;
+	bgfx::UniformHandle _u_lights;
+	bgfx::UniformHandle _u_lights_num;
+	bgfx::UniformHandle _u_mesh_decode;
 
 	bool _debug_drawing;
+	bool _instancing;
 	MeshManager _mesh_manager;
 	SpriteManager _sprite_manager;
 	LightManager _light_manager;
+	Array<u32> _visible_meshes;
+	Array<u32> _visible_sprites;
+	Array<RenderKey> _mesh_keys;
+	Array<MeshBatch> _mesh_batches;
+	Vector4 _lights_data[3*CROWN_MAX_LIGHTS];
+
+	void batch_meshes(const Matrix4x4& view, bool instancing);
+	u32 pack_lights(const Matrix4x4& view, const Frustum& f);
 
 	UnitDestroyCallback _unit_destroy_callback;
 };
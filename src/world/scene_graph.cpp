@@ -41,6 +41,8 @@ SceneGraph::SceneGraph(Allocator& a, UnitManager& um)
 	, _allocator(&a)
 	, _unit_manager(&um)
 	, _map(a)
+	, _changed(a)
+	, _dirty(a)
 {
 	_unit_destroy_callback.destroy = unit_destroyed_callback_bridge;
 	_unit_destroy_callback.user_data = this;
@@ -73,6 +75,7 @@ void SceneGraph::allocate(u32 num)
 		+ num*sizeof(Pose) + alignof(Pose)
 		+ num*sizeof(TransformInstance) * 4 + alignof(TransformInstance)
 		+ num*sizeof(bool) + alignof(bool)
+		+ num*sizeof(bool) + alignof(bool)
 		;
 
 	InstanceData new_data;
@@ -88,6 +91,7 @@ void SceneGraph::allocate(u32 num)
 	new_data.next_sibling = (TransformInstance*)memory::align_top(new_data.first_child + num,  alignof(TransformInstance));
 	new_data.prev_sibling = (TransformInstance*)memory::align_top(new_data.next_sibling + num, alignof(TransformInstance));
 	new_data.changed      = (bool*             )memory::align_top(new_data.prev_sibling + num, alignof(bool             ));
+	new_data.dirty        = (bool*             )memory::align_top(new_data.changed + num,      alignof(bool             ));
 
 	memcpy(new_data.unit, _data.unit, _data.size * sizeof(UnitId));
 	memcpy(new_data.world, _data.world, _data.size * sizeof(Matrix4x4));
@@ -97,6 +101,7 @@ void SceneGraph::allocate(u32 num)
 	memcpy(new_data.next_sibling, _data.next_sibling, _data.size * sizeof(TransformInstance));
 	memcpy(new_data.prev_sibling, _data.prev_sibling, _data.size * sizeof(TransformInstance));
 	memcpy(new_data.changed, _data.changed, _data.size * sizeof(bool));
+	memcpy(new_data.dirty, _data.dirty, _data.size * sizeof(bool));
 
 	_allocator->deallocate(_data.buffer);
 	_data = new_data;
@@ -137,6 +142,7 @@ TransformInstance SceneGraph::create(UnitId unit, const Matrix4x4& pose)
 	_data.next_sibling[last].i = UINT32_MAX;
 	_data.prev_sibling[last].i = UINT32_MAX;
 	_data.changed[last]        = false;
+	_data.dirty[last]          = false;
 
 	++_data.size;
 
@@ -179,6 +185,7 @@ static void scene_graph_move_data(const SceneGraph& sg, u32 dst, u32 src)
 	sg._data.next_sibling[dst] = sg._data.next_sibling[src];
 	sg._data.prev_sibling[dst] = sg._data.prev_sibling[src];
 	sg._data.changed[dst]      = sg._data.changed[src];
+	sg._data.dirty[dst]        = sg._data.dirty[src];
 }
 
 /// Swaps the transforms @a aa and @a bb.
@@ -211,8 +218,31 @@ void SceneGraph::destroy(TransformInstance transform)
 	const UnitId u = _data.unit[transform.i];
 	const UnitId last_u = _data.unit[last];
 
+	// Keep the changed list in sync with the instances being moved.
+	for (u32 i = 0; _data.changed[transform.i] && i < array::size(_changed); ++i)
+	{
+		if (_changed[i] == transform.i)
+		{
+			_changed[i] = _changed[array::size(_changed) - 1];
+			array::pop_back(_changed);
+			break;
+		}
+	}
+
 	if (last != transform.i)
 	{
+		for (u32 i = 0; _data.changed[last] && i < array::size(_changed); ++i)
+		{
+			if (_changed[i] == last)
+			{
+				_changed[i] = transform.i;
+				break;
+			}
+		}
+
+		if (_data.dirty[last])
+			array::push_back(_dirty, transform.i);
+
 		scene_graph_swap(*this, transform, make_instance(last));
 		hash_map::set(_map, last_u, transform.i);
 	}
@@ -288,18 +318,21 @@ Matrix4x4 SceneGraph::local_pose(TransformInstance transform)
 Vector3 SceneGraph::world_position(TransformInstance transform)
 {
 	CE_ASSERT(transform.i < _data.size, "Index out of bounds");
+	update_world(transform);
 	return translation(_data.world[transform.i]);
 }
 
 Quaternion SceneGraph::world_rotation(TransformInstance transform)
 {
 	CE_ASSERT(transform.i < _data.size, "Index out of bounds");
+	update_world(transform);
 	return rotation(_data.world[transform.i]);
 }
 
 Matrix4x4 SceneGraph::world_pose(TransformInstance transform)
 {
 	CE_ASSERT(transform.i < _data.size, "Index out of bounds");
+	update_world(transform);
 	return _data.world[transform.i];
 }
 
@@ -307,7 +340,7 @@ void SceneGraph::set_world_pose(TransformInstance transform, const Matrix4x4& po
 {
 	CE_ASSERT(transform.i < _data.size, "Index out of bounds");
 	_data.world[transform.i] = pose;
-	_data.changed[transform.i] = true;
+	set_world(transform);
 }
 
 void SceneGraph::set_world_pose_and_rescale(TransformInstance transform, const Matrix4x4& pose)
@@ -315,7 +348,7 @@ void SceneGraph::set_world_pose_and_rescale(TransformInstance transform, const M
 	CE_ASSERT(transform.i < _data.size, "Index out of bounds");
 	_data.world[transform.i] = pose;
 	set_scale(_data.world[transform.i], _data.local[transform.i].scale);
-	_data.changed[transform.i] = true;
+	set_world(transform);
 }
 
 u32 SceneGraph::num_nodes() const
@@ -363,7 +396,7 @@ void SceneGraph::link(TransformInstance parent
 	_data.local[child.i].scale    = child_local_scale;
 	_data.parent[child.i] = parent;
 
-	transform(_data.world[parent.i], child);
+	set_local(child);
 }
 
 void SceneGraph::unlink(TransformInstance child)
@@ -373,6 +406,8 @@ void SceneGraph::unlink(TransformInstance child)
 	if (!is_valid(_data.parent[child.i]))
 		return;
 
+	update_world(child);
+
 	if (_data.first_child[_data.parent[child.i].i].i == child.i)
 		_data.first_child[_data.parent[child.i].i] = _data.next_sibling[child.i];
 	else
@@ -389,48 +424,100 @@ void SceneGraph::unlink(TransformInstance child)
 	_data.prev_sibling[child.i].i = UINT32_MAX;
 }
 
+void SceneGraph::update()
+{
+	// Entries can be stale (out of bounds or no longer dirty) if the
+	// instances have been destroyed or read in the meantime.
+	for (u32 i = 0; i < array::size(_dirty); ++i)
+	{
+		const u32 ii = _dirty[i];
+		if (ii < _data.size && _data.dirty[ii])
+			update_world(make_instance(ii));
+	}
+
+	array::clear(_dirty);
+}
+
 void SceneGraph::clear_changed()
 {
-	for (u32 i = 0; i < _data.size; ++i)
+	for (u32 i = 0; i < array::size(_changed); ++i)
 	{
-		_data.changed[i] = false;
+		_data.changed[_changed[i]] = false;
 	}
+
+	array::clear(_changed);
 }
 
 void SceneGraph::get_changed(Array<UnitId>& units, Array<Matrix4x4>& world_poses)
 {
-	for (u32 i = 0; i < _data.size; ++i)
+	for (u32 i = 0; i < array::size(_changed); ++i)
 	{
-		if (_data.changed[i])
-		{
-			array::push_back(units, _data.unit[i]);
-			array::push_back(world_poses, _data.world[i]);
-		}
+		const u32 ii = _changed[i];
+		array::push_back(units, _data.unit[ii]);
+		array::push_back(world_poses, _data.world[ii]);
 	}
 }
 
-void SceneGraph::set_local(TransformInstance transform)
+void SceneGraph::set_changed(TransformInstance transform)
 {
-	TransformInstance parent = _data.parent[transform.i];
-	Matrix4x4 parent_tm = is_valid(parent) ? _data.world[parent.i] : MATRIX4X4_IDENTITY;
-	SceneGraph::transform(parent_tm, transform);
+	if (_data.changed[transform.i])
+		return;
 
 	_data.changed[transform.i] = true;
+	array::push_back(_changed, transform.i);
 }
 
-void SceneGraph::transform(const Matrix4x4& parent, TransformInstance transform)
+void SceneGraph::set_local(TransformInstance transform)
 {
-	_data.world[transform.i] = local_pose(transform) * parent;
-	_data.changed[transform.i] = true;
+	// A dirty node always has a dirty subtree.
+	if (_data.dirty[transform.i])
+		return;
+
+	_data.dirty[transform.i] = true;
+	array::push_back(_dirty, transform.i);
+
+	TransformInstance child = _data.first_child[transform.i];
+	while (is_valid(child))
+	{
+		set_local(child);
+		child = _data.next_sibling[child.i];
+	}
+}
+
+void SceneGraph::set_world(TransformInstance transform)
+{
+	_data.dirty[transform.i] = false;
+	set_changed(transform);
 
+	// The world poses of the children depend on the new pose.
 	TransformInstance child = _data.first_child[transform.i];
 	while (is_valid(child))
 	{
-		SceneGraph::transform(_data.world[transform.i], child);
+		set_local(child);
 		child = _data.next_sibling[child.i];
 	}
 }
 
+void SceneGraph::update_world(TransformInstance transform)
+{
+	if (!_data.dirty[transform.i])
+		return;
+
+	TransformInstance parent = _data.parent[transform.i];
+	if (is_valid(parent))
+	{
+		update_world(parent);
+		_data.world[transform.i] = local_pose(transform) * _data.world[parent.i];
+	}
+	else
+	{
+		_data.world[transform.i] = local_pose(transform);
+	}
+
+	_data.dirty[transform.i] = false;
+	set_changed(transform);
+}
+
 void SceneGraph::grow()
 {
 	// Allocate one extra slot to be used as a temporary storage.
@@ -42,6 +42,7 @@ struct SceneGraph
 			, next_sibling(NULL)
 			, prev_sibling(NULL)
 			, changed(NULL)
+			, dirty(NULL)
 		{
 		}
 
@@ -57,6 +58,7 @@ struct SceneGraph
 		TransformInstance* next_sibling;
 		TransformInstance* prev_sibling;
 		bool* changed;
+		bool* dirty;
 	};
 
 	u32 _marker;
@@ -64,6 +66,8 @@ struct SceneGraph
 	UnitManager* _unit_manager;
 	InstanceData _data;
 	HashMap<UnitId, u32> _map;
+	Array<u32> _changed; // Instances whose changed flag is set.
+	Array<u32> _dirty;   // Instances marked dirty since the last update().
 	UnitDestroyCallback _unit_destroy_callback;
 
 	///
@@ -88,6 +92,8 @@ struct SceneGraph
 	bool has(UnitId unit);
 
 	/// Sets the local position, rotation, scale or pose of the @a transform.
+	/// The world poses of the @a transform and its children are updated
+	/// lazily, either by update() or when they are read.
 	void set_local_position(TransformInstance transform, const Vector3& pos);
 
 	/// @copydoc SceneGraph::set_local_position()
@@ -144,10 +150,16 @@ struct SceneGraph
 	/// pose of the @a child is set to its previous world pose.
 	void unlink(TransformInstance child);
 
+	/// Updates the world poses of all the nodes whose local pose, or the
+	/// local pose of any of their ancestors, changed since the last update.
+	void update();
+
 	void clear_changed();
 	void get_changed(Array<UnitId>& units, Array<Matrix4x4>& world_poses);
+	void set_changed(TransformInstance transform);
 	void set_local(TransformInstance transform);
-	void transform(const Matrix4x4& parent, TransformInstance transform);
+	void set_world(TransformInstance transform);
+	void update_world(TransformInstance transform);
 	void grow();
 	void allocate(u32 num);
 	TransformInstance make_instance(u32 i);
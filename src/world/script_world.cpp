@@ -172,53 +172,34 @@ namespace script_world
 			{
 				int unit_index = sw._data[i].unit == ev.units[0] ? 0 : 1;
 
-				LuaStack stack(sw._lua_environment->L);
-				lua_rawgeti(stack.L, LUA_REGISTRYINDEX, sw._script[sw._data[i].script_i].module_ref);
+				const char* callback = NULL;
 				switch (ev.type)
 				{
-				case PhysicsCollisionEvent::TOUCH_BEGIN:
-					lua_getfield(stack.L, -1, "collision_begin");
-					if (!lua_isnil(stack.L, -1))
-					{
-						stack.push_unit (ev.units[1-unit_index]);
-						stack.push_unit (ev.units[unit_index]);
-						stack.push_actor(ev.actors[unit_index]);
-						stack.push_vector3(ev.position);
-						stack.push_vector3(ev.normal);
-						stack.push_float(ev.distance);
-						int status = sw._lua_environment->call(6, 0);
-						if (status != LUA_OK)
-						{
-							report(stack.L, status);
-							device()->pause();
-						}
-						stack.pop(1);
-					}
-					break;
+				case PhysicsCollisionEvent::TOUCH_BEGIN: callback = "collision_begin"; break;
+				case PhysicsCollisionEvent::TOUCHING:    callback = "collision";       break;
+				case PhysicsCollisionEvent::TOUCH_END:   callback = "collision_end";   break;
+				default: CE_FATAL("Unknown physics collision event"); break;
+				}
 
-				case PhysicsCollisionEvent::TOUCHING:
-					lua_getfield(stack.L, -1, "collision");
-					if (!lua_isnil(stack.L, -1))
+				LuaStack stack(sw._lua_environment->L);
+				lua_rawgeti(stack.L, LUA_REGISTRYINDEX, sw._script[sw._data[i].script_i].module_ref);
+				lua_getfield(stack.L, -1, callback);
+				if (!lua_isnil(stack.L, -1))
+				{
+					stack.push_unit (ev.units[1-unit_index]);
+					stack.push_unit (ev.units[unit_index]);
+					stack.push_actor(ev.actors[unit_index]);
+					stack.push_vector3(ev.position);
+					stack.push_vector3(ev.normal);
+					stack.push_float(ev.distance);
+					stack.push_float(ev.impulse);
+					int status = sw._lua_environment->call(7, 0);
+					if (status != LUA_OK)
 					{
-						stack.push_unit (ev.units[1-unit_index]);
-						stack.push_unit (ev.units[unit_index]);
-						stack.push_actor(ev.actors[unit_index]);
-						stack.push_vector3(ev.position);
-						stack.push_vector3(ev.normal);
-						stack.push_float(ev.distance);
-						int status = sw._lua_environment->call(6, 0);
-						if (status != LUA_OK)
-						{
-							report(stack.L, status);
-							device()->pause();
-						}
-						stack.pop(1);
+						report(stack.L, status);
+						device()->pause();
 					}
-					break;
-
-				default:
-					CE_FATAL("Unknown physics collision event");
-					break;
+					stack.pop(1);
 				}
 			}
 		}
@@ -226,6 +207,43 @@ namespace script_world
 		// Unit not found
 	}
 
+	void trigger(ScriptWorld& sw, const PhysicsTriggerEvent& ev)
+	{
+		if (sw._disable_callbacks)
+			return;
+
+		const char* callback = NULL;
+		switch (ev.type)
+		{
+		case PhysicsTriggerEvent::TOUCH_BEGIN: callback = "trigger_enter"; break;
+		case PhysicsTriggerEvent::TOUCH_END:   callback = "trigger_leave"; break;
+		default: return;
+		}
+
+		for (u32 i = 0; i < array::size(sw._data); ++i)
+		{
+			if (sw._data[i].unit != ev.trigger_unit)
+				continue;
+
+			LuaStack stack(sw._lua_environment->L);
+			lua_rawgeti(stack.L, LUA_REGISTRYINDEX, sw._script[sw._data[i].script_i].module_ref);
+			lua_getfield(stack.L, -1, callback);
+			if (!lua_isnil(stack.L, -1))
+			{
+				stack.push_unit (ev.other_unit);
+				stack.push_unit (ev.trigger_unit);
+				stack.push_actor(ev.other);
+				int status = sw._lua_environment->call(3, 0);
+				if (status != LUA_OK)
+				{
+					report(stack.L, status);
+					device()->pause();
+				}
+				stack.pop(1);
+			}
+		}
+	}
+
 } // namespace script_world
 
 ScriptWorld::ScriptWorld(Allocator& a, UnitManager& um, ResourceManager& rm, LuaEnvironment& le, World& w)
@@ -63,6 +63,10 @@ namespace script_world
 	///
 	void collision(ScriptWorld& sw, const PhysicsCollisionEvent& ev);
 
+	/// Calls the trigger_enter or trigger_leave function on the scripts of
+	/// the trigger unit.
+	void trigger(ScriptWorld& sw, const PhysicsTriggerEvent& ev);
+
 } // namespace script_world
 
 } // namespace crown
@@ -66,10 +66,20 @@ void* ShaderManager::load(File& file, Allocator& a)
 		const bgfx::Memory* fsmem = bgfx::alloc(fs_code_size);
 		br.read(fsmem->data, fs_code_size);
 
+		u32 vs_instanced_code_size;
+		br.read(vs_instanced_code_size);
+		const bgfx::Memory* vsmem_instanced = NULL;
+		if (vs_instanced_code_size != 0)
+		{
+			vsmem_instanced = bgfx::alloc(vs_instanced_code_size);
+			br.read(vsmem_instanced->data, vs_instanced_code_size);
+		}
+
 		sr->_data[i].name._id = shader_name;
 		sr->_data[i].state = render_state;
 		sr->_data[i].vsmem = vsmem;
 		sr->_data[i].fsmem = fsmem;
+		sr->_data[i].vsmem_instanced = vsmem_instanced;
 	}
 
 	return sr;
@@ -87,10 +97,24 @@ void ShaderManager::online(StringId64 id, ResourceManager& rm)
 		CE_ASSERT(bgfx::isValid(vs), "Failed to create vertex shader");
 		bgfx::ShaderHandle fs = bgfx::createShader(data.fsmem);
 		CE_ASSERT(bgfx::isValid(fs), "Failed to create fragment shader");
-		bgfx::ProgramHandle program = bgfx::createProgram(vs, fs, true);
+		bgfx::ProgramHandle program = bgfx::createProgram(vs, fs);
 		CE_ASSERT(bgfx::isValid(program), "Failed to create GPU program");
 
-		add_shader(data.name, data.state, data.samplers, program);
+		// The instanced program shares the fragment shader.
+		bgfx::ProgramHandle program_instanced = BGFX_INVALID_HANDLE;
+		if (data.vsmem_instanced != NULL)
+		{
+			bgfx::ShaderHandle vsi = bgfx::createShader(data.vsmem_instanced);
+			CE_ASSERT(bgfx::isValid(vsi), "Failed to create instanced vertex shader");
+			program_instanced = bgfx::createProgram(vsi, fs);
+			CE_ASSERT(bgfx::isValid(program_instanced), "Failed to create instanced GPU program");
+			bgfx::destroy(vsi);
+		}
+
+		bgfx::destroy(fs);
+		bgfx::destroy(vs);
+
+		add_shader(data.name, data.state, data.samplers, program, program_instanced);
 	}
 }
 
@@ -105,9 +129,12 @@ void ShaderManager::offline(StringId64 id, ResourceManager& rm)
 		ShaderData sd;
 		sd.state = BGFX_STATE_DEFAULT;
 		sd.program = BGFX_INVALID_HANDLE;
+		sd.program_instanced = BGFX_INVALID_HANDLE;
 		sd = hash_map::get(_shader_map, data.name, sd);
 
 		bgfx::destroy(sd.program);
+		if (bgfx::isValid(sd.program_instanced))
+			bgfx::destroy(sd.program_instanced);
 
 		hash_map::remove(_shader_map, data.name);
 	}
@@ -118,21 +145,33 @@ void ShaderManager::unload(Allocator& a, void* res)
 	CE_DELETE(a, (ShaderResource*)res);
 }
 
-void ShaderManager::add_shader(StringId32 name, u64 state, const ShaderResource::Sampler samplers[4], bgfx::ProgramHandle program)
+void ShaderManager::add_shader(StringId32 name, u64 state, const ShaderResource::Sampler samplers[4], bgfx::ProgramHandle program, bgfx::ProgramHandle program_instanced)
 {
 	ShaderData sd;
 	sd.state = state;
 	memcpy(sd.samplers, samplers, sizeof(sd.samplers));
 	sd.program = program;
+	sd.program_instanced = program_instanced;
 	hash_map::set(_shader_map, name, sd);
 }
 
+ShaderManager::ShaderData ShaderManager::shader(StringId32 shader_id)
+{
+	CE_ASSERT(hash_map::has(_shader_map, shader_id), "Shader not found");
+	ShaderData sd;
+	sd.state = BGFX_STATE_DEFAULT;
+	sd.program = BGFX_INVALID_HANDLE;
+	sd.program_instanced = BGFX_INVALID_HANDLE;
+	return hash_map::get(_shader_map, shader_id, sd);
+}
+
 u32 ShaderManager::sampler_state(StringId32 shader_id, StringId32 sampler_name)
 {
 	CE_ASSERT(hash_map::has(_shader_map, shader_id), "Shader not found");
 	ShaderData sd;
 	sd.state = BGFX_STATE_DEFAULT;
 	sd.program = BGFX_INVALID_HANDLE;
+	sd.program_instanced = BGFX_INVALID_HANDLE;
 	sd = hash_map::get(_shader_map, shader_id, sd);
 
 	for (u32 i = 0; i < countof(sd.samplers); ++i)
@@ -151,6 +190,7 @@ void ShaderManager::submit(StringId32 shader_id, u8 view_id, s32 depth, u64 stat
 	ShaderData sd;
 	sd.state = BGFX_STATE_DEFAULT;
 	sd.program = BGFX_INVALID_HANDLE;
+	sd.program_instanced = BGFX_INVALID_HANDLE;
 	sd = hash_map::get(_shader_map, shader_id, sd);
 
 	bgfx::setState(state != UINT64_MAX ? state : sd.state);
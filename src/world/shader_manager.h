@@ -25,6 +25,7 @@ struct ShaderManager
 		u64 state;
 		ShaderResource::Sampler samplers[4];
 		bgfx::ProgramHandle program;
+		bgfx::ProgramHandle program_instanced;
 	};
 
 	typedef HashMap<StringId32, ShaderData> ShaderMap;
@@ -46,7 +47,10 @@ struct ShaderManager
 	void unload(Allocator& a, void* res);
 
 	///
-	void add_shader(StringId32 name, u64 state, const ShaderResource::Sampler samplers[4], bgfx::ProgramHandle program);
+	void add_shader(StringId32 name, u64 state, const ShaderResource::Sampler samplers[4], bgfx::ProgramHandle program, bgfx::ProgramHandle program_instanced = BGFX_INVALID_HANDLE);
+
+	/// Returns the data of the shader @a shader_id.
+	ShaderData shader(StringId32 shader_id);
 
 	///
 	u32 sampler_state(StringId32 shader_id, StringId32 sampler_name);
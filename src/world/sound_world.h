@@ -32,7 +32,9 @@ struct SoundWorld
 
 	/// Plays the sound @a sr at the given @a volume [0 .. 1].
 	/// If loop is true the sound will be played looping.
-	SoundInstanceId play(const SoundResource& sr, bool loop, f32 volume, f32 range, const Vector3& pos);
+	/// When there are more sounds than voices, sounds with higher @a priority,
+	/// then the loudest ones, are heard; the others keep playing silently.
+	SoundInstanceId play(const SoundResource& sr, bool loop, f32 volume, f32 range, const Vector3& pos, s32 priority);
 
 	/// Stops the sound with the given @a id.
 	/// After this call, the instance will be destroyed.
@@ -65,8 +67,9 @@ struct SoundWorld
 	/// Sets the @a pose of the listener in world space.
 	void set_listener_pose(const Matrix4x4& pose);
 
-	///
-	void update();
+	/// Advances the sounds by @a dt seconds and assigns the voices to the
+	/// most important ones.
+	void update(f32 dt);
 };
 
 } // namespace crown
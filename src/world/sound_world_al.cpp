@@ -8,16 +8,34 @@
 #if CROWN_SOUND_OPENAL
 
 #include "core/containers/array.inl"
+#include "core/containers/hash_map.inl"
 #include "core/math/constants.h"
 #include "core/math/matrix4x4.inl"
 #include "core/math/vector3.inl"
 #include "core/memory/temp_allocator.inl"
+#include "core/os.h"
+#include "core/thread/mutex.h"
+#include "core/thread/scoped_mutex.inl"
+#include "core/thread/thread.h"
 #include "device/log.h"
+#include "resource/resource_manager.h"
 #include "resource/sound_resource.h"
 #include "world/audio.h"
 #include "world/sound_world.h"
 #include <AL/al.h>
 #include <AL/alc.h>
+#include <algorithm>
+#include <atomic>
+#include <math.h> // fmod
+#include <string.h> // memcpy
+#define STB_VORBIS_HEADER_ONLY
+#define STB_VORBIS_NO_STDIO
+#define STB_VORBIS_NO_PUSHDATA_API
+#include <stb_vorbis.c>
+
+#define SOUND_STREAM_NUM_BUFFERS 4
+#define SOUND_STREAM_BUFFER_SIZE (16*1024) // In bytes.
+#define SOUND_STREAM_UPDATE_MS   10
 
 LOG_SYSTEM(SOUND, "sound")
 
@@ -50,167 +68,330 @@ namespace crown
 	#define AL_CHECK(function) function
 #endif // CROWN_DEBUG
 
-/// Global audio-related functions
-namespace audio_globals
+template <>
+struct hash<const SoundResource*>
 {
-	static ALCdevice* s_al_device;
-	static ALCcontext* s_al_context;
-
-	void init()
+	u32 operator()(const SoundResource* val) const
 	{
-		s_al_device = alcOpenDevice(NULL);
-		CE_ASSERT(s_al_device, "alcOpenDevice: error");
-
-		s_al_context = alcCreateContext(s_al_device, NULL);
-		CE_ASSERT(s_al_context, "alcCreateContext: error");
-
-		AL_CHECK(alcMakeContextCurrent(s_al_context));
-
-#if CROWN_DEBUG && !CROWN_DEVELOPMENT
-		logi(SOUND, "OpenAL Vendor   : %s", alGetString(AL_VENDOR));
-		logi(SOUND, "OpenAL Version  : %s", alGetString(AL_VERSION));
-		logi(SOUND, "OpenAL Renderer : %s", alGetString(AL_RENDERER));
-#endif
-
-		AL_CHECK(alDistanceModel(AL_LINEAR_DISTANCE_CLAMPED));
-		AL_CHECK(alDopplerFactor(1.0f));
-		AL_CHECK(alDopplerVelocity(343.0f));
+		return u32(uintptr_t(val) >> 4);
 	}
+};
 
-	void shutdown()
+static ALenum al_format(const SoundResource& sr)
+{
+	switch (sr.bits_ps)
 	{
-		alcDestroyContext(s_al_context);
-	    alcCloseDevice(s_al_device);
+	case  8: return sr.channels > 1 ? AL_FORMAT_STEREO8  : AL_FORMAT_MONO8;
+	case 16: return sr.channels > 1 ? AL_FORMAT_STEREO16 : AL_FORMAT_MONO16;
+	default: CE_FATAL("Number of bits per sample not supported."); return AL_INVALID_ENUM;
 	}
+}
 
-} // namespace audio_globals
-
-struct SoundInstance
+/// AL buffer shared by the resource and by all the instances of a sound
+/// that is not streamed.
+struct SoundBuffer
 {
-	const SoundResource* _resource;
-	SoundInstanceId _id;
-	ALuint _buffer;
-	ALuint _source;
+	ALuint buffer;
+	u32 references;
+};
 
-	void create(const SoundResource& sr, const Vector3& pos, f32 range)
+static void sound_buffer_release(SoundBuffer* sb)
+{
+	if (--sb->references == 0)
 	{
-		using namespace sound_resource;
-
-		AL_CHECK(alGenSources(1, &_source));
-		CE_ASSERT(alIsSource(_source), "alGenSources: error");
-
-		AL_CHECK(alSourcef(_source, AL_REFERENCE_DISTANCE, 0.01f));
-		AL_CHECK(alSourcef(_source, AL_MAX_DISTANCE, range));
-		AL_CHECK(alSourcef(_source, AL_PITCH, 1.0f));
-
-		// Generates AL buffers
-		AL_CHECK(alGenBuffers(1, &_buffer));
-		CE_ASSERT(alIsBuffer(_buffer), "alGenBuffers: error");
+		AL_CHECK(alDeleteBuffers(1, &sb->buffer));
+		CE_DELETE(default_allocator(), sb);
+	}
+}
 
-		ALenum fmt = AL_INVALID_ENUM;
-		switch (sr.bits_ps)
+/// Decodes a streaming sound into a ring of buffers queued to its source.
+/// Buffers are refilled by the audio thread as the source consumes them.
+struct SoundStream
+{
+	const SoundResource* _resource;
+	ALuint _source;
+	ALuint _buffers[SOUND_STREAM_NUM_BUFFERS];
+	stb_vorbis* _vorbis;
+	u32 _offset;   ///< Offset of the next PCM data to queue.
+	bool _loop;
+	bool _eof;     ///< Whether all the data has been queued.
+	bool _stopped; ///< Whether the data has gone offline. Stopped streams are not updated.
+
+	explicit SoundStream(const SoundResource& sr)
+		: _resource(&sr)
+		, _source(0)
+		, _vorbis(NULL)
+		, _offset(0)
+		, _loop(false)
+		, _eof(false)
+		, _stopped(false)
+	{
+		AL_CHECK(alGenBuffers(SOUND_STREAM_NUM_BUFFERS, _buffers));
+
+		if (sr.sound_type == SoundType::OGG)
 		{
-		case  8: fmt = sr.channels > 1 ? AL_FORMAT_STEREO8  : AL_FORMAT_MONO8; break;
-		case 16: fmt = sr.channels > 1 ? AL_FORMAT_STEREO16 : AL_FORMAT_MONO16; break;
-		default: CE_FATAL("Number of bits per sample not supported."); break;
+			int error;
+			_vorbis = stb_vorbis_open_memory((const unsigned char*)sound_resource::data(&sr)
+				, sr.size
+				, &error
+				, NULL
+				);
+			CE_ASSERT(_vorbis != NULL, "stb_vorbis_open_memory: error %d", error);
 		}
-		AL_CHECK(alBufferData(_buffer, fmt, data(&sr), sr.size, sr.sample_rate));
+	}
+
+	~SoundStream()
+	{
+		if (_vorbis != NULL)
+			stb_vorbis_close(_vorbis);
 
-		_resource = &sr;
-		set_position(pos);
+		AL_CHECK(alDeleteBuffers(SOUND_STREAM_NUM_BUFFERS, _buffers));
 	}
 
-	void destroy()
+	void rewind()
 	{
-		stop();
-		AL_CHECK(alSourcei(_source, AL_BUFFER, 0));
-		AL_CHECK(alDeleteBuffers(1, &_buffer));
-		AL_CHECK(alDeleteSources(1, &_source));
+		if (_vorbis != NULL)
+			stb_vorbis_seek_start(_vorbis);
+		else
+			_offset = 0;
 	}
 
-	void reload(const SoundResource& new_sr)
+	/// Moves the read position to @a sample.
+	void seek(u32 sample)
 	{
-		destroy();
-		create(new_sr, position(), range());
+		if (_vorbis != NULL)
+			stb_vorbis_seek(_vorbis, sample);
+		else
+			_offset = min(sample*_resource->block_size, _resource->size);
 	}
 
-	void play(bool loop, f32 volume)
+	/// Reads up to @a size bytes of PCM data into @a data and returns the
+	/// number of bytes read.
+	u32 read(char* data, u32 size)
 	{
-		set_volume(volume);
-		AL_CHECK(alSourcei(_source, AL_LOOPING, (loop ? AL_TRUE : AL_FALSE)));
-		AL_CHECK(alSourceQueueBuffers(_source, 1, &_buffer));
-		AL_CHECK(alSourcePlay(_source));
+		if (_vorbis != NULL)
+		{
+			const s32 num = stb_vorbis_get_samples_short_interleaved(_vorbis
+				, _resource->channels
+				, (short*)data
+				, size / sizeof(short)
+				);
+			return num*_resource->block_size;
+		}
+
+		const u32 num = min(size, _resource->size - _offset);
+		memcpy(data, sound_resource::data(_resource) + _offset, num);
+		_offset += num;
+		return num;
 	}
 
-	void pause()
+	/// Fills @a buffer with the next chunk of data. Returns false if there
+	/// is no more data.
+	bool fill(ALuint buffer)
 	{
-		AL_CHECK(alSourcePause(_source));
+		char data[SOUND_STREAM_BUFFER_SIZE];
+		const u32 capacity = sizeof(data) - sizeof(data) % _resource->block_size;
+
+		u32 size = read(data, capacity);
+		while (_loop && size < capacity)
+		{
+			rewind();
+			const u32 num = read(data + size, capacity - size);
+			if (num == 0)
+				break;
+			size += num;
+		}
+
+		if (size == 0)
+			return false;
+
+		AL_CHECK(alBufferData(buffer, al_format(*_resource), data, size, _resource->sample_rate));
+		return true;
 	}
 
-	void resume()
+	/// Queues the first buffers, starting at @a sample, to @a source.
+	void start(ALuint source, bool loop, u32 sample)
 	{
-		AL_CHECK(alSourcePlay(_source));
+		_source = source;
+		_loop = loop;
+		seek(sample);
+
+		for (u32 i = 0; i < SOUND_STREAM_NUM_BUFFERS && !_eof; ++i)
+		{
+			if (fill(_buffers[i]))
+			{
+				AL_CHECK(alSourceQueueBuffers(_source, 1, &_buffers[i]));
+			}
+			else
+			{
+				_eof = true;
+			}
+		}
 	}
 
-	void stop()
+	/// Refills the buffers consumed by the source.
+	void update()
 	{
-		AL_CHECK(alSourceStop(_source));
-		AL_CHECK(alSourceRewind(_source)); // Workaround
 		ALint processed;
 		AL_CHECK(alGetSourcei(_source, AL_BUFFERS_PROCESSED, &processed));
 
-		if (processed > 0)
+		for (; processed > 0; --processed)
 		{
-			ALuint removed;
-			AL_CHECK(alSourceUnqueueBuffers(_source, 1, &removed));
+			ALuint buffer;
+			AL_CHECK(alSourceUnqueueBuffers(_source, 1, &buffer));
+
+			if (!_eof && fill(buffer))
+			{
+				AL_CHECK(alSourceQueueBuffers(_source, 1, &buffer));
+			}
+			else
+			{
+				_eof = true;
+			}
 		}
-	}
 
-	bool is_playing()
-	{
+		// Restart the source if it ran out of data before the buffers
+		// could be refilled.
 		ALint state;
+		ALint queued;
 		AL_CHECK(alGetSourcei(_source, AL_SOURCE_STATE, &state));
-		return state == AL_PLAYING;
+		AL_CHECK(alGetSourcei(_source, AL_BUFFERS_QUEUED, &queued));
+		if (state == AL_STOPPED && queued > 0)
+		{
+			AL_CHECK(alSourcePlay(_source));
+		}
 	}
+};
 
-	bool finished()
-	{
-		ALint state;
-		AL_CHECK(alGetSourcei(_source, AL_SOURCE_STATE, &state));
-		return (state != AL_PLAYING && state != AL_PAUSED);
-	}
+typedef HashMap<const SoundResource*, SoundBuffer*> SoundBufferMap;
+struct SoundWorldImpl;
 
-	Vector3 position()
-	{
-		ALfloat pos[3];
-		AL_CHECK(alGetSourcefv(_source, AL_POSITION, pos));
-		return vector3(pos[0], pos[1], pos[2]);
-	}
+/// Global audio-related functions
+namespace audio_globals
+{
+	static ALCdevice* s_al_device;
+	static ALCcontext* s_al_context;
+	static SoundBufferMap* s_buffers;
+	static Array<SoundWorldImpl*>* s_worlds;
+	static Array<SoundStream*>* s_streams;
+	static Mutex* s_streams_mutex;
+	static Thread* s_thread;
+	static std::atomic<bool> s_exit;
 
-	float range()
+	static s32 audio_thread_main(void* /*user_data*/)
 	{
-		ALfloat range;
-		AL_CHECK(alGetSourcefv(_source, AL_MAX_DISTANCE, &range));
-		return range;
+		while (!s_exit)
+		{
+			{
+				ScopedMutex sm(*s_streams_mutex);
+				for (u32 i = 0; i < array::size(*s_streams); ++i)
+					(*s_streams)[i]->update();
+			}
+
+			os::sleep(SOUND_STREAM_UPDATE_MS);
+		}
+
+		return 0;
 	}
 
-	void set_position(const Vector3& pos)
+	void init()
 	{
-		AL_CHECK(alSourcefv(_source, AL_POSITION, to_float_ptr(pos)));
+		s_al_device = alcOpenDevice(NULL);
+		CE_ASSERT(s_al_device, "alcOpenDevice: error");
+
+		s_al_context = alcCreateContext(s_al_device, NULL);
+		CE_ASSERT(s_al_context, "alcCreateContext: error");
+
+		AL_CHECK(alcMakeContextCurrent(s_al_context));
+
+#if CROWN_DEBUG && !CROWN_DEVELOPMENT
+		logi(SOUND, "OpenAL Vendor   : %s", alGetString(AL_VENDOR));
+		logi(SOUND, "OpenAL Version  : %s", alGetString(AL_VERSION));
+		logi(SOUND, "OpenAL Renderer : %s", alGetString(AL_RENDERER));
+#endif
+
+		AL_CHECK(alDistanceModel(AL_LINEAR_DISTANCE_CLAMPED));
+		AL_CHECK(alDopplerFactor(1.0f));
+		AL_CHECK(alDopplerVelocity(343.0f));
+
+		s_buffers = CE_NEW(default_allocator(), SoundBufferMap)(default_allocator());
+		s_worlds = CE_NEW(default_allocator(), Array<SoundWorldImpl*>)(default_allocator());
+		s_streams = CE_NEW(default_allocator(), Array<SoundStream*>)(default_allocator());
+		s_streams_mutex = CE_NEW(default_allocator(), Mutex)();
+
+		s_exit = false;
+		s_thread = CE_NEW(default_allocator(), Thread)();
+		s_thread->start(audio_thread_main);
 	}
 
-	void set_range(f32 range)
+	void shutdown()
 	{
-		AL_CHECK(alSourcef(_source, AL_MAX_DISTANCE, range));
+		s_exit = true;
+		s_thread->stop();
+		CE_DELETE(default_allocator(), s_thread);
+
+		CE_ASSERT(array::size(*s_streams) == 0, "Streams still playing");
+		CE_ASSERT(array::size(*s_worlds) == 0, "Sound worlds still alive");
+		CE_DELETE(default_allocator(), s_worlds);
+		CE_DELETE(default_allocator(), s_streams_mutex);
+		CE_DELETE(default_allocator(), s_streams);
+
+		// Resources still online release their buffers here.
+		auto cur = hash_map::begin(*s_buffers);
+		auto end = hash_map::end(*s_buffers);
+		for (; cur != end; ++cur)
+		{
+			HASH_MAP_SKIP_HOLE(*s_buffers, cur);
+
+			sound_buffer_release(cur->second);
+		}
+		CE_DELETE(default_allocator(), s_buffers);
+		s_buffers = NULL;
+
+		alcDestroyContext(s_al_context);
+	    alcCloseDevice(s_al_device);
 	}
 
-	void set_volume(f32 volume)
+} // namespace audio_globals
+
+/// Logical sound instance.
+///
+/// Instances only get a voice (an AL source) while they are among the
+/// CROWN_MAX_SOUND_VOICES most important sounds in the world; the others are
+/// virtual and only keep track of their playback position.
+struct SoundInstance
+{
+	const SoundResource* _resource;
+	SoundInstanceId _id;
+	SoundBuffer* _buffer; ///< Shared buffer, or NULL if the sound is streamed.
+	SoundStream* _stream; ///< Stream while the sound has a voice, or NULL.
+	u32 _voice;           ///< Voice playing the sound, or UINT32_MAX if the sound is virtual.
+	Vector3 _position;
+	f32 _range;
+	f32 _volume;
+	s32 _priority;
+	f32 _audibility;      ///< Volume heard by the listener.
+	f64 _offset;          ///< Playback position in samples.
+	bool _loop;
+	bool _paused;
+	bool _stopped;
+};
+
+/// Orders sounds by decreasing priority, then by decreasing audibility.
+struct VoiceKey
+{
+	s32 priority;
+	f32 audibility;
+	u32 index;
+
+	bool operator<(const VoiceKey& other) const
 	{
-		AL_CHECK(alSourcef(_source, AL_GAIN, volume));
+		if (priority != other.priority)
+			return priority > other.priority;
+		return audibility > other.audibility;
 	}
 };
 
-#define MAX_OBJECTS       1024
 #define INDEX_MASK        0xffff
 #define NEW_OBJECT_ID_ADD 0x10000
 
@@ -223,17 +404,18 @@ struct SoundWorldImpl
 		u16 next;
 	};
 
-	u32 _num_objects;
-	SoundInstance _playing_sounds[MAX_OBJECTS];
-	Index _indices[MAX_OBJECTS];
-	u16 _freelist_enqueue;
-	u16 _freelist_dequeue;
+	Array<SoundInstance> _playing_sounds;
+	Array<Index> _indices;
+	u16 _freelist;
+	ALuint _voices[CROWN_MAX_SOUND_VOICES];
+	u32 _free_voices[CROWN_MAX_SOUND_VOICES];
+	u32 _num_free_voices;
 	Matrix4x4 _listener_pose;
 
 	bool has(SoundInstanceId id)
 	{
-		Index& in = _indices[id & INDEX_MASK];
-		return in.id == id && in.index != UINT16_MAX;
+		const u32 i = id & INDEX_MASK;
+		return i < array::size(_indices) && _indices[i].id == id && _indices[i].index != UINT16_MAX;
 	}
 
 	SoundInstance& lookup(SoundInstanceId id)
@@ -243,12 +425,23 @@ struct SoundWorldImpl
 
 	SoundInstanceId add()
 	{
-		Index& in = _indices[_freelist_dequeue];
-		_freelist_dequeue = in.next;
+		if (_freelist == UINT16_MAX)
+		{
+			CE_ASSERT(array::size(_indices) < UINT16_MAX, "Maximum number of sound instances reached");
+			Index in;
+			in.id = array::size(_indices);
+			in.next = UINT16_MAX;
+			_freelist = u16(array::push_back(_indices, in));
+		}
+
+		Index& in = _indices[_freelist];
+		_freelist = in.next;
 		in.id += NEW_OBJECT_ID_ADD;
-		in.index = _num_objects++;
-		SoundInstance& o = _playing_sounds[in.index];
+		in.index = u16(array::size(_playing_sounds));
+
+		SoundInstance o;
 		o._id = in.id;
+		array::push_back(_playing_sounds, o);
 		return o._id;
 	}
 
@@ -257,70 +450,231 @@ struct SoundWorldImpl
 		Index& in = _indices[id & INDEX_MASK];
 
 		SoundInstance& o = _playing_sounds[in.index];
-		o = _playing_sounds[--_num_objects];
+		o = array::back(_playing_sounds);
+		array::pop_back(_playing_sounds);
 		_indices[o._id & INDEX_MASK].index = in.index;
 
 		in.index = UINT16_MAX;
-		_indices[_freelist_enqueue].next = id & INDEX_MASK;
-		_freelist_enqueue = id & INDEX_MASK;
+		in.next = _freelist;
+		_freelist = id & INDEX_MASK;
 	}
 
-	SoundWorldImpl()
+	explicit SoundWorldImpl(Allocator& a)
+		: _playing_sounds(a)
+		, _indices(a)
+		, _freelist(UINT16_MAX)
+		, _num_free_voices(CROWN_MAX_SOUND_VOICES)
 	{
-		_num_objects = 0;
-		for (u32 i = 0; i < MAX_OBJECTS; ++i)
+		AL_CHECK(alGenSources(CROWN_MAX_SOUND_VOICES, _voices));
+
+		for (u32 i = 0; i < CROWN_MAX_SOUND_VOICES; ++i)
 		{
-			_indices[i].id = i;
-			_indices[i].next = i + 1;
+			CE_ASSERT(alIsSource(_voices[i]), "alGenSources: error");
+			AL_CHECK(alSourcef(_voices[i], AL_REFERENCE_DISTANCE, 0.01f));
+			AL_CHECK(alSourcef(_voices[i], AL_PITCH, 1.0f));
+			_free_voices[i] = CROWN_MAX_SOUND_VOICES - 1 - i;
 		}
-		_freelist_dequeue = 0;
-		_freelist_enqueue = MAX_OBJECTS - 1;
 
 		set_listener_pose(MATRIX4X4_IDENTITY);
+
+		array::push_back(*audio_globals::s_worlds, this);
+	}
+
+	~SoundWorldImpl()
+	{
+		Array<SoundWorldImpl*>& worlds = *audio_globals::s_worlds;
+		for (u32 i = 0; i < array::size(worlds); ++i)
+		{
+			if (worlds[i] == this)
+			{
+				worlds[i] = array::back(worlds);
+				array::pop_back(worlds);
+				break;
+			}
+		}
+
+		for (u32 i = 0; i < array::size(_playing_sounds); ++i)
+		{
+			destroy(_playing_sounds[i]);
+		}
+
+		AL_CHECK(alDeleteSources(CROWN_MAX_SOUND_VOICES, _voices));
+	}
+
+	/// Returns the volume at which the listener hears @a si, following the
+	/// AL_LINEAR_DISTANCE_CLAMPED model.
+	f32 audibility(const SoundInstance& si)
+	{
+		if (si._paused || si._stopped)
+			return 0.0f;
+
+		const f32 ref = 0.01f;
+		if (si._range <= ref)
+			return 0.0f;
+
+		const f32 dist = clamp(length(si._position - translation(_listener_pose)), ref, si._range);
+		return si._volume * (1.0f - (dist - ref) / (si._range - ref));
+	}
+
+	/// Assigns a free voice to @a si and starts playing it from its current
+	/// offset.
+	void acquire_voice(SoundInstance& si)
+	{
+		CE_ASSERT(_num_free_voices > 0, "No free voices");
+		si._voice = _free_voices[--_num_free_voices];
+
+		const ALuint source = _voices[si._voice];
+		AL_CHECK(alSourcef(source, AL_MAX_DISTANCE, si._range));
+		AL_CHECK(alSourcef(source, AL_GAIN, si._volume));
+		AL_CHECK(alSourcefv(source, AL_POSITION, to_float_ptr(si._position)));
+
+		if (si._resource->stream)
+		{
+			// Looping is handled by the stream.
+			si._stream = CE_NEW(default_allocator(), SoundStream)(*si._resource);
+			AL_CHECK(alSourcei(source, AL_LOOPING, AL_FALSE));
+			si._stream->start(source, si._loop, u32(si._offset));
+			AL_CHECK(alSourcePlay(source));
+
+			ScopedMutex sm(*audio_globals::s_streams_mutex);
+			array::push_back(*audio_globals::s_streams, si._stream);
+		}
+		else
+		{
+			AL_CHECK(alSourcei(source, AL_LOOPING, (si._loop ? AL_TRUE : AL_FALSE)));
+			AL_CHECK(alSourcei(source, AL_BUFFER, si._buffer->buffer));
+			AL_CHECK(alSourcei(source, AL_SAMPLE_OFFSET, ALint(si._offset)));
+			AL_CHECK(alSourcePlay(source));
+		}
 	}
 
-	SoundInstanceId play(const SoundResource& sr, bool loop, f32 volume, f32 range, const Vector3& pos)
+	/// Stops the voice of @a si and gives it back to the pool.
+	void release_voice(SoundInstance& si)
+	{
+		const ALuint source = _voices[si._voice];
+
+		if (si._stream != NULL)
+		{
+			ScopedMutex sm(*audio_globals::s_streams_mutex);
+			Array<SoundStream*>& streams = *audio_globals::s_streams;
+			for (u32 i = 0; i < array::size(streams); ++i)
+			{
+				if (streams[i] == si._stream)
+				{
+					streams[i] = array::back(streams);
+					array::pop_back(streams);
+					break;
+				}
+			}
+		}
+		else
+		{
+			ALint offset;
+			AL_CHECK(alGetSourcei(source, AL_SAMPLE_OFFSET, &offset));
+			si._offset = offset;
+		}
+
+		AL_CHECK(alSourceStop(source));
+		AL_CHECK(alSourcei(source, AL_BUFFER, 0));
+
+		if (si._stream != NULL)
+		{
+			CE_DELETE(default_allocator(), si._stream);
+			si._stream = NULL;
+		}
+
+		_free_voices[_num_free_voices++] = si._voice;
+		si._voice = UINT32_MAX;
+	}
+
+	void destroy(SoundInstance& si)
+	{
+		if (si._voice != UINT32_MAX)
+			release_voice(si);
+
+		if (si._buffer != NULL)
+			sound_buffer_release(si._buffer);
+	}
+
+	SoundInstanceId play(const SoundResource& sr, bool loop, f32 volume, f32 range, const Vector3& pos, s32 priority)
 	{
 		SoundInstanceId id = add();
 		SoundInstance& si = lookup(id);
-		si.create(sr, pos, range);
-		si.play(loop, volume);
+		si._resource = &sr;
+		si._buffer   = NULL;
+		si._stream   = NULL;
+		si._voice    = UINT32_MAX;
+		si._position = pos;
+		si._range    = range;
+		si._volume   = volume;
+		si._priority = priority;
+		si._offset   = 0.0;
+		si._loop     = loop;
+		si._paused   = false;
+		si._stopped  = false;
+
+		if (!sr.stream)
+		{
+			si._buffer = hash_map::get(*audio_globals::s_buffers, &sr, (SoundBuffer*)NULL);
+			CE_ASSERT(si._buffer != NULL, "Sound is not online");
+			++si._buffer->references;
+		}
+
+		// Start right away if a voice is available, otherwise the sound
+		// competes for one at the next update().
+		si._audibility = audibility(si);
+		if (si._audibility > 0.0f && _num_free_voices > 0)
+			acquire_voice(si);
+
 		return id;
 	}
 
 	void stop(SoundInstanceId id)
 	{
-		SoundInstance& si = lookup(id);
-		si.destroy();
+		destroy(lookup(id));
 		remove(id);
 	}
 
 	bool is_playing(SoundInstanceId id)
 	{
-		return has(id) && lookup(id).is_playing();
+		if (!has(id))
+			return false;
+
+		const SoundInstance& si = lookup(id);
+		return !si._paused && !si._stopped;
 	}
 
 	void stop_all()
 	{
-		for (u32 i = 0; i < _num_objects; ++i)
+		for (u32 i = 0; i < array::size(_playing_sounds); ++i)
 		{
-			_playing_sounds[i].stop();
+			SoundInstance& si = _playing_sounds[i];
+			if (si._voice != UINT32_MAX)
+				release_voice(si);
+			si._stopped = true;
 		}
 	}
 
 	void pause_all()
 	{
-		for (u32 i = 0; i < _num_objects; ++i)
+		for (u32 i = 0; i < array::size(_playing_sounds); ++i)
 		{
-			_playing_sounds[i].pause();
+			SoundInstance& si = _playing_sounds[i];
+			if (si._voice != UINT32_MAX)
+				release_voice(si);
+			si._paused = true;
 		}
 	}
 
 	void resume_all()
 	{
-		for (u32 i = 0; i < _num_objects; ++i)
+		for (u32 i = 0; i < array::size(_playing_sounds); ++i)
 		{
-			_playing_sounds[i].resume();
+			SoundInstance& si = _playing_sounds[i];
+			si._paused = false;
+			si._audibility = audibility(si);
+			if (si._audibility > 0.0f && si._voice == UINT32_MAX && _num_free_voices > 0)
+				acquire_voice(si);
 		}
 	}
 
@@ -328,7 +682,12 @@ struct SoundWorldImpl
 	{
 		for (u32 i = 0; i < num; ++i)
 		{
-			lookup(ids[i]).set_position(positions[i]);
+			SoundInstance& si = lookup(ids[i]);
+			si._position = positions[i];
+			if (si._voice != UINT32_MAX)
+			{
+				AL_CHECK(alSourcefv(_voices[si._voice], AL_POSITION, to_float_ptr(si._position)));
+			}
 		}
 	}
 
@@ -336,7 +695,12 @@ struct SoundWorldImpl
 	{
 		for (u32 i = 0; i < num; ++i)
 		{
-			lookup(ids[i]).set_range(ranges[i]);
+			SoundInstance& si = lookup(ids[i]);
+			si._range = ranges[i];
+			if (si._voice != UINT32_MAX)
+			{
+				AL_CHECK(alSourcef(_voices[si._voice], AL_MAX_DISTANCE, si._range));
+			}
 		}
 	}
 
@@ -344,17 +708,49 @@ struct SoundWorldImpl
 	{
 		for (u32 i = 0; i < num; i++)
 		{
-			lookup(ids[i]).set_volume(volumes[i]);
+			SoundInstance& si = lookup(ids[i]);
+			si._volume = volumes[i];
+			if (si._voice != UINT32_MAX)
+			{
+				AL_CHECK(alSourcef(_voices[si._voice], AL_GAIN, si._volume));
+			}
+		}
+	}
+
+	/// Stops all the instances of @a sr. They are destroyed at the next
+	/// update() without accessing @a sr again.
+	void stop_sounds(const SoundResource& sr)
+	{
+		for (u32 i = 0; i < array::size(_playing_sounds); ++i)
+		{
+			SoundInstance& si = _playing_sounds[i];
+			if (si._resource != &sr)
+				continue;
+
+			if (si._voice != UINT32_MAX)
+				release_voice(si);
+			si._stopped = true;
 		}
 	}
 
 	void reload_sounds(const SoundResource& old_sr, const SoundResource& new_sr)
 	{
-		for (u32 i = 0; i < _num_objects; ++i)
+		for (u32 i = 0; i < array::size(_playing_sounds); ++i)
 		{
-			if (_playing_sounds[i]._resource == &old_sr)
+			SoundInstance& si = _playing_sounds[i];
+			if (si._resource != &old_sr)
+				continue;
+
+			destroy(si);
+			si._resource = &new_sr;
+			si._buffer = NULL;
+			si._offset = 0.0;
+
+			if (!new_sr.stream)
 			{
-				_playing_sounds[i].reload(new_sr);
+				si._buffer = hash_map::get(*audio_globals::s_buffers, &new_sr, (SoundBuffer*)NULL);
+				CE_ASSERT(si._buffer != NULL, "Sound is not online");
+				++si._buffer->references;
 			}
 		}
 	}
@@ -373,18 +769,65 @@ struct SoundWorldImpl
 		_listener_pose = pose;
 	}
 
-	void update()
+	/// Advances the playback position of @a si by @a dt seconds and returns
+	/// whether the sound finished playing.
+	bool advance(SoundInstance& si, f32 dt)
+	{
+		if (si._stopped)
+			return true;
+
+		if (si._paused)
+			return false;
+
+		const SoundResource& sr = *si._resource;
+
+		if (si._voice != UINT32_MAX)
+		{
+			const ALuint source = _voices[si._voice];
+
+			ALint state;
+			AL_CHECK(alGetSourcei(source, AL_SOURCE_STATE, &state));
+			const bool stopped = state != AL_PLAYING && state != AL_PAUSED;
+
+			if (si._stream == NULL)
+			{
+				ALint offset;
+				AL_CHECK(alGetSourcei(source, AL_SAMPLE_OFFSET, &offset));
+				si._offset = offset;
+				return stopped;
+			}
+
+			// The source also stops when the stream cannot keep up.
+			ScopedMutex sm(*audio_globals::s_streams_mutex);
+			if (si._stream->_stopped || (stopped && si._stream->_eof))
+				return true;
+		}
+
+		// Streams and virtual sounds follow the clock.
+		si._offset += f64(dt)*sr.sample_rate;
+		if (si._offset >= sr.num_samples)
+		{
+			if (!si._loop || sr.num_samples == 0)
+				return si._voice == UINT32_MAX;
+
+			si._offset = fmod(si._offset, f64(sr.num_samples));
+		}
+
+		return false;
+	}
+
+	void update(f32 dt)
 	{
-		TempAllocator256 alloc;
-		Array<SoundInstanceId> to_delete(alloc);
+		TempAllocator4096 ta;
+		Array<SoundInstanceId> to_delete(ta);
 
-		// Check what sounds finished playing
-		for (u32 i = 0; i < _num_objects; ++i)
+		// Advance playback and collect sounds which finished playing
+		for (u32 i = 0; i < array::size(_playing_sounds); ++i)
 		{
-			SoundInstance& instance = _playing_sounds[i];
-			if (instance.finished())
+			SoundInstance& si = _playing_sounds[i];
+			if (advance(si, dt))
 			{
-				array::push_back(to_delete, instance._id);
+				array::push_back(to_delete, si._id);
 			}
 		}
 
@@ -393,15 +836,110 @@ struct SoundWorldImpl
 		{
 			stop(to_delete[i]);
 		}
+
+		// Rank the remaining sounds
+		Array<VoiceKey> keys(ta);
+		array::resize(keys, array::size(_playing_sounds));
+		for (u32 i = 0; i < array::size(_playing_sounds); ++i)
+		{
+			SoundInstance& si = _playing_sounds[i];
+			si._audibility = audibility(si);
+			keys[i].priority   = si._priority;
+			keys[i].audibility = si._audibility;
+			keys[i].index      = i;
+		}
+		std::sort(array::begin(keys), array::end(keys));
+
+		// Virtualize the sounds which lost their voice first, so that the
+		// voices can be given to the most important sounds.
+		const u32 num_voices = min(array::size(keys), (u32)CROWN_MAX_SOUND_VOICES);
+		for (u32 i = 0; i < array::size(keys); ++i)
+		{
+			SoundInstance& si = _playing_sounds[keys[i].index];
+			const bool real = i < num_voices && si._audibility > 0.0f;
+			if (!real && si._voice != UINT32_MAX)
+				release_voice(si);
+		}
+
+		for (u32 i = 0; i < num_voices; ++i)
+		{
+			SoundInstance& si = _playing_sounds[keys[i].index];
+			if (si._audibility > 0.0f && si._voice == UINT32_MAX)
+				acquire_voice(si);
+		}
 	}
 };
 
+namespace sound_resource_internal
+{
+	void online(StringId64 id, ResourceManager& rm)
+	{
+		const SoundResource* sr = (const SoundResource*)rm.get(RESOURCE_TYPE_SOUND, id);
+		if (sr->stream)
+			return;
+
+		SoundBuffer* sb = CE_NEW(default_allocator(), SoundBuffer)();
+		AL_CHECK(alGenBuffers(1, &sb->buffer));
+		CE_ASSERT(alIsBuffer(sb->buffer), "alGenBuffers: error");
+		AL_CHECK(alBufferData(sb->buffer, al_format(*sr), sound_resource::data(sr), sr->size, sr->sample_rate));
+		sb->references = 1;
+
+		hash_map::set(*audio_globals::s_buffers, sr, sb);
+	}
+
+	void offline(StringId64 id, ResourceManager& rm)
+	{
+		// Buffers have already been released by audio_globals::shutdown().
+		if (audio_globals::s_buffers == NULL)
+			return;
+
+		const SoundResource* sr = (const SoundResource*)rm.get(RESOURCE_TYPE_SOUND, id);
+
+		// Virtual instances read the resource to follow the playback
+		// position and to get a voice back.
+		for (u32 i = 0; i < array::size(*audio_globals::s_worlds); ++i)
+			(*audio_globals::s_worlds)[i]->stop_sounds(*sr);
+
+		if (sr->stream)
+		{
+			// Stop the streams reading the data before it is freed. The audio
+			// thread only updates the streams in s_streams while holding the
+			// mutex, so it never touches them again once this returns.
+			ScopedMutex sm(*audio_globals::s_streams_mutex);
+			Array<SoundStream*>& streams = *audio_globals::s_streams;
+			for (u32 i = 0; i < array::size(streams);)
+			{
+				if (streams[i]->_resource == sr)
+				{
+					streams[i]->_stopped = true;
+					streams[i] = array::back(streams);
+					array::pop_back(streams);
+				}
+				else
+				{
+					++i;
+				}
+			}
+			return;
+		}
+
+		SoundBuffer* sb = hash_map::get(*audio_globals::s_buffers, sr, (SoundBuffer*)NULL);
+		if (sb == NULL)
+			return;
+
+		// Instances still playing keep the buffer alive.
+		hash_map::remove(*audio_globals::s_buffers, sr);
+		sound_buffer_release(sb);
+	}
+
+} // namespace sound_resource_internal
+
 SoundWorld::SoundWorld(Allocator& a)
 	: _marker(SOUND_WORLD_MARKER)
 	, _allocator(&a)
 	, _impl(NULL)
 {
-	_impl = CE_NEW(*_allocator, SoundWorldImpl)();
+	_impl = CE_NEW(*_allocator, SoundWorldImpl)(*_allocator);
 }
 
 SoundWorld::~SoundWorld()
@@ -410,9 +948,9 @@ SoundWorld::~SoundWorld()
 	_marker = 0;
 }
 
-SoundInstanceId SoundWorld::play(const SoundResource& sr, bool loop, f32 volume, f32 range, const Vector3& pos)
+SoundInstanceId SoundWorld::play(const SoundResource& sr, bool loop, f32 volume, f32 range, const Vector3& pos, s32 priority)
 {
-	return _impl->play(sr, loop, volume, range, pos);
+	return _impl->play(sr, loop, volume, range, pos, priority);
 }
 
 void SoundWorld::stop(SoundInstanceId id)
@@ -465,9 +1003,9 @@ void SoundWorld::set_listener_pose(const Matrix4x4& pose)
 	_impl->set_listener_pose(pose);
 }
 
-void SoundWorld::update()
+void SoundWorld::update(f32 dt)
 {
-	_impl->update();
+	_impl->update(dt);
 }
 
 } // namespace crown
@@ -9,6 +9,7 @@
 
 #include "core/memory/allocator.h"
 #include "core/memory/memory.inl"
+#include "resource/sound_resource.h"
 #include "world/audio.h"
 #include "world/sound_world.h"
 
@@ -26,6 +27,18 @@ namespace audio_globals
 
 } // namespace audio_globals
 
+namespace sound_resource_internal
+{
+	void online(StringId64 /*id*/, ResourceManager& /*rm*/)
+	{
+	}
+
+	void offline(StringId64 /*id*/, ResourceManager& /*rm*/)
+	{
+	}
+
+} // namespace sound_resource_internal
+
 struct SoundWorldImpl
 {
 	SoundWorldImpl()
@@ -36,7 +49,7 @@ struct SoundWorldImpl
 	{
 	}
 
-	SoundInstanceId play(const SoundResource& /*sr*/, bool /*loop*/, f32 /*volume*/, f32 /*range*/, const Vector3& /*pos*/)
+	SoundInstanceId play(const SoundResource& /*sr*/, bool /*loop*/, f32 /*volume*/, f32 /*range*/, const Vector3& /*pos*/, s32 /*priority*/)
 	{
 		return 0;
 	}
@@ -82,7 +95,7 @@ struct SoundWorldImpl
 	{
 	}
 
-	void update()
+	void update(f32 /*dt*/)
 	{
 	}
 };
@@ -101,9 +114,9 @@ SoundWorld::~SoundWorld()
 	_marker = 0;
 }
 
-SoundInstanceId SoundWorld::play(const SoundResource& sr, bool loop, f32 volume, f32 range, const Vector3& pos)
+SoundInstanceId SoundWorld::play(const SoundResource& sr, bool loop, f32 volume, f32 range, const Vector3& pos, s32 priority)
 {
-	return _impl->play(sr, loop, volume, range, pos);
+	return _impl->play(sr, loop, volume, range, pos, priority);
 }
 
 void SoundWorld::stop(SoundInstanceId id)
@@ -156,9 +169,9 @@ void SoundWorld::set_listener_pose(const Matrix4x4& pose)
 	_impl->set_listener_pose(pose);
 }
 
-void SoundWorld::update()
+void SoundWorld::update(f32 dt)
 {
-	_impl->update();
+	_impl->update(dt);
 }
 
 } // namespace crown
@@ -396,9 +396,10 @@ struct HeightfieldShape
 {
 	u32 width;
 	u32 length;
-	f32 height_scale;
+	f32 height_scale; ///< Meters per height unit.
 	f32 height_min;
 	f32 height_max;
+	f32 cell_size;    ///< Distance between samples in meters.
 };
 
 struct ColliderDesc
@@ -471,11 +472,14 @@ struct PhysicsCollisionEvent
 	Vector3 position;        ///< In world-space.
 	Vector3 normal;          ///< In world-space.
 	float distance;          ///< Separation distance
+	f32 impulse;             ///< Total impulse applied during the frame.
 };
 
 struct PhysicsTriggerEvent
 {
 	enum Type { TOUCH_BEGIN, TOUCHING, TOUCH_END } type;
+	UnitId trigger_unit;
+	UnitId other_unit;
 	ActorInstance trigger;
 	ActorInstance other;
 };
@@ -200,6 +200,7 @@ void World::update_scene(f32 dt)
 	Array<UnitId> changed_units(ta);
 	Array<Matrix4x4> changed_world(ta);
 
+	_scene_graph->update();
 	_scene_graph->get_changed(changed_units, changed_world);
 
 	_physics_world->update_actor_world_poses(array::begin(changed_units)
@@ -240,6 +241,10 @@ void World::update_scene(f32 dt)
 				break;
 
 			case EventType::PHYSICS_TRIGGER:
+				{
+					const PhysicsTriggerEvent& ptev = *(PhysicsTriggerEvent*)data;
+					script_world::trigger(*_script_world, ptev);
+				}
 				break;
 
 			default:
@@ -252,6 +257,7 @@ void World::update_scene(f32 dt)
 
 	array::clear(changed_units);
 	array::clear(changed_world);
+	_scene_graph->update();
 	_scene_graph->get_changed(changed_units, changed_world);
 	_scene_graph->clear_changed();
 
@@ -260,7 +266,7 @@ void World::update_scene(f32 dt)
 		, array::begin(changed_world)
 		);
 
-	_sound_world->update();
+	_sound_world->update(dt);
 
 	_gui_buffer.reset();
 
@@ -275,9 +281,9 @@ void World::update(f32 dt)
 	update_scene(dt);
 }
 
-void World::render(const Matrix4x4& view)
+void World::render(const Matrix4x4& view, const Matrix4x4& proj)
 {
-	_render_world->render(view);
+	_render_world->render(view, proj);
 
 	_physics_world->debug_draw();
 	_render_world->debug_draw(*_lines);
@@ -476,15 +482,15 @@ Vector3 World::camera_world_to_screen(CameraInstance camera, const Vector3& pos)
 	return screen;
 }
 
-SoundInstanceId World::play_sound(const SoundResource& sr, const bool loop, const f32 volume, const Vector3& pos, const f32 range)
+SoundInstanceId World::play_sound(const SoundResource& sr, const bool loop, const f32 volume, const Vector3& pos, const f32 range, const s32 priority)
 {
-	return _sound_world->play(sr, loop, volume, range, pos);
+	return _sound_world->play(sr, loop, volume, range, pos, priority);
 }
 
-SoundInstanceId World::play_sound(StringId64 name, const bool loop, const f32 volume, const Vector3& pos, const f32 range)
+SoundInstanceId World::play_sound(StringId64 name, const bool loop, const f32 volume, const Vector3& pos, const f32 range, const s32 priority)
 {
 	const SoundResource* sr = (const SoundResource*)_resource_manager->get(RESOURCE_TYPE_SOUND, name);
-	return play_sound(*sr, loop, volume, pos, range);
+	return play_sound(*sr, loop, volume, pos, range, priority);
 }
 
 void World::stop_sound(SoundInstanceId id)
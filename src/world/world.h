@@ -162,14 +162,15 @@ struct World
 	/// Updates all units and sub-systems with the given @a dt delta time.
 	void update(f32 dt);
 
-	/// Renders the world using @a view.
-	void render(const Matrix4x4& view);
+	/// Renders the world using @a view and @a proj.
+	void render(const Matrix4x4& view, const Matrix4x4& proj);
 
-	SoundInstanceId play_sound(const SoundResource& sr, bool loop = false, f32 volume = 1.0f, const Vector3& position = VECTOR3_ZERO, f32 range = 50.0f);
+	SoundInstanceId play_sound(const SoundResource& sr, bool loop = false, f32 volume = 1.0f, const Vector3& position = VECTOR3_ZERO, f32 range = 50.0f, s32 priority = 0);
 
 	/// Plays the sound with the given @a name at the given @a position, with the given
 	/// @a volume and @a range. @a loop controls whether the sound must loop or not.
-	SoundInstanceId play_sound(StringId64 name, const bool loop, const f32 volume, const Vector3& pos, const f32 range);
+	/// Sounds with higher @a priority get a voice before the others.
+	SoundInstanceId play_sound(StringId64 name, const bool loop, const f32 volume, const Vector3& pos, const f32 range, const s32 priority = 0);
 
 	/// Stops the sound with the given @a id.
 	void stop_sound(SoundInstanceId id);